@@ -16,6 +16,8 @@ use autocxx_parser::file_locations::FileLocationStrategy;
 use proc_macro2::TokenStream;
 
 use crate::{ParseError, ParsedFile, RebuildDependencyRecorder};
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
 use std::io::Write;
 use std::path::{Path, PathBuf};
 use std::{ffi::OsStr, io, process};
@@ -53,6 +55,11 @@ impl Display for BuilderError {
 
 pub type BuilderBuild = cc::Build;
 
+/// If this environment variable is set, we'll precompile a header
+/// containing everything commonly included by the generated C++,
+/// and build each generated file against it.
+pub static AUTOCXX_PCH: &str = "AUTOCXX_PCH";
+
 pub struct BuilderSuccess(pub BuilderBuild, pub Vec<PathBuf>);
 
 /// Results of a build.
@@ -141,46 +148,124 @@ where
     parsed_file
         .resolve_all(autocxx_inc, extra_clang_args, dependency_recorder)
         .map_err(BuilderError::ParseError)?;
-    build_with_existing_parsed_file(parsed_file, cxxdir, incdir, rsdir)
+    let pch_clang_args = std::env::var_os(AUTOCXX_PCH).map(|_| extra_clang_args);
+    build_with_existing_parsed_file(parsed_file, cxxdir, incdir, rsdir, pch_clang_args)
 }
 
+/// If `pch_clang_args` is given, a precompiled header is used, built
+/// in the language dialect specified by those args.
 pub(crate) fn build_with_existing_parsed_file(
     parsed_file: ParsedFile,
     cxxdir: PathBuf,
     incdir: PathBuf,
     rsdir: PathBuf,
+    pch_clang_args: Option<&[&str]>,
 ) -> BuilderResult {
     let mut counter = 0;
     let mut builder = cc::Build::new();
     builder.cpp(true);
     let mut generated_rs = Vec::new();
     builder.includes(parsed_file.include_dirs());
-    for include_cpp in parsed_file.get_cpp_buildables() {
-        let generated_code = include_cpp
-            .generate_h_and_cxx()
-            .map_err(BuilderError::InvalidCxx)?;
-        for filepair in generated_code.0 {
-            if let Some(implementation) = &filepair.implementation {
-                let fname = format!("gen{}.cxx", counter);
-                counter += 1;
-                let gen_cxx_path = write_to_file(&cxxdir, &fname, implementation)?;
-                builder.file(gen_cxx_path);
-            }
-
-            write_to_file(&incdir, &filepair.header_name, &filepair.header)?;
+    let artifacts = parsed_file
+        .generate_artifacts()
+        .map_err(BuilderError::InvalidCxx)?;
+    for filepair in artifacts.cpp {
+        if let Some(implementation) = &filepair.implementation {
+            let fname = format!("gen{}.cxx", counter);
+            counter += 1;
+            let gen_cxx_path = write_to_file(&cxxdir, &fname, implementation)?;
+            builder.file(gen_cxx_path);
         }
+
+        write_to_file(&incdir, &filepair.header_name, &filepair.header)?;
     }
 
-    for include_cpp in parsed_file.get_rs_buildables() {
-        let fname = include_cpp.get_rs_filename();
-        let rs = include_cpp.generate_rs();
+    for (fname, rs) in artifacts.rs {
         generated_rs.push(write_rs_to_file(&rsdir, &fname, rs)?);
     }
     if counter == 0 {
-        Err(BuilderError::NoIncludeCxxMacrosFound)
+        return Err(BuilderError::NoIncludeCxxMacrosFound);
+    }
+    if let Some(pch_clang_args) = pch_clang_args {
+        precompile_header(
+            &mut builder,
+            &incdir,
+            &parsed_file.pch_header(),
+            pch_clang_args,
+        )?;
+    }
+    Ok(BuilderSuccess(builder, generated_rs))
+}
+
+/// Writes the given header, and compiles it to a precompiled header
+/// alongside it, then arranges for `builder` to `-include` it in every
+/// file, at which point gcc and clang will both pick up the precompiled
+/// version. A precompiled header is only usable by files compiled with
+/// the same flags, so each set of compiler flags gets its own directory
+/// within `incdir`: a stale one built with other flags is never picked
+/// up. If compilation goes wrong, the generated C++ is simply built
+/// without it.
+fn precompile_header(
+    builder: &mut cc::Build,
+    incdir: &Path,
+    header_contents: &str,
+    extra_clang_args: &[&str],
+) -> Result<(), BuilderError> {
+    // Use the dialect in which bindgen parsed the headers.
+    let std = crate::AUTOCXX_CLANG_ARGS
+        .iter()
+        .chain(extra_clang_args.iter())
+        .filter(|arg| arg.starts_with("-std="))
+        .last()
+        .copied()
+        .unwrap_or("-std=c++14");
+    let mut pch_builder = builder.clone();
+    pch_builder.flag(std);
+    let compiler = match pch_builder.try_get_compiler() {
+        Ok(compiler) => compiler,
+        Err(e) => {
+            log::warn!("Not using a precompiled header: {}", e);
+            return Ok(());
+        }
+    };
+    if compiler.is_like_msvc() {
+        log::warn!("Not using a precompiled header: not yet supported for MSVC");
+        return Ok(());
+    }
+    let mut hasher = DefaultHasher::new();
+    compiler.path().hash(&mut hasher);
+    compiler.args().hash(&mut hasher);
+    let dir = incdir.join(format!("pch-{:016x}", hasher.finish()));
+    ensure_created(&dir)?;
+    let header = write_to_file(&dir, crate::PCH_HEADER_NAME, header_contents.as_bytes())?;
+    let mut pch = header.as_os_str().to_owned();
+    pch.push(if compiler.is_like_clang() {
+        ".pch"
     } else {
-        Ok(BuilderSuccess(builder, generated_rs))
+        ".gch"
+    });
+    let status = compiler
+        .to_command()
+        .args(&["-x", "c++-header"])
+        .arg(&header)
+        .arg("-o")
+        .arg(&pch)
+        .status();
+    match status {
+        Ok(status) if status.success() => {
+            builder
+                .flag(std)
+                .flag("-include")
+                .flag(&header.to_string_lossy());
+        }
+        Ok(status) => log::warn!(
+            "Not using a precompiled header: compiling {} failed with {}",
+            header.display(),
+            status
+        ),
+        Err(e) => log::warn!("Not using a precompiled header: {}", e),
     }
+    Ok(())
 }
 
 fn ensure_created(dir: &Path) -> Result<(), BuilderError> {
@@ -224,3 +309,44 @@ fn rust_version_check() {
         panic!("Rust 1.48 or later is required.")
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::precompile_header;
+    use crate::PCH_HEADER_NAME;
+
+    #[test]
+    fn test_precompile_header() {
+        let dir = tempfile::tempdir().unwrap();
+        let target = rust_info::get().target_triple.unwrap();
+        let mut b = cc::Build::new();
+        b.cpp(true)
+            .out_dir(dir.path())
+            .host(&target)
+            .target(&target)
+            .opt_level(1)
+            .cargo_metadata(false);
+        let header = "#pragma once\nconstexpr int pch_value() { return 3; }\n";
+        precompile_header(&mut b, dir.path(), header, &["-std=c++17"]).unwrap();
+        let pch_dirs: Vec<_> = std::fs::read_dir(dir.path())
+            .unwrap()
+            .map(|entry| entry.unwrap().path())
+            .filter(|path| path.is_dir())
+            .collect();
+        assert_eq!(pch_dirs.len(), 1);
+        let pch = std::fs::read_dir(&pch_dirs[0])
+            .unwrap()
+            .map(|entry| entry.unwrap().file_name().to_string_lossy().into_owned())
+            .find(|name| name.starts_with(PCH_HEADER_NAME) && name != PCH_HEADER_NAME);
+        assert!(pch.is_some(), "no precompiled header was built");
+        // The file doesn't include the header itself, so this only
+        // builds if the builder -includes it.
+        let cxx = dir.path().join("uses_pch.cc");
+        std::fs::write(
+            &cxx,
+            "static_assert(pch_value() == 3, \"\");\ninline int value = pch_value();\n",
+        )
+        .unwrap();
+        b.file(cxx).try_compile("uses-pch").unwrap();
+    }
+}
@@ -35,6 +35,17 @@ pub(crate) fn mark_types_abstract(config: &IncludeCppConfig, apis: &mut Vec<Api<
                     },
                 ..
             } => Some(self_ty_name.clone()),
+            // Function analysis may already have spotted abstract types
+            // whose methods we don't generate.
+            Api::Struct {
+                name,
+                analysis:
+                    PodStructAnalysisBody {
+                        kind: TypeKind::Abstract,
+                        ..
+                    },
+                ..
+            } => Some(name.name.clone()),
             _ => None,
         })
         .collect();
@@ -22,14 +22,19 @@ use crate::{conversion::api::Api, known_types::known_types, types::QualifiedName
 
 use super::fun::FnAnalysis;
 
-/// Spot any variable-length C types (e.g. unsigned long)
-/// used in the [Api]s and append those as extra APIs.
+/// Spot any variable-length C types (e.g. unsigned long), or SIMD
+/// vector types, used in the [Api]s and append those as extra APIs.
+/// These are named according to the wrapper type in the autocxx crate,
+/// whatever name bindgen used for them. Under `primitive_ctypes!`, uses
+/// of some of these types will already have become Rust primitives, but
+/// we still record the C type so that codegen can assert the mapping holds.
 pub(crate) fn append_ctype_information(apis: &mut Vec<Api<FnAnalysis>>) {
     let ctypes: HashMap<Ident, QualifiedName> = apis
         .iter()
         .map(|api| api.deps())
         .flatten()
         .filter(|ty| known_types().is_ctype(ty))
+        .map(|ty| known_types().canonical_name(ty))
         .map(|ty| (ty.get_final_ident(), ty.clone()))
         .collect();
     for (id, typename) in ctypes {
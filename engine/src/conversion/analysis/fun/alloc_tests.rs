@@ -0,0 +1,153 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Checks that the per-API queries made by several analysis and codegen
+//! phases don't allocate. These replace the global allocator, so they're
+//! only built with the `alloc-tests` feature, which CI runs separately
+//! from the other tests. Counts are kept per thread so that other tests
+//! running in parallel don't interfere.
+
+use std::{
+    alloc::{GlobalAlloc, Layout, System},
+    cell::Cell,
+    collections::HashSet,
+};
+
+use autocxx_parser::CppTrait;
+use syn::parse_quote;
+
+use super::{FnAnalysis, StaticAnalysisBody};
+use crate::{
+    conversion::{
+        analysis::pod::PodStructAnalysisBody,
+        api::{Api, ApiName, TypeKind},
+    },
+    types::{make_ident, Namespace, QualifiedName},
+};
+
+struct CountingAllocator;
+
+thread_local! {
+    static ALLOCATIONS: Cell<usize> = Cell::new(0);
+}
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let _ = ALLOCATIONS.try_with(|a| a.set(a.get() + 1));
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+}
+
+#[global_allocator]
+static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+fn count_allocations(f: impl FnOnce()) -> usize {
+    let before = ALLOCATIONS.with(|a| a.get());
+    f();
+    ALLOCATIONS.with(|a| a.get()) - before
+}
+
+fn qn(id: &str) -> QualifiedName {
+    QualifiedName::new(&Namespace::new(), make_ident(id))
+}
+
+fn make_apis() -> Vec<Api<FnAnalysis>> {
+    let deps: HashSet<_> = vec![qn("A"), qn("B")].into_iter().collect();
+    vec![
+        Api::StringConstructor {
+            name: ApiName::new_in_root_namespace(make_ident("make_string")),
+        },
+        Api::ConcreteType {
+            name: ApiName::new_in_root_namespace(make_ident("AutocxxConcrete")),
+            rs_definition: parse_quote! { root::std::vector<root::A> },
+            cpp_definition: "std::vector<A>".into(),
+        },
+        Api::CType {
+            name: ApiName::new_in_root_namespace(make_ident("c_ulong")),
+            typename: qn("c_ulong"),
+        },
+        Api::Static {
+            name: ApiName::new_in_root_namespace(make_ident("GLOBAL")),
+            static_item: parse_quote! { pub static mut GLOBAL: u32; },
+            analysis: StaticAnalysisBody {
+                cxxbridge_name: make_ident("GLOBAL_autocxx_global"),
+                cxxbridge_type: parse_quote! { *mut u32 },
+                mutable: true,
+                global: qn("GLOBAL"),
+                deps: deps.clone(),
+            },
+        },
+        Api::Struct {
+            name: ApiName::new_in_root_namespace(make_ident("S")),
+            item: parse_quote! { pub struct S { pub a: A, pub b: B } },
+            analysis: PodStructAnalysisBody {
+                kind: TypeKind::Pod,
+                bases: HashSet::new(),
+                field_deps: deps.clone(),
+                rust_constructible: false,
+                traits: vec![CppTrait::Eq, CppTrait::Hash],
+                relocatable: false,
+                declares_relocatable: false,
+                layout: None,
+            },
+        },
+        Api::BindgenLayout {
+            name: ApiName::new_in_root_namespace(make_ident("S__bindgen_ty_1")),
+            item: parse_quote! { pub union S__bindgen_ty_1 { pub a: u32 } },
+            deps,
+        },
+    ]
+}
+
+/// Runs the query over every API, returning the sum of its results
+/// and the number of allocations made along the way.
+fn query_all(
+    apis: &[Api<FnAnalysis>],
+    query: &impl Fn(&Api<FnAnalysis>) -> usize,
+) -> (usize, usize) {
+    let mut results = 0;
+    let allocations = count_allocations(|| {
+        for api in apis {
+            results += query(api);
+        }
+    });
+    (results, allocations)
+}
+
+/// Checks the query does something, and that the allocations it makes
+/// don't grow with the number of APIs. Any one-off allocation, such
+/// as initializing some lazy static, is fine.
+fn check_does_not_allocate_per_api(query: impl Fn(&Api<FnAnalysis>) -> usize) {
+    let few = make_apis();
+    let many: Vec<_> = (0..4).flat_map(|_| make_apis()).collect();
+    let (few_results, few_allocations) = query_all(&few, &query);
+    let (many_results, many_allocations) = query_all(&many, &query);
+    assert!(few_results > 0);
+    assert_eq!(many_results, 4 * few_results);
+    assert!(many_allocations <= few_allocations);
+}
+
+#[test]
+fn test_deps_does_not_allocate() {
+    check_does_not_allocate_per_api(|api| api.deps().count());
+}
+
+#[test]
+fn test_additional_cpp_does_not_allocate() {
+    check_does_not_allocate_per_api(|api| usize::from(api.additional_cpp().is_some()));
+}
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 use crate::types::Namespace;
+use autocxx_parser::Hotness;
+use std::borrow::Cow;
 use syn::{parse_quote, Ident, Type};
 
 #[derive(Clone)]
@@ -26,6 +28,14 @@ pub(crate) enum CppConversionType {
 pub(crate) enum RustConversionType {
     None,
     FromStr,
+    /// A `&CStr` parameter passed to C++ as `const char*`.
+    FromCStr,
+    /// A `const char*` return value presented to Rust as `&CStr`.
+    /// Unless the user has promised that it's NUL-terminated, only
+    /// an `unsafe` function may return it.
+    ToCStr {
+        nul_terminated: bool,
+    },
 }
 
 /// A policy for converting types. Conversion may occur on both the Rust and
@@ -79,21 +89,37 @@ impl TypeConversionPolicy {
         }
     }
 
+    pub(crate) fn new_from_cstr(ty: Type) -> Self {
+        TypeConversionPolicy {
+            unwrapped_type: ty,
+            cpp_conversion: CppConversionType::None,
+            rust_conversion: RustConversionType::FromCStr,
+        }
+    }
+
+    pub(crate) fn new_to_cstr(ty: Type, nul_terminated: bool) -> Self {
+        TypeConversionPolicy {
+            unwrapped_type: ty,
+            cpp_conversion: CppConversionType::None,
+            rust_conversion: RustConversionType::ToCStr { nul_terminated },
+        }
+    }
+
     pub(crate) fn cpp_work_needed(&self) -> bool {
         !matches!(self.cpp_conversion, CppConversionType::None)
     }
 
-    pub(crate) fn unconverted_rust_type(&self) -> Type {
+    pub(crate) fn unconverted_rust_type(&self) -> Cow<'_, Type> {
         match self.cpp_conversion {
-            CppConversionType::FromValueToUniquePtr => self.make_unique_ptr_type(),
-            _ => self.unwrapped_type.clone(),
+            CppConversionType::FromValueToUniquePtr => Cow::Owned(self.make_unique_ptr_type()),
+            _ => Cow::Borrowed(&self.unwrapped_type),
         }
     }
 
-    pub(crate) fn converted_rust_type(&self) -> Type {
+    pub(crate) fn converted_rust_type(&self) -> Cow<'_, Type> {
         match self.cpp_conversion {
-            CppConversionType::FromUniquePtrToValue => self.make_unique_ptr_type(),
-            _ => self.unwrapped_type.clone(),
+            CppConversionType::FromUniquePtrToValue => Cow::Owned(self.make_unique_ptr_type()),
+            _ => Cow::Borrowed(&self.unwrapped_type),
         }
     }
 
@@ -107,20 +133,40 @@ impl TypeConversionPolicy {
     pub(crate) fn rust_work_needed(&self) -> bool {
         !matches!(self.rust_conversion, RustConversionType::None)
     }
+
+    /// Whether this is a C string, passed through cxx as a raw pointer.
+    pub(crate) fn is_c_string(&self) -> bool {
+        matches!(
+            self.rust_conversion,
+            RustConversionType::FromCStr | RustConversionType::ToCStr { .. }
+        )
+    }
+
+    /// Whether this is a returned C string which the user has promised
+    /// is NUL-terminated.
+    pub(crate) fn is_nul_terminated_c_string(&self) -> bool {
+        matches!(
+            self.rust_conversion,
+            RustConversionType::ToCStr {
+                nul_terminated: true
+            }
+        )
+    }
 }
 
-#[derive(Clone)] // TODO wish this didn't need to be cloneable
 pub(crate) enum FunctionWrapperPayload {
     FunctionCall(Namespace, Ident),
     StaticMethodCall(Namespace, Ident, Ident),
     Constructor,
+    /// Constructs a `std::vector` of default-constructed instances.
+    VectorConstructor,
 }
 
-#[derive(Clone)] // TODO wish this didn't need to be cloneable
 pub(crate) struct FunctionWrapper {
     pub(crate) payload: FunctionWrapperPayload,
     pub(crate) wrapper_function_name: Ident,
     pub(crate) return_conversion: Option<TypeConversionPolicy>,
     pub(crate) argument_conversion: Vec<TypeConversionPolicy>,
     pub(crate) is_a_method: bool,
+    pub(crate) hotness: Hotness,
 }
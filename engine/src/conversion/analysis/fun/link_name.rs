@@ -0,0 +1,145 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use syn::{Attribute, LitStr};
+
+/// Returns the mangled symbol name which bindgen recorded for an item,
+/// if it differs from the item's Rust name.
+pub(super) fn get_link_name(attrs: &[Attribute]) -> Option<String> {
+    attrs
+        .iter()
+        .filter(|a| a.path.is_ident("link_name"))
+        .filter_map(|a| a.parse_meta().ok())
+        .filter_map(|m| match m {
+            syn::Meta::NameValue(syn::MetaNameValue {
+                lit: syn::Lit::Str(s),
+                ..
+            }) => Some(s),
+            _ => None,
+        })
+        .map(|s: LitStr| s.value().trim_start_matches('\u{1}').to_string())
+        .next()
+}
+
+/// Recovers the components of the fully-qualified C++ name of a
+/// variable from its mangled symbol name, e.g. `["ns", "Foo", "bar"]`
+/// for `ns::Foo::bar`. bindgen flattens static data members into
+/// globals called `Foo_bar`, so this is the only way to tell how to
+/// refer to them from C++. Only plain names are understood: anything
+/// involving templates or substitutions returns `None`.
+pub(super) fn demangle_variable_name(link_name: &str) -> Option<Vec<String>> {
+    if let Some(msvc) = link_name.strip_prefix('?') {
+        return demangle_msvc(msvc);
+    }
+    // Mach-O symbols carry an extra leading underscore.
+    let itanium = link_name
+        .strip_prefix("__Z")
+        .or_else(|| link_name.strip_prefix("_Z"))?;
+    match itanium.strip_prefix('N') {
+        Some(nested) => {
+            let (components, rest) = itanium_source_names(nested);
+            if rest == "E" && !components.is_empty() {
+                Some(components)
+            } else {
+                None
+            }
+        }
+        None => {
+            let (components, rest) = itanium_source_names(itanium);
+            if rest.is_empty() && components.len() == 1 {
+                Some(components)
+            } else {
+                None
+            }
+        }
+    }
+}
+
+/// Consumes as many `<length><identifier>` pairs as possible.
+fn itanium_source_names(mut input: &str) -> (Vec<String>, &str) {
+    let mut components = Vec::new();
+    loop {
+        let digits = input.chars().take_while(|c| c.is_ascii_digit()).count();
+        if digits == 0 {
+            break;
+        }
+        let len: usize = match input[..digits].parse() {
+            Ok(len) => len,
+            Err(_) => break,
+        };
+        let name = match input.get(digits..digits + len) {
+            Some(name) => name,
+            None => break,
+        };
+        components.push(name.to_string());
+        input = &input[digits + len..];
+    }
+    (components, input)
+}
+
+/// MSVC names look like `?bar@Foo@ns@@2HA`: innermost first, terminated
+/// by an empty component, followed by type information.
+fn demangle_msvc(input: &str) -> Option<Vec<String>> {
+    let end = input.find("@@")?;
+    let mut components: Vec<String> = input[..end].split('@').map(|s| s.to_string()).collect();
+    if components
+        .iter()
+        .any(|c| c.is_empty() || c.starts_with('?') || c.starts_with('$'))
+    {
+        return None;
+    }
+    components.reverse();
+    Some(components)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::demangle_variable_name;
+
+    fn names(components: &[&str]) -> Option<Vec<String>> {
+        Some(components.iter().map(|s| s.to_string()).collect())
+    }
+
+    #[test]
+    fn test_itanium() {
+        assert_eq!(
+            demangle_variable_name("_ZN3Foo3barE"),
+            names(&["Foo", "bar"])
+        );
+        assert_eq!(
+            demangle_variable_name("_ZN2ns3Foo3barE"),
+            names(&["ns", "Foo", "bar"])
+        );
+        assert_eq!(
+            demangle_variable_name("__ZN3cfg7counterE"),
+            names(&["cfg", "counter"])
+        );
+        assert_eq!(demangle_variable_name("_Z5LIMIT"), names(&["LIMIT"]));
+        assert_eq!(demangle_variable_name("_ZN3FooIiE3barE"), None);
+        assert_eq!(demangle_variable_name("_ZNSt3foo3barE"), None);
+    }
+
+    #[test]
+    fn test_msvc() {
+        assert_eq!(
+            demangle_variable_name("?bar@Foo@@2HA"),
+            names(&["Foo", "bar"])
+        );
+        assert_eq!(
+            demangle_variable_name("?bar@Foo@ns@@2HA"),
+            names(&["ns", "Foo", "bar"])
+        );
+        assert_eq!(demangle_variable_name("?bar@?$Foo@H@@2HA"), None);
+    }
+}
@@ -12,8 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#[cfg(all(test, feature = "alloc-tests"))]
+mod alloc_tests;
 mod bridge_name_tracker;
 pub(crate) mod function_wrapper;
+mod link_name;
 mod overload_tracker;
 mod rust_name_tracker;
 
@@ -28,35 +31,40 @@ use crate::{
         convert_error::ErrorContext,
         error_reporter::convert_apis,
     },
-    known_types::known_types,
+    known_types::{is_c_string, known_types, known_types_for},
     types::validate_ident_ok_for_rust,
 };
-use std::collections::{HashMap, HashSet};
+use std::{
+    cell::RefCell,
+    collections::{HashMap, HashSet},
+};
 
-use autocxx_parser::{IncludeCppConfig, UnsafePolicy};
+use autocxx_parser::{CStringPolicy, Hotness, IncludeCppConfig, UnsafePolicy};
 use function_wrapper::{FunctionWrapper, FunctionWrapperPayload, TypeConversionPolicy};
 use proc_macro2::Span;
 use syn::{
-    parse_quote, punctuated::Punctuated, FnArg, ForeignItemFn, Ident, LitStr, Pat, ReturnType,
-    Type, TypePtr, Visibility,
+    parse_quote, punctuated::Punctuated, FnArg, ForeignItemFn, ForeignItemStatic, Ident, LitStr,
+    Pat, ReturnType, Type, TypePtr, Visibility,
 };
 
 use crate::{
     conversion::{
         api::{AnalysisPhase, Api, TypeKind, UnanalyzedApi},
-        codegen_cpp::AdditionalNeed,
+        codegen_cpp::{AdditionalNeed, TypeHelperFlags},
         ConvertError,
     },
     types::{make_ident, validate_ident_ok_for_cxx, Namespace, QualifiedName},
 };
 
 use self::{
-    bridge_name_tracker::BridgeNameTracker, overload_tracker::OverloadTracker,
+    bridge_name_tracker::BridgeNameTracker,
+    link_name::{demangle_variable_name, get_link_name},
+    overload_tracker::OverloadTracker,
     rust_name_tracker::RustNameTracker,
 };
 
 use super::{
-    pod::{PodAnalysis, PodStructAnalysisBody},
+    pod::{EnumKind, PodAnalysis, PodStructAnalysisBody},
     tdef::TypedefAnalysisBody,
 };
 
@@ -92,10 +100,27 @@ pub(crate) struct FnAnalysisBody {
     pub(crate) params: Punctuated<FnArg, syn::Token![,]>,
     pub(crate) kind: FnKind,
     pub(crate) ret_type: ReturnType,
+    /// How the return value is converted, if there is one.
+    pub(crate) ret_conversion: Option<TypeConversionPolicy>,
     pub(crate) param_details: Vec<ArgumentAnalysis>,
     pub(crate) requires_unsafe: bool,
     pub(crate) vis: Visibility,
-    pub(crate) cpp_wrapper: Option<AdditionalNeed>,
+    pub(crate) cpp_wrapper: Option<FunctionWrapper>,
+    pub(crate) deps: HashSet<QualifiedName>,
+    /// How hot this function is according to any `profile_from_file!`.
+    pub(crate) hotness: Hotness,
+}
+
+/// Analysis of a global variable. We expose these via a C++ accessor
+/// which returns the variable's address; that accessor is called only
+/// once and the resulting pointer cached on the Rust side.
+pub(crate) struct StaticAnalysisBody {
+    pub(crate) cxxbridge_name: Ident,
+    /// Pointer type returned by the accessor, as used in the cxx::bridge.
+    pub(crate) cxxbridge_type: Box<Type>,
+    pub(crate) mutable: bool,
+    /// The C++ global to which the accessor gives access.
+    pub(crate) global: QualifiedName,
     pub(crate) deps: HashSet<QualifiedName>,
 }
 
@@ -122,12 +147,28 @@ impl AnalysisPhase for FnAnalysis {
     type TypedefAnalysis = TypedefAnalysisBody;
     type StructAnalysis = PodStructAnalysisBody;
     type FunAnalysis = FnAnalysisBody;
+    type StaticAnalysis = StaticAnalysisBody;
+    type EnumAnalysis = EnumKind;
+}
+
+/// A default constructor for which we'll also generate `make_vector`.
+/// We do that only once all functions have been analyzed, so that we
+/// know the names of all the type's C++ methods and can avoid them.
+struct PendingVectorConstructor {
+    self_ty: QualifiedName,
+    fun: Box<FuncToConvert>,
+    vis: Visibility,
+    requires_unsafe: bool,
 }
 
 pub(crate) struct FnAnalyzer<'a> {
     unsafe_policy: UnsafePolicy,
     rust_name_tracker: RustNameTracker,
     extra_apis: Vec<UnanalyzedApi>,
+    vector_constructors: Vec<PendingVectorConstructor>,
+    /// Types whose methods we don't generate, but which we know to have
+    /// pure virtual methods.
+    unlisted_abstract_types: HashSet<QualifiedName>,
     type_converter: TypeConverter<'a>,
     bridge_name_tracker: BridgeNameTracker,
     pod_safe_types: HashSet<QualifiedName>,
@@ -145,26 +186,51 @@ impl<'a> FnAnalyzer<'a> {
             unsafe_policy,
             rust_name_tracker: RustNameTracker::new(),
             extra_apis: Vec::new(),
+            vector_constructors: Vec::new(),
+            unlisted_abstract_types: HashSet::new(),
             type_converter: TypeConverter::new(config, &apis),
             bridge_name_tracker: BridgeNameTracker::new(),
             config,
             overload_trackers_by_mod: HashMap::new(),
-            pod_safe_types: Self::build_pod_safe_type_set(&apis),
+            pod_safe_types: Self::build_pod_safe_type_set(&apis, config),
         };
         let mut results = Vec::new();
+        // Both functions and statics need mutable access to the analyzer.
+        let me = RefCell::new(me);
         convert_apis(
             apis,
             &mut results,
-            |name, fun, _| me.analyze_foreign_fn(name, fun),
+            |name, fun, _| me.borrow_mut().analyze_foreign_fn(name, fun),
             Api::struct_unchanged,
             Api::enum_unchanged,
             Api::typedef_unchanged,
+            |name, static_item, _| me.borrow_mut().analyze_static(name, static_item),
+        );
+        let mut me = me.into_inner();
+        results.extend(
+            std::mem::take(&mut me.extra_apis)
+                .into_iter()
+                .map(add_analysis),
         );
-        results.extend(me.extra_apis.into_iter().map(add_analysis));
+        for pending in std::mem::take(&mut me.vector_constructors) {
+            results.push(me.make_vector_constructor(pending));
+        }
+        // Whether a type is abstract matters even if we don't generate
+        // its methods, for example if it's the base of a class we do.
+        for api in results.iter_mut() {
+            if let Api::Struct { name, analysis, .. } = api {
+                if me.unlisted_abstract_types.contains(&name.name) {
+                    analysis.kind = TypeKind::Abstract;
+                }
+            }
+        }
         results
     }
 
-    fn build_pod_safe_type_set(apis: &[Api<PodAnalysis>]) -> HashSet<QualifiedName> {
+    fn build_pod_safe_type_set(
+        apis: &[Api<PodAnalysis>],
+        config: &IncludeCppConfig,
+    ) -> HashSet<QualifiedName> {
         apis.iter()
             .filter_map(|api| match api {
                 Api::Struct {
@@ -179,7 +245,7 @@ impl<'a> FnAnalyzer<'a> {
                 _ => None,
             })
             .chain(
-                known_types()
+                known_types_for(config.target_triple())
                     .get_pod_safe_types()
                     .filter_map(
                         |(tn, is_pod_safe)| {
@@ -303,9 +369,6 @@ impl<'a> FnAnalyzer<'a> {
             .next()
             .cloned();
 
-        let requires_unsafe =
-            self.should_be_unsafe() || param_details.iter().any(|pd| pd.requires_unsafe);
-
         // End of parameter processing.
         // Work out naming, part one.
         // The Rust name... it's more complicated.
@@ -351,6 +414,9 @@ impl<'a> FnAnalyzer<'a> {
                 // virally as arguments on other allowlisted types. But we don't want
                 // to generate methods unless the user has specifically asked us to.
                 // It may, for instance, be a private type.
+                if has_attr(&fun.attrs, "bindgen_pure_virtual") {
+                    self.unlisted_abstract_types.insert(self_ty);
+                }
                 return Ok(None);
             }
 
@@ -498,7 +564,7 @@ impl<'a> FnAnalyzer<'a> {
             }
         }
         let mut ret_type = return_analysis.rt;
-        let ret_type_conversion = return_analysis.conversion;
+        let mut ret_type_conversion = return_analysis.conversion;
 
         // Do we need to convert either parameters or return type?
         let param_conversion_needed = param_details.iter().any(|b| b.conversion.cpp_work_needed());
@@ -509,6 +575,37 @@ impl<'a> FnAnalyzer<'a> {
         let effective_cpp_name = cpp_name.as_ref().unwrap_or(&rust_name);
         let cpp_name_incompatible_with_cxx =
             validate_ident_ok_for_rust(&effective_cpp_name).is_err();
+        let profile_name = match kind {
+            FnKind::Method(ref self_ty, _) => {
+                format!("{}::{}", self_ty.to_cpp_name(), effective_cpp_name)
+            }
+            FnKind::Function => {
+                QualifiedName::new(&ns, make_ident(&effective_cpp_name)).to_cpp_name()
+            }
+        };
+        let hotness = self.config.hotness(&profile_name);
+        // const char* appears in Rust as &CStr only if the user asks.
+        let c_string_policy = self.config.c_string_policy(&profile_name);
+        if c_string_policy != CStringPolicy::RawPointers {
+            for pd in param_details.iter_mut() {
+                if is_c_string(&pd.conversion.unwrapped_type) {
+                    pd.conversion =
+                        TypeConversionPolicy::new_from_cstr(pd.conversion.unwrapped_type.clone());
+                    // A &CStr is as safe as any reference.
+                    pd.requires_unsafe = false;
+                }
+            }
+            if let Some(conversion) = &mut ret_type_conversion {
+                if is_c_string(&conversion.unwrapped_type) {
+                    *conversion = TypeConversionPolicy::new_to_cstr(
+                        conversion.unwrapped_type.clone(),
+                        c_string_policy == CStringPolicy::CStrNulTerminated,
+                    );
+                }
+            }
+        }
+        let requires_unsafe =
+            self.should_be_unsafe() || param_details.iter().any(|pd| pd.requires_unsafe);
         // If possible, we'll put knowledge of the C++ API directly into the cxx::bridge
         // mod. However, there are various circumstances where cxx can't work with the existing
         // C++ API and we need to create a C++ wrapper function which is more cxx-compliant.
@@ -580,13 +677,14 @@ impl<'a> FnAnalyzer<'a> {
                 ));
             }
 
-            Some(AdditionalNeed::FunctionWrapper(Box::new(FunctionWrapper {
+            Some(FunctionWrapper {
                 payload,
                 wrapper_function_name: cxxbridge_name.clone(),
-                return_conversion: ret_type_conversion,
+                return_conversion: ret_type_conversion.clone(),
                 argument_conversion: param_details.iter().map(|d| d.conversion.clone()).collect(),
                 is_a_method: has_receiver,
-            })))
+                hotness,
+            })
         } else {
             None
         };
@@ -618,6 +716,21 @@ impl<'a> FnAnalyzer<'a> {
             }
         };
 
+        // This constructor is acceptable, so if it's a default
+        // constructor, we can also offer a make_vector if asked.
+        if let FnKind::Method(ref self_ty, MethodKind::Constructor) = kind {
+            if param_details.is_empty()
+                && self.config.is_make_vector_requested(&self_ty.to_cpp_name())
+            {
+                self.vector_constructors.push(PendingVectorConstructor {
+                    self_ty: self_ty.clone(),
+                    fun: func_information.clone(),
+                    vis: vis.clone(),
+                    requires_unsafe,
+                });
+            }
+        }
+
         Ok(Some(Api::Function {
             fun: func_information,
             analysis: FnAnalysisBody {
@@ -627,11 +740,13 @@ impl<'a> FnAnalyzer<'a> {
                 params,
                 kind,
                 ret_type,
+                ret_conversion: ret_type_conversion,
                 param_details,
                 requires_unsafe,
                 vis,
                 cpp_wrapper,
                 deps,
+                hotness,
             },
             name: ApiName {
                 cpp_name,
@@ -640,6 +755,134 @@ impl<'a> FnAnalyzer<'a> {
         }))
     }
 
+    /// For a default constructor, generate a companion `make_vector(n)`
+    /// which constructs many instances within a single `std::vector`,
+    /// rather than needing an FFI call and heap allocation for each one.
+    /// We only do this for default constructors because the `std::vector`
+    /// constructor we use then requires nothing else of the type, whereas
+    /// anything else would require it to be movable or copyable.
+    /// The Rust name goes through the same overload tracking as the
+    /// type's real methods, so if it already has a `make_vector` we'll
+    /// call ours `make_vector1`.
+    fn make_vector_constructor(&mut self, pending: PendingVectorConstructor) -> Api<FnAnalysis> {
+        let PendingVectorConstructor {
+            self_ty,
+            fun,
+            vis,
+            requires_unsafe,
+        } = pending;
+        let ns = self_ty.get_namespace();
+        let rust_name = self
+            .overload_trackers_by_mod
+            .entry(ns.clone())
+            .or_default()
+            .get_method_real_name(self_ty.get_final_item(), "make_vector".to_string());
+        let cxxbridge_name =
+            self.get_cxx_bridge_name(Some(self_ty.get_final_item()), &rust_name, ns);
+        let cxxbridge_name = make_ident(format!("{}_autocxx_wrapper", cxxbridge_name));
+        let constructed_type = self_ty.to_type_path();
+        let return_conversion = TypeConversionPolicy::new_to_unique_ptr(parse_quote! {
+            cxx::CxxVector<#constructed_type>
+        });
+        let ret_type = return_conversion.unconverted_rust_type().into_owned();
+        let size_conversion = TypeConversionPolicy::new_unconverted(parse_quote! { usize });
+        let mut deps = HashSet::new();
+        deps.insert(self_ty.clone());
+        Api::Function {
+            name: ApiName::new(ns, make_ident(&rust_name)),
+            fun,
+            analysis: FnAnalysisBody {
+                cpp_wrapper: Some(FunctionWrapper {
+                    payload: FunctionWrapperPayload::VectorConstructor,
+                    wrapper_function_name: cxxbridge_name.clone(),
+                    return_conversion: Some(return_conversion.clone()),
+                    argument_conversion: vec![size_conversion.clone()],
+                    is_a_method: false,
+                    hotness: Hotness::Unknown,
+                }),
+                cxxbridge_name,
+                rust_name,
+                rust_rename_strategy: RustRenameStrategy::None,
+                params: parse_quote! { n: usize },
+                kind: FnKind::Method(self_ty.clone(), MethodKind::Constructor),
+                ret_type: parse_quote! { -> #ret_type },
+                ret_conversion: Some(return_conversion),
+                param_details: vec![ArgumentAnalysis {
+                    conversion: size_conversion,
+                    name: parse_quote! { n },
+                    self_type: None,
+                    was_reference: false,
+                    deps: HashSet::new(),
+                    is_virtual: false,
+                    requires_unsafe: false,
+                }],
+                requires_unsafe,
+                vis,
+                deps,
+                hotness: Hotness::Unknown,
+            },
+        }
+    }
+
+    /// Work out how to expose a global variable. C++ gives us
+    /// no portable way to find its address from Rust, so we generate
+    /// a trivial C++ accessor which returns it. The Rust side calls
+    /// that only once.
+    fn analyze_static(
+        &mut self,
+        name: ApiName,
+        static_item: ForeignItemStatic,
+    ) -> Result<Option<Api<FnAnalysis>>, ConvertErrorWithContext> {
+        let ns = name.name.get_namespace().clone();
+        let rust_name = static_item.ident.to_string();
+        let error_context = ErrorContext::Item(static_item.ident.clone());
+        let contextualize_error = |err| ConvertErrorWithContext(err, Some(error_context.clone()));
+        // bindgen emits 'static mut' for anything which isn't const.
+        let mutable = static_item.mutability.is_some();
+        let ty = &static_item.ty;
+        let ptr_ty: Box<Type> = if mutable {
+            parse_quote! { *mut #ty }
+        } else {
+            parse_quote! { *const #ty }
+        };
+        let (cxxbridge_type, deps, _) = self
+            .convert_boxed_type(ptr_ty, &ns, false)
+            .map_err(contextualize_error)?;
+        let cxxbridge_name =
+            self.get_cxx_bridge_name(None, &format!("{}_autocxx_global", rust_name), &ns);
+        let cxxbridge_name = make_ident(&cxxbridge_name);
+        // bindgen flattens static data members such as Foo::bar into
+        // globals called Foo_bar, so where we can we use the mangled name
+        // to find how C++ spells the variable.
+        let global = match get_link_name(&static_item.attrs) {
+            None => {
+                let cpp_name = name.cpp_name.as_ref().unwrap_or(&rust_name);
+                QualifiedName::new(&ns, make_ident(cpp_name))
+            }
+            Some(link_name) => {
+                let mut components = demangle_variable_name(&link_name).ok_or_else(|| {
+                    contextualize_error(ConvertError::UnrecognizedLinkName(link_name))
+                })?;
+                let final_item = components.pop().unwrap();
+                let global_ns = components
+                    .into_iter()
+                    .fold(Namespace::new(), |ns, segment| ns.push(segment));
+                QualifiedName::new(&global_ns, make_ident(final_item))
+            }
+        };
+        Ok(Some(Api::Static {
+            analysis: StaticAnalysisBody {
+                cxxbridge_name,
+                global,
+                cxxbridge_type,
+                mutable,
+                deps,
+            },
+            name,
+            static_item,
+        }))
+    }
+
     fn convert_fn_arg(
         &mut self,
         arg: &FnArg,
@@ -725,11 +968,19 @@ impl<'a> FnAnalyzer<'a> {
         })
     }
 
+    /// Whether values of this type can be passed to and from C++ directly,
+    /// rather than in a [cxx::UniquePtr]. That's true of POD types, and
+    /// of smart pointers (per `smart_ptr!`) which are no bigger than a
+    /// pointer anyway.
+    fn is_by_value_safe(&self, tn: &QualifiedName) -> bool {
+        self.pod_safe_types.contains(tn) || self.type_converter.is_smart_pointer(tn)
+    }
+
     fn argument_conversion_details(&self, ty: &Type) -> TypeConversionPolicy {
         match ty {
             Type::Path(p) => {
                 let tn = QualifiedName::from_type_path(p);
-                if self.pod_safe_types.contains(&tn) {
+                if self.is_by_value_safe(&tn) {
                     TypeConversionPolicy::new_unconverted(ty.clone())
                 } else if known_types().convertible_from_strs(&tn)
                     && !self.config.exclude_utilities()
@@ -747,7 +998,7 @@ impl<'a> FnAnalyzer<'a> {
         match ty {
             Type::Path(p) => {
                 let tn = QualifiedName::from_type_path(p);
-                if self.pod_safe_types.contains(&tn) {
+                if self.is_by_value_safe(&tn) {
                     TypeConversionPolicy::new_unconverted(ty.clone())
                 } else {
                     TypeConversionPolicy::new_to_unique_ptr(ty.clone())
@@ -835,6 +1086,7 @@ impl Api<FnAnalysis> {
                     make_ident(&analysis.rust_name),
                 ),
             },
+            Api::Subclass { superclass, .. } => superclass.clone(),
             _ => self.name().clone(),
         }
     }
@@ -845,17 +1097,45 @@ impl Api<FnAnalysis> {
     /// module) but, as it happens, even our Rust codegen phase needs to know if
     /// more C++ is needed (so it can add #includes in the cxx mod).
     /// And we can't answer the question _prior_ to this function analysis phase.
-    pub(crate) fn additional_cpp(&self) -> Option<AdditionalNeed> {
+    /// The returned [AdditionalNeed] borrows from this API, so asking
+    /// the question is cheap and can be done by each codegen phase.
+    pub(crate) fn additional_cpp(&self) -> Option<AdditionalNeed<'_>> {
         match &self {
-            Api::Function { analysis, .. } => analysis.cpp_wrapper.clone(),
+            Api::Function { analysis, .. } => analysis
+                .cpp_wrapper
+                .as_ref()
+                .map(AdditionalNeed::FunctionWrapper),
+            Api::Static { analysis, .. } => Some(AdditionalNeed::GlobalAccessor(
+                &analysis.cxxbridge_name,
+                &analysis.global,
+            )),
             Api::StringConstructor { .. } => Some(AdditionalNeed::MakeStringConstructor),
-            Api::ConcreteType { rs_definition, .. } => {
-                Some(AdditionalNeed::ConcreteTemplatedTypeTypedef(
-                    self.name().clone(),
-                    rs_definition.clone(),
-                ))
+            Api::ConcreteType { rs_definition, .. } => Some(
+                AdditionalNeed::ConcreteTemplatedTypeTypedef(self.name(), rs_definition),
+            ),
+            Api::CType { typename, .. } => Some(AdditionalNeed::CTypeTypedef(typename)),
+            Api::Struct { analysis, .. } => {
+                let flags = TypeHelperFlags {
+                    relocatable: analysis.relocatable,
+                    declares_relocatable: analysis.declares_relocatable,
+                    rust_constructible: analysis.rust_constructible,
+                    layout: analysis.layout,
+                };
+                if analysis.traits.is_empty() && !flags.any() {
+                    None
+                } else {
+                    Some(AdditionalNeed::TraitHelpers(
+                        self.name(),
+                        &analysis.traits,
+                        flags,
+                    ))
+                }
             }
-            Api::CType { typename, .. } => Some(AdditionalNeed::CTypeTypedef(typename.clone())),
+            Api::Subclass {
+                superclass,
+                methods,
+                ..
+            } => Some(AdditionalNeed::Subclass(self.name(), superclass, methods)),
             _ => None,
         }
     }
@@ -863,22 +1143,35 @@ impl Api<FnAnalysis> {
     pub(crate) fn cxxbridge_name(&self) -> Option<Ident> {
         match self {
             Api::Function { ref analysis, .. } => Some(analysis.cxxbridge_name.clone()),
-            Api::StringConstructor { .. } | Api::Const { .. } | Api::IgnoredItem { .. } => None,
+            Api::Static { ref analysis, .. } => Some(analysis.cxxbridge_name.clone()),
+            Api::StringConstructor { .. }
+            | Api::Const { .. }
+            | Api::BindgenLayout { .. }
+            | Api::IgnoredItem { .. } => None,
             _ => Some(self.name().get_final_ident()),
         }
     }
 
     /// Any dependencies on other APIs which this API has.
-    pub(crate) fn deps(&self) -> Box<dyn Iterator<Item = &QualifiedName> + '_> {
-        match self {
+    /// This is called for every API in several phases, so it avoids
+    /// boxing the iterator: every variant is expressed as an optional
+    /// single name followed by an optional set of names.
+    pub(crate) fn deps(&self) -> impl Iterator<Item = &QualifiedName> + '_ {
+        let (extra, deps) = match self {
             Api::Typedef {
                 old_tyname,
                 analysis: TypedefAnalysisBody { deps, .. },
                 ..
-            } => Box::new(old_tyname.iter().chain(deps.iter())),
-            Api::Struct { analysis, .. } => Box::new(analysis.field_deps.iter()),
-            Api::Function { analysis, .. } => Box::new(analysis.deps.iter()),
-            _ => Box::new(std::iter::empty()),
-        }
+            } => (old_tyname.as_ref(), Some(deps)),
+            Api::Struct { analysis, .. } => (None, Some(&analysis.field_deps)),
+            Api::Function { analysis, .. } => (None, Some(&analysis.deps)),
+            Api::Static { analysis, .. } => (None, Some(&analysis.deps)),
+            Api::BindgenLayout { deps, .. } => (None, Some(deps)),
+            Api::Subclass {
+                superclass, deps, ..
+            } => (Some(superclass), Some(deps)),
+            _ => (None, None),
+        };
+        extra.into_iter().chain(deps.into_iter().flatten())
     }
 }
@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-use syn::{Attribute, Ident};
+use syn::{punctuated::Punctuated, Attribute, Ident, Lit, Meta, NestedMeta, Token};
 
 use crate::conversion::convert_error::ErrorContext;
 
@@ -25,6 +25,8 @@ pub(crate) mod gc;
 mod name_check;
 pub(crate) mod pod; // hey, that rhymes
 pub(crate) mod remove_ignored;
+pub(crate) mod rust_constructors;
+pub(crate) mod subclass;
 pub(crate) mod tdef;
 mod type_converter;
 
@@ -63,3 +65,34 @@ fn remove_bindgen_attrs(
 fn has_attr(attrs: &[Attribute], attr_name: &str) -> bool {
     attrs.iter().any(|at| at.path.is_ident(attr_name))
 }
+
+/// Find the items within any `#[repr(...)]` attributes.
+fn get_repr_hints(attrs: &[Attribute]) -> impl Iterator<Item = Meta> + '_ {
+    attrs
+        .iter()
+        .filter(|a| a.path.is_ident("repr"))
+        .filter_map(|a| {
+            a.parse_args_with(Punctuated::<Meta, Token![,]>::parse_terminated)
+                .ok()
+        })
+        .flatten()
+}
+
+/// The alignment bindgen has told us a type needs, if it's more than
+/// the natural alignment of its fields; that is, `N` in `#[repr(align(N))]`.
+pub(crate) fn get_repr_align(attrs: &[Attribute]) -> Option<usize> {
+    get_repr_hints(attrs)
+        .filter_map(|m| match m {
+            Meta::List(ml) if ml.path.is_ident("align") => match ml.nested.first() {
+                Some(NestedMeta::Lit(Lit::Int(n))) => n.base10_parse().ok(),
+                _ => None,
+            },
+            _ => None,
+        })
+        .next()
+}
+
+/// Whether this is a `#[repr(packed)]` type.
+pub(crate) fn is_repr_packed(attrs: &[Attribute]) -> bool {
+    get_repr_hints(attrs).any(|m| m.path().is_ident("packed"))
+}
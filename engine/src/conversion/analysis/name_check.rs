@@ -37,8 +37,10 @@ pub(crate) fn check_names(apis: Vec<Api<FnAnalysis>>) -> Vec<Api<FnAnalysis>> {
         Api::Typedef { ref name, .. }
         | Api::ForwardDeclaration { ref name, .. }
         | Api::Const { ref name, .. }
+        | Api::Static { ref name, .. }
         | Api::Enum { ref name, .. }
-        | Api::Struct { ref name, .. } => {
+        | Api::Struct { ref name, .. }
+        | Api::Subclass { ref name, .. } => {
             validate_all_segments_ok_for_cxx(name.name.segment_iter())?;
             if let Some(ref cpp_name) = name.cpp_name {
                 // The C++ name might itself be outer_type::inner_type and thus may
@@ -58,6 +60,7 @@ pub(crate) fn check_names(apis: Vec<Api<FnAnalysis>>) -> Vec<Api<FnAnalysis>> {
             Ok(Some(api))
         }
         Api::ConcreteType { .. }
+        | Api::BindgenLayout { .. }
         | Api::CType { .. }
         | Api::StringConstructor { .. }
         | Api::IgnoredItem { .. } => Ok(Some(api)),
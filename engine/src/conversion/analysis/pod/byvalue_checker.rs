@@ -12,17 +12,20 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-use crate::{conversion::ConvertError, known_types::known_types};
+use crate::{
+    conversion::ConvertError,
+    known_types::{known_types, known_types_for, TypeDatabase},
+};
 use crate::{
     conversion::{
-        analysis::tdef::TypedefAnalysis,
+        analysis::{get_repr_align, is_repr_packed, tdef::TypedefAnalysis},
         api::{Api, TypedefKind},
     },
-    types::{Namespace, QualifiedName},
+    types::{make_ident, Namespace, QualifiedName},
 };
 use autocxx_parser::IncludeCppConfig;
-use std::collections::HashMap;
-use syn::{ItemStruct, Type};
+use std::collections::{HashMap, HashSet};
+use syn::{Attribute, Field, Item, ItemStruct, ItemUnion, Type};
 
 #[derive(Clone)]
 enum PodState {
@@ -36,6 +39,8 @@ enum PodState {
 struct StructDetails {
     state: PodState,
     dependent_structs: Vec<QualifiedName>,
+    /// Whether this has a `#[repr(align)]`, or contains something which does.
+    over_aligned: bool,
 }
 
 impl StructDetails {
@@ -43,6 +48,7 @@ impl StructDetails {
         StructDetails {
             state,
             dependent_structs: Vec::new(),
+            over_aligned: false,
         }
     }
 }
@@ -56,12 +62,22 @@ impl StructDetails {
 pub struct ByValueChecker {
     // Mapping from type name to whether it is safe to be POD
     results: HashMap<QualifiedName, StructDetails>,
+    // Types which may be moved with memcpy despite having a destructor.
+    relocatable: HashSet<QualifiedName>,
+    // Those of the above which say so themselves, in a way cxx understands.
+    declares_relocatable: HashSet<QualifiedName>,
+    // The types known on the target.
+    known_types: &'static TypeDatabase,
 }
 
 impl ByValueChecker {
     pub fn new() -> Self {
+        Self::with_known_types(known_types())
+    }
+
+    fn with_known_types(known_types: &'static TypeDatabase) -> Self {
         let mut results = HashMap::new();
-        for (tn, by_value_safe) in known_types().get_pod_safe_types() {
+        for (tn, by_value_safe) in known_types.get_pod_safe_types() {
             let safety = if by_value_safe {
                 PodState::IsPod
             } else {
@@ -69,7 +85,12 @@ impl ByValueChecker {
             };
             results.insert(tn.clone(), StructDetails::new(safety));
         }
-        ByValueChecker { results }
+        ByValueChecker {
+            results,
+            relocatable: HashSet::new(),
+            declares_relocatable: HashSet::new(),
+            known_types,
+        }
     }
 
     /// Scan APIs to work out which are by-value safe. Constructs a [ByValueChecker]
@@ -78,7 +99,12 @@ impl ByValueChecker {
         apis: &[Api<TypedefAnalysis>],
         config: &IncludeCppConfig,
     ) -> Result<ByValueChecker, ConvertError> {
-        let mut byvalue_checker = ByValueChecker::new();
+        let mut byvalue_checker =
+            ByValueChecker::with_known_types(known_types_for(config.target_triple()));
+        byvalue_checker.declares_relocatable = find_relocatable_markers(apis);
+        byvalue_checker.relocatable = find_relocatable_requests(apis, config)
+            .chain(byvalue_checker.declares_relocatable.iter().cloned())
+            .collect();
         for blocklisted in config.get_blocklist() {
             let tn = QualifiedName::new_from_cpp_name(blocklisted);
             let safety = PodState::UnsafeToBePod(format!("type {} is on the blocklist", &tn));
@@ -94,7 +120,9 @@ impl ByValueChecker {
                         TypedefKind::Type(ref type_item) => match type_item.ty.as_ref() {
                             Type::Path(typ) => {
                                 let target_tn = QualifiedName::from_type_path(&typ);
-                                known_types().consider_substitution(&target_tn)
+                                byvalue_checker
+                                    .known_types
+                                    .consider_substitution(&target_tn)
                             }
                             _ => None,
                         },
@@ -120,12 +148,24 @@ impl ByValueChecker {
                         .results
                         .insert(api.name().clone(), StructDetails::new(PodState::IsPod));
                 }
+                Api::BindgenLayout { item, .. } => match item {
+                    Item::Struct(s) if s.ident == "__BindgenBitfieldUnit" => {
+                        // Just bytes.
+                        byvalue_checker
+                            .results
+                            .insert(api.name().clone(), StructDetails::new(PodState::IsPod));
+                    }
+                    Item::Struct(s) => {
+                        byvalue_checker.ingest_struct(s, &api.name().get_namespace())
+                    }
+                    Item::Union(u) => byvalue_checker.ingest_union(u, &api.name().get_namespace()),
+                    _ => {}
+                },
                 _ => {}
             }
         }
         let pod_requests = config
             .get_pod_requests()
-            .iter()
             .map(|ty| QualifiedName::new_from_cpp_name(ty))
             .collect();
         byvalue_checker
@@ -135,11 +175,38 @@ impl ByValueChecker {
     }
 
     fn ingest_struct(&mut self, def: &ItemStruct, ns: &Namespace) {
-        // For this struct, work out whether it _could_ be safe as a POD.
         let tyname = QualifiedName::new(ns, def.ident.clone());
+        self.ingest_fields(tyname, def.fields.iter(), &def.attrs, Self::has_vtable(def))
+    }
+
+    /// Unions are POD if all their members are.
+    fn ingest_union(&mut self, def: &ItemUnion, ns: &Namespace) {
+        let tyname = QualifiedName::new(ns, def.ident.clone());
+        self.ingest_fields(tyname, def.fields.named.iter(), &def.attrs, false)
+    }
+
+    fn ingest_fields<'a>(
+        &mut self,
+        tyname: QualifiedName,
+        fields: impl Iterator<Item = &'a Field>,
+        attrs: &[Attribute],
+        has_vtable: bool,
+    ) {
+        // For this struct, work out whether it _could_ be safe as a POD.
         let mut field_safety_problem = PodState::SafeToBePod;
-        let fieldlist = Self::get_field_types(def);
+        let mut over_aligned_field = None;
+        let fieldlist = Self::get_field_types(fields);
+        let relocatable = self.relocatable.contains(&tyname);
         for ty_id in &fieldlist {
+            // bindgen refers to the likes of std::unique_ptr by their
+            // C++ names. Such fields are fine in a relocatable type,
+            // whose destructor we call, but in any other type we'd
+            // leak whatever they own.
+            let ty_id = if relocatable {
+                self.known_types.canonical_name(ty_id)
+            } else {
+                ty_id
+            };
             match self.results.get(ty_id) {
                 None => {
                     field_safety_problem = PodState::UnsafeToBePod(format!(
@@ -149,6 +216,9 @@ impl ByValueChecker {
                     break;
                 }
                 Some(deets) => {
+                    if deets.over_aligned {
+                        over_aligned_field = Some(ty_id);
+                    }
                     if let PodState::UnsafeToBePod(reason) = &deets.state {
                         let new_reason = format!("Type {} could not be POD because its dependent type {} isn't safe to be POD. Because: {}", tyname, ty_id, reason);
                         field_safety_problem = PodState::UnsafeToBePod(new_reason);
@@ -157,14 +227,24 @@ impl ByValueChecker {
                 }
             }
         }
-        if Self::has_vtable(def) {
+        if has_vtable {
             let reason = format!(
                 "Type {} could not be POD because it has virtual functions.",
                 tyname
             );
             field_safety_problem = PodState::UnsafeToBePod(reason);
         }
+        // Rust can't represent a packed type containing an over-aligned
+        // type, so we'd have no way to give this the right layout.
+        if let Some(over_aligned_field) = over_aligned_field.filter(|_| is_repr_packed(attrs)) {
+            let reason = format!(
+                "Type {} could not be POD because it is packed but contains the over-aligned type {}",
+                tyname, over_aligned_field
+            );
+            field_safety_problem = PodState::UnsafeToBePod(reason);
+        }
         let mut my_details = StructDetails::new(field_safety_problem);
+        my_details.over_aligned = get_repr_align(attrs).is_some() || over_aligned_field.is_some();
         my_details.dependent_structs = fieldlist;
         self.results.insert(tyname, my_details);
     }
@@ -225,14 +305,47 @@ impl ByValueChecker {
             self.results.get(ty_id),
             Some(StructDetails {
                 state: PodState::IsPod,
-                dependent_structs: _,
+                ..
             })
         )
     }
 
-    fn get_field_types(def: &ItemStruct) -> Vec<QualifiedName> {
+    /// Whether this type was declared relocatable, per `relocatable!` or
+    /// its own `IsRelocatable` typedef.
+    pub fn is_relocatable(&self, ty_id: &QualifiedName) -> bool {
+        self.relocatable.contains(ty_id)
+    }
+
+    /// Whether this type has its own `IsRelocatable` typedef, such that
+    /// cxx already knows it's relocatable.
+    pub fn declares_relocatable(&self, ty_id: &QualifiedName) -> bool {
+        self.declares_relocatable.contains(ty_id)
+    }
+
+    /// Whether Rust runs any code when dropping something of this type:
+    /// true for cxx's smart pointers, for relocatable types (whose `Drop`
+    /// calls the C++ destructor) and for anything containing either.
+    pub fn has_drop_glue(&self, ty_id: &QualifiedName) -> bool {
+        let ty_id = self.known_types.canonical_name(ty_id);
+        if self.known_types.is_cxx_acceptable_generic(ty_id) || self.is_relocatable(ty_id) {
+            return true;
+        }
+        match self.results.get(ty_id) {
+            Some(StructDetails {
+                state: PodState::IsAlias(target),
+                ..
+            }) => self.has_drop_glue(target),
+            Some(deets) => deets
+                .dependent_structs
+                .iter()
+                .any(|dep| self.has_drop_glue(dep)),
+            None => false,
+        }
+    }
+
+    fn get_field_types<'a>(fields: impl Iterator<Item = &'a Field>) -> Vec<QualifiedName> {
         let mut results = Vec::new();
-        for f in &def.fields {
+        for f in fields {
             let fty = &f.ty;
             if let Type::Path(p) = fty {
                 results.push(QualifiedName::from_type_path(&p));
@@ -252,11 +365,56 @@ impl ByValueChecker {
     }
 }
 
+/// Types which the user says, per `relocatable!`, may be moved with
+/// `memcpy` despite having a destructor or move constructor.
+fn find_relocatable_requests<'a>(
+    apis: &'a [Api<TypedefAnalysis>],
+    config: &'a IncludeCppConfig,
+) -> impl Iterator<Item = QualifiedName> + 'a {
+    apis.iter().filter_map(move |api| match api {
+        Api::Struct { name, .. } if config.is_relocatable_requested(&name.name.to_cpp_name()) => {
+            Some(name.name.clone())
+        }
+        _ => None,
+    })
+}
+
+/// Types declaring `using IsRelocatable = std::true_type;`, which is how
+/// cxx recognizes types which may be moved with `memcpy`. bindgen names
+/// that nested typedef `T_IsRelocatable`. A marker aliasing anything
+/// else, e.g. `std::false_type`, doesn't count.
+fn find_relocatable_markers(apis: &[Api<TypedefAnalysis>]) -> HashSet<QualifiedName> {
+    apis.iter()
+        .filter_map(|api| match api {
+            Api::Typedef {
+                name,
+                item: TypedefKind::Type(ity),
+                ..
+            } if is_std_true_type(&ity.ty) => name
+                .name
+                .get_final_item()
+                .strip_suffix("_IsRelocatable")
+                .map(|ty| QualifiedName::new(name.name.get_namespace(), make_ident(ty))),
+            _ => None,
+        })
+        .collect()
+}
+
+fn is_std_true_type(ty: &Type) -> bool {
+    match ty {
+        Type::Path(typ) => {
+            let tn = QualifiedName::from_type_path(typ);
+            tn.get_final_item() == "true_type" && tn.to_cpp_name().starts_with("std::")
+        }
+        _ => false,
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::ByValueChecker;
     use crate::types::{Namespace, QualifiedName};
-    use syn::{parse_quote, Ident, ItemStruct};
+    use syn::{parse_quote, Ident, ItemStruct, ItemUnion};
 
     fn ty_from_ident(id: &Ident) -> QualifiedName {
         QualifiedName::new_from_cpp_name(&id.to_string())
@@ -321,6 +479,102 @@ mod tests {
         assert!(bvc.is_pod(&t_id));
     }
 
+    #[test]
+    fn test_with_std_unique_ptr() {
+        let mut bvc = ByValueChecker::new();
+        let t: ItemStruct = parse_quote! {
+            struct Bar {
+                a: root::std::unique_ptr<root::Foo>,
+                b: i64,
+            }
+        };
+        let t_id = ty_from_ident(&t.ident);
+        bvc.relocatable.insert(t_id.clone());
+        bvc.ingest_struct(&t, &Namespace::new());
+        bvc.satisfy_requests(vec![t_id.clone()]).unwrap();
+        assert!(bvc.is_pod(&t_id));
+        assert!(bvc.has_drop_glue(&t_id));
+    }
+
+    #[test]
+    fn test_with_std_unique_ptr_not_relocatable() {
+        let mut bvc = ByValueChecker::new();
+        let t: ItemStruct = parse_quote! {
+            struct Bar {
+                a: root::std::unique_ptr<root::Foo>,
+                b: i64,
+            }
+        };
+        let t_id = ty_from_ident(&t.ident);
+        bvc.ingest_struct(&t, &Namespace::new());
+        assert!(bvc.satisfy_requests(vec![t_id.clone()]).is_err());
+        assert!(!bvc.is_pod(&t_id));
+    }
+
+    #[test]
+    fn test_drop_glue() {
+        let mut bvc = ByValueChecker::new();
+        let t: ItemStruct = parse_quote! {
+            struct Foo {
+                a: i32,
+            }
+        };
+        bvc.ingest_struct(&t, &Namespace::new());
+        let t: ItemStruct = parse_quote! {
+            struct Bar {
+                a: Foo,
+                b: cxx::UniquePtr<CxxString>,
+            }
+        };
+        bvc.ingest_struct(&t, &Namespace::new());
+        let foo = QualifiedName::new_from_cpp_name("Foo");
+        let bar = QualifiedName::new_from_cpp_name("Bar");
+        assert!(!bvc.has_drop_glue(&foo));
+        assert!(bvc.has_drop_glue(&bar));
+    }
+
+    #[test]
+    fn test_union() {
+        let mut bvc = ByValueChecker::new();
+        let u: ItemUnion = parse_quote! {
+            union Foo__bindgen_ty_1 {
+                a: i32,
+                b: f32,
+            }
+        };
+        bvc.ingest_union(&u, &Namespace::new());
+        let t: ItemStruct = parse_quote! {
+            struct Foo {
+                __bindgen_anon_1: Foo__bindgen_ty_1,
+                b: i64,
+            }
+        };
+        let t_id = ty_from_ident(&t.ident);
+        bvc.ingest_struct(&t, &Namespace::new());
+        bvc.satisfy_requests(vec![t_id.clone()]).unwrap();
+        assert!(bvc.is_pod(&t_id));
+    }
+
+    #[test]
+    fn test_union_with_cxxstring() {
+        let mut bvc = ByValueChecker::new();
+        let u: ItemUnion = parse_quote! {
+            union Foo__bindgen_ty_1 {
+                a: i32,
+                b: CxxString,
+            }
+        };
+        bvc.ingest_union(&u, &Namespace::new());
+        let t: ItemStruct = parse_quote! {
+            struct Foo {
+                __bindgen_anon_1: Foo__bindgen_ty_1,
+            }
+        };
+        let t_id = ty_from_ident(&t.ident);
+        bvc.ingest_struct(&t, &Namespace::new());
+        assert!(bvc.satisfy_requests(vec![t_id]).is_err());
+    }
+
     #[test]
     fn test_with_cxxstring() {
         let mut bvc = ByValueChecker::new();
@@ -334,4 +588,41 @@ mod tests {
         bvc.ingest_struct(&t, &Namespace::new());
         assert!(bvc.satisfy_requests(vec![t_id]).is_err());
     }
+
+    #[test]
+    fn test_with_simd_vector() {
+        let mut bvc = ByValueChecker::new();
+        let t: ItemStruct = parse_quote! {
+            struct Particle {
+                pos: root::__m128,
+                mass: f32,
+            }
+        };
+        let t_id = ty_from_ident(&t.ident);
+        bvc.ingest_struct(&t, &Namespace::new());
+        bvc.satisfy_requests(vec![t_id.clone()]).unwrap();
+        assert!(bvc.is_pod(&t_id));
+    }
+
+    #[test]
+    fn test_packed_with_over_aligned_field() {
+        let mut bvc = ByValueChecker::new();
+        let t: ItemStruct = parse_quote! {
+            #[repr(C)]
+            #[repr(align(64))]
+            struct Counter {
+                a: u64,
+            }
+        };
+        bvc.ingest_struct(&t, &Namespace::new());
+        let t: ItemStruct = parse_quote! {
+            #[repr(C, packed)]
+            struct Holder {
+                c: Counter,
+            }
+        };
+        let t_id = ty_from_ident(&t.ident);
+        bvc.ingest_struct(&t, &Namespace::new());
+        assert!(bvc.satisfy_requests(vec![t_id]).is_err());
+    }
 }
@@ -16,20 +16,21 @@ mod byvalue_checker;
 
 use std::collections::HashSet;
 
-use autocxx_parser::IncludeCppConfig;
+use autocxx_parser::{CppTrait, IncludeCppConfig};
 use byvalue_checker::ByValueChecker;
-use syn::{ItemEnum, ItemStruct, Type};
+use syn::{parse_quote, Field, Item, ItemEnum, ItemStruct, Meta, Type};
 
 use crate::{
     conversion::{
         analysis::type_converter::{add_analysis, TypeConversionContext, TypeConverter},
-        api::{AnalysisPhase, Api, ApiName, TypeKind, UnanalyzedApi},
+        api::{AnalysisPhase, Api, ApiName, CppLayout, TypeKind, UnanalyzedApi},
         codegen_rs::make_non_pod,
         convert_error::{ConvertErrorWithContext, ErrorContext},
         error_reporter::convert_apis,
         ConvertError,
     },
-    types::{Namespace, QualifiedName},
+    known_types::known_types,
+    types::{is_bindgen_layout_type, Namespace, QualifiedName},
 };
 
 use super::tdef::{TypedefAnalysis, TypedefAnalysisBody};
@@ -38,6 +39,32 @@ pub(crate) struct PodStructAnalysisBody {
     pub(crate) kind: TypeKind,
     pub(crate) bases: HashSet<QualifiedName>,
     pub(crate) field_deps: HashSet<QualifiedName>,
+    /// Whether we can generate `new` and `Default` entirely in Rust.
+    /// Determined after function analysis.
+    pub(crate) rust_constructible: bool,
+    /// Rust traits to implement using C++ operators, per `impl_traits!`.
+    pub(crate) traits: Vec<CppTrait>,
+    /// Whether this POD type has a destructor or move constructor but
+    /// may nevertheless be moved around with `memcpy`, so it's held
+    /// by value in Rust and destroyed in place by a `Drop` implementation.
+    pub(crate) relocatable: bool,
+    /// Whether this relocatable type says so itself, with an
+    /// `IsRelocatable` typedef which cxx will find.
+    pub(crate) declares_relocatable: bool,
+    /// The size and alignment bindgen found, which the generated C++
+    /// checks even if Rust knows nothing of the type's layout.
+    pub(crate) layout: Option<CppLayout>,
+}
+
+/// How a C++ enum is represented in Rust.
+pub(crate) enum EnumKind {
+    /// A Rust `enum` with one variant per enumerator. Any other value
+    /// arriving from C++ is undefined behavior.
+    Enum,
+    /// A `#[repr(transparent)]` newtype around the given integer type,
+    /// with an associated constant per enumerator. Any value is valid,
+    /// and there's much less for rustc to do for huge enums.
+    Newtype(Type),
 }
 
 pub(crate) struct PodAnalysis;
@@ -46,6 +73,8 @@ impl AnalysisPhase for PodAnalysis {
     type TypedefAnalysis = TypedefAnalysisBody;
     type StructAnalysis = PodStructAnalysisBody;
     type FunAnalysis = ();
+    type StaticAnalysis = ();
+    type EnumAnalysis = EnumKind;
 }
 
 /// In our set of APIs, work out which ones are safe to represent
@@ -69,17 +98,20 @@ pub(crate) fn analyze_pod_apis(
         apis,
         &mut results,
         Api::fun_unchanged,
-        |name, item, _| {
+        |name, item, layout| {
             analyze_struct(
                 &byvalue_checker,
+                config,
                 &mut type_converter,
                 &mut extra_apis,
                 name,
                 item,
+                layout,
             )
         },
-        analyze_enum,
+        |name, item, _| analyze_enum(config, name, item),
         Api::typedef_unchanged,
+        Api::static_unchanged,
     );
     // Conceivably, the process of POD-analysing the first set of APIs could result
     // in us creating new APIs to concretize generic types.
@@ -92,38 +124,98 @@ pub(crate) fn analyze_pod_apis(
         |name, item, _| {
             analyze_struct(
                 &byvalue_checker,
+                config,
                 &mut type_converter,
                 &mut more_extra_apis,
                 name,
                 item,
+                None,
             )
         },
-        analyze_enum,
+        |name, item, _| analyze_enum(config, name, item),
         Api::typedef_unchanged,
+        Api::static_unchanged,
     );
     assert!(more_extra_apis.is_empty());
+    // Bitfield accessors refer to the fields of their struct, which
+    // no longer exist if we've made it opaque. Likewise its size no longer
+    // matches C++, so we can't check its layout in Rust; the C++ side
+    // still checks it, per [PodStructAnalysisBody::layout].
+    results.retain(|api| match api {
+        Api::BindgenLayout {
+            name,
+            item: Item::Impl(_) | Item::Const(_),
+            ..
+        } => byvalue_checker.is_pod(&name.name),
+        _ => true,
+    });
     Ok(results)
 }
 
 fn analyze_enum(
+    config: &IncludeCppConfig,
     name: ApiName,
     mut item: ItemEnum,
 ) -> Result<Option<Api<PodAnalysis>>, ConvertErrorWithContext> {
     super::remove_bindgen_attrs(&mut item.attrs, name.name.get_final_ident())?;
-    Ok(Some(Api::Enum { name, item }))
+    let analysis = if config.is_newtype_enum(&name.name.to_cpp_name()) {
+        // bindgen always tells us the underlying integer type of the
+        // enums it generates.
+        match get_enum_repr(&item) {
+            Some(repr) => EnumKind::Newtype(repr),
+            None => {
+                return Err(ConvertErrorWithContext(
+                    ConvertError::UnsupportedType(format!(
+                        "enum {} has no integer representation, so can't be a newtype",
+                        name.name.to_cpp_name()
+                    )),
+                    Some(ErrorContext::Item(name.name.get_final_ident())),
+                ))
+            }
+        }
+    } else {
+        EnumKind::Enum
+    };
+    Ok(Some(Api::Enum {
+        name,
+        item,
+        analysis,
+    }))
+}
+
+/// The integer type given in an enum's `#[repr(...)]` attribute.
+fn get_enum_repr(item: &ItemEnum) -> Option<Type> {
+    super::get_repr_hints(&item.attrs)
+        .filter_map(|m| match m {
+            Meta::Path(p) => p.get_ident().cloned(),
+            _ => None,
+        })
+        .find(|id| {
+            [
+                "i8", "i16", "i32", "i64", "isize", "u8", "u16", "u32", "u64", "usize",
+            ]
+            .iter()
+            .any(|int| id == int)
+        })
+        .map(|id| parse_quote! { #id })
 }
 
 fn analyze_struct(
     byvalue_checker: &ByValueChecker,
+    config: &IncludeCppConfig,
     type_converter: &mut TypeConverter,
     extra_apis: &mut Vec<UnanalyzedApi>,
     name: ApiName,
     mut item: ItemStruct,
+    layout: Option<CppLayout>,
 ) -> Result<Option<Api<PodAnalysis>>, ConvertErrorWithContext> {
     let id = name.name.get_final_ident();
     super::remove_bindgen_attrs(&mut item.attrs, id.clone())?;
     let bases = get_bases(&item);
+    let traits = config.get_traits_for(&name.name.to_cpp_name()).to_vec();
     let mut field_deps = HashSet::new();
+    let mut relocatable = false;
+    let mut declares_relocatable = false;
     let type_kind = if byvalue_checker.is_pod(&name.name) {
         // It's POD so let's mark dependencies on things in its field
         get_struct_field_types(
@@ -134,6 +226,12 @@ fn analyze_struct(
             extra_apis,
         )
         .map_err(|e| ConvertErrorWithContext(e, Some(ErrorContext::Item(id))))?;
+        substitute_container_field_types(&mut item);
+        relocatable = byvalue_checker.is_relocatable(&name.name);
+        if relocatable {
+            wrap_fields_in_manually_drop(byvalue_checker, &mut item);
+            declares_relocatable = byvalue_checker.declares_relocatable(&name.name);
+        }
         TypeKind::Pod
     } else {
         // It's non-POD. So also, make the fields opaque...
@@ -148,10 +246,56 @@ fn analyze_struct(
             kind: type_kind,
             bases,
             field_deps,
+            rust_constructible: false,
+            traits,
+            relocatable,
+            declares_relocatable,
+            layout,
         },
     }))
 }
 
+/// bindgen names fields of types like std::unique_ptr by their C++ names,
+/// for which there's no Rust definition. Refer to the cxx type instead.
+fn substitute_container_field_types(item: &mut ItemStruct) {
+    for f in item.fields.iter_mut() {
+        if let Type::Path(typ) = &mut f.ty {
+            let tn = QualifiedName::from_type_path(typ);
+            if !known_types().is_cxx_acceptable_generic(&tn) {
+                continue;
+            }
+            if let Some(mut substitute) = known_types().consider_substitution(&tn) {
+                if let (Some(from), Some(to)) = (
+                    typ.path.segments.last(),
+                    substitute.path.segments.last_mut(),
+                ) {
+                    to.arguments = from.arguments.clone();
+                }
+                *typ = substitute;
+            }
+        }
+    }
+}
+
+/// The C++ destructor of a relocatable type takes care of its fields,
+/// so stop Rust from also dropping any field which has drop glue.
+fn wrap_fields_in_manually_drop(byvalue_checker: &ByValueChecker, item: &mut ItemStruct) {
+    for f in item.fields.iter_mut() {
+        if needs_drop(byvalue_checker, &f.ty) {
+            let ty = &f.ty;
+            f.ty = parse_quote! { ::std::mem::ManuallyDrop<#ty> };
+        }
+    }
+}
+
+fn needs_drop(byvalue_checker: &ByValueChecker, ty: &Type) -> bool {
+    match ty {
+        Type::Array(arr) => needs_drop(byvalue_checker, &arr.elem),
+        Type::Path(typ) => byvalue_checker.has_drop_glue(&QualifiedName::from_type_path(typ)),
+        _ => false,
+    }
+}
+
 fn get_struct_field_types(
     type_converter: &mut TypeConverter,
     ns: &Namespace,
@@ -160,6 +304,18 @@ fn get_struct_field_types(
     extra_apis: &mut Vec<UnanalyzedApi>,
 ) -> Result<(), ConvertError> {
     for f in &s.fields {
+        if let Type::Path(typ) = &f.ty {
+            // Types which bindgen made up to describe the layout have
+            // no C++ equivalent to convert them to.
+            let tn = QualifiedName::from_type_path(typ);
+            if is_bindgen_layout_type(tn.get_final_item()) {
+                deps.insert(tn);
+                continue;
+            }
+        }
+        if is_bitfield_alignment_field(f) {
+            continue;
+        }
         let annotated =
             type_converter.convert_type(f.ty.clone(), ns, &TypeConversionContext::CxxInnerType)?;
         extra_apis.extend(annotated.extra_apis);
@@ -168,6 +324,15 @@ fn get_struct_field_types(
     Ok(())
 }
 
+/// bindgen precedes bitfield storage with a zero-sized array
+/// to give it the right alignment.
+fn is_bitfield_alignment_field(f: &Field) -> bool {
+    f.ident
+        .as_ref()
+        .map(|id| id.to_string().starts_with("_bitfield_align_"))
+        .unwrap_or(false)
+}
+
 fn get_bases(item: &ItemStruct) -> HashSet<QualifiedName> {
     item.fields
         .iter()
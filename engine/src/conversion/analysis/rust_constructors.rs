@@ -0,0 +1,144 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use std::collections::HashSet;
+
+use autocxx_parser::IncludeCppConfig;
+use syn::{ItemStruct, Type, Visibility};
+
+use super::{
+    fun::{FnAnalysis, FnAnalysisBody, FnKind, MethodKind},
+    pod::PodStructAnalysisBody,
+};
+use crate::{
+    conversion::{
+        api::{Api, TypeKind},
+        ConvertError,
+    },
+    known_types::known_types,
+    types::QualifiedName,
+};
+
+/// Spot POD types which can be constructed purely in Rust, without
+/// calling into C++ at all. bindgen tells us nothing about default
+/// member initializers, nor about constructors it didn't emit or which
+/// we ignored, so we can't know that a C++ default constructor is
+/// trivial. This is therefore only done for types the user lists with
+/// `rust_constructible!`, and the generated C++ checks the claim. We
+/// additionally insist that we found no C++ constructors and that all
+/// fields are plain data, such that zero-initialization is exactly what
+/// C++ value-initialization would do. Any listed type which fails
+/// those checks is an error, much as for `generate_pod!`.
+pub(crate) fn mark_types_rust_constructible(
+    config: &IncludeCppConfig,
+    apis: &mut Vec<Api<FnAnalysis>>,
+) -> Result<(), ConvertError> {
+    let types_with_constructors: HashSet<_> = apis
+        .iter()
+        .filter_map(|api| match &api {
+            Api::Function {
+                analysis:
+                    FnAnalysisBody {
+                        kind: FnKind::Method(self_ty_name, MethodKind::Constructor),
+                        ..
+                    },
+                ..
+            } => Some(self_ty_name.clone()),
+            _ => None,
+        })
+        .collect();
+
+    // Structs may contain other structs, so keep going until
+    // nothing changes.
+    let mut constructible_types = HashSet::new();
+    let mut iterate = true;
+    while iterate {
+        iterate = false;
+        for mut api in apis.iter_mut() {
+            match &mut api {
+                Api::Struct {
+                    name,
+                    item,
+                    analysis:
+                        PodStructAnalysisBody {
+                            kind: TypeKind::Pod,
+                            bases,
+                            rust_constructible,
+                            ..
+                        },
+                } if !*rust_constructible
+                    && config.is_rust_constructible_requested(&name.name.to_cpp_name())
+                    && bases.is_empty()
+                    && !types_with_constructors.contains(&name.name)
+                    && all_fields_plain_data(item, &constructible_types) =>
+                {
+                    *rust_constructible = true;
+                    constructible_types.insert(name.name.clone());
+                    iterate = true;
+                }
+                _ => {}
+            }
+        }
+    }
+
+    for api in apis.iter() {
+        if let Api::Struct { name, analysis, .. } = api {
+            let cpp_name = name.name.to_cpp_name();
+            if analysis.rust_constructible || !config.is_rust_constructible_requested(&cpp_name) {
+                continue;
+            }
+            let reason = if analysis.kind != TypeKind::Pod {
+                "it isn't POD"
+            } else if !analysis.bases.is_empty() {
+                "it has base classes"
+            } else if types_with_constructors.contains(&name.name) {
+                "it has C++ constructors"
+            } else {
+                "some of its fields are private, or can't be zero-initialized"
+            };
+            return Err(ConvertError::NotRustConstructible(
+                cpp_name,
+                reason.to_string(),
+            ));
+        }
+    }
+    Ok(())
+}
+
+fn all_fields_plain_data(item: &ItemStruct, constructible_types: &HashSet<QualifiedName>) -> bool {
+    item.fields.iter().all(|f| {
+        // Private fields, or the '_bitfield_' and '__bindgen_anon_'
+        // fields bindgen uses for layout, can't sensibly be passed to 'new'.
+        matches!(f.vis, Visibility::Public(_))
+            && f.ident
+                .as_ref()
+                .map(|id| !id.to_string().starts_with('_'))
+                .unwrap_or(false)
+            && is_plain_data(&f.ty, constructible_types)
+    })
+}
+
+/// Whether an all-zeroes bit pattern is a valid, default, instance of
+/// this type. Notably that's not true of enums.
+fn is_plain_data(ty: &Type, constructible_types: &HashSet<QualifiedName>) -> bool {
+    match ty {
+        Type::Ptr(_) => true,
+        Type::Array(arr) => is_plain_data(&arr.elem, constructible_types),
+        Type::Path(typ) => {
+            let tn = QualifiedName::from_type_path(typ);
+            known_types().is_zero_initializable(&tn) || constructible_types.contains(&tn)
+        }
+        _ => false,
+    }
+}
@@ -0,0 +1,187 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use std::collections::HashSet;
+
+use autocxx_parser::{IncludeCppConfig, RustPath};
+use syn::{parse_quote, Path, Type};
+
+use super::{
+    fun::{
+        function_wrapper::{FunctionWrapperPayload, TypeConversionPolicy},
+        FnAnalysis, FnAnalysisBody, FnKind, MethodKind,
+    },
+    pod::PodStructAnalysisBody,
+};
+use crate::{
+    conversion::{
+        api::{Api, ApiName, SubclassMethod, TypeKind},
+        convert_error::{ConvertErrorWithContext, ErrorContext},
+        error_reporter::report_any_error,
+        ConvertError,
+    },
+    types::{flatten_path, make_ident, Namespace, QualifiedName},
+};
+
+/// Add an [Api::Subclass] for each `subclass!` directive, describing the
+/// pure virtual methods of the superclass which the Rust type must
+/// implement. This must run after function analysis, so that we know
+/// which methods are pure virtual and how their types are converted.
+pub(crate) fn add_subclass_apis(config: &IncludeCppConfig, apis: &mut Vec<Api<FnAnalysis>>) {
+    let mut new_apis: Vec<Api<FnAnalysis>> = Vec::new();
+    let mut superclasses_with_traits = HashSet::new();
+    for (superclass, rust_type) in config.get_subclasses() {
+        let superclass = QualifiedName::new_from_cpp_name(superclass);
+        let id = make_ident(flatten_path(
+            rust_type
+                .segments()
+                .iter()
+                .map(|segment| segment.to_string()),
+        ));
+        let api = report_any_error(&Namespace::new(), &mut new_apis, || {
+            let (methods, deps) = analyze_superclass(&superclass, apis).map_err(|err| {
+                ConvertErrorWithContext(err, Some(ErrorContext::Item(id.clone())))
+            })?;
+            Ok(Api::Subclass {
+                name: ApiName::new_in_root_namespace(id.clone()),
+                rust_path: path_from_generated_mod(rust_type),
+                defines_trait: superclasses_with_traits.insert(superclass.clone()),
+                superclass: superclass.clone(),
+                methods,
+                deps,
+            })
+        });
+        new_apis.extend(api);
+    }
+    apis.extend(new_apis);
+}
+
+/// The user names the Rust type relative to the module containing
+/// `include_cpp!`, but we refer to it from the mod generated within.
+fn path_from_generated_mod(rust_type: &RustPath) -> Path {
+    let segments = rust_type.segments();
+    match segments.first() {
+        _ if rust_type.has_leading_colon() => parse_quote! { ::#(#segments)::* },
+        Some(first) if first == "crate" => parse_quote! { #(#segments)::* },
+        Some(first) if first == "self" => {
+            let rest = &segments[1..];
+            parse_quote! { super::#(#rest)::* }
+        }
+        _ => parse_quote! { super::#(#segments)::* },
+    }
+}
+
+fn analyze_superclass(
+    superclass: &QualifiedName,
+    apis: &[Api<FnAnalysis>],
+) -> Result<(Vec<SubclassMethod>, HashSet<QualifiedName>), ConvertError> {
+    let bases = apis.iter().find_map(|api| match api {
+        Api::Struct {
+            name,
+            analysis:
+                PodStructAnalysisBody {
+                    kind: TypeKind::Abstract,
+                    bases,
+                    ..
+                },
+            ..
+        } if name.name == *superclass => Some(bases),
+        _ => None,
+    });
+    let bases = match bases {
+        Some(bases) => bases,
+        None => return Err(ConvertError::InvalidSubclassBase(superclass.to_cpp_name())),
+    };
+    // We override only the pure virtual methods declared on the class
+    // itself. Any inherited from an abstract base (or from a base we
+    // know nothing about) would leave our subclass abstract too.
+    let has_abstract_base = bases.iter().any(|base| {
+        let base_kind = apis.iter().find_map(|api| match api {
+            Api::Struct { name, analysis, .. } if name.name == *base => Some(analysis.kind),
+            _ => None,
+        });
+        !matches!(base_kind, Some(TypeKind::Pod) | Some(TypeKind::NonPod))
+    });
+    if has_abstract_base {
+        return Err(ConvertError::InvalidSubclassBase(superclass.to_cpp_name()));
+    }
+    let mut methods = Vec::new();
+    let mut deps = HashSet::new();
+    for api in apis {
+        if let Api::Function { analysis, .. } = api {
+            if matches!(&analysis.kind,
+                FnKind::Method(self_ty, MethodKind::PureVirtual) if self_ty == superclass)
+            {
+                methods.push(analyze_method(analysis).ok_or_else(|| {
+                    ConvertError::UnsupportedSubclassMethod(format!(
+                        "{}::{}",
+                        superclass.to_cpp_name(),
+                        analysis.rust_name
+                    ))
+                })?);
+                deps.extend(analysis.deps.iter().cloned());
+            }
+        }
+    }
+    if methods.is_empty() {
+        return Err(ConvertError::InvalidSubclassBase(superclass.to_cpp_name()));
+    }
+    Ok((methods, deps))
+}
+
+/// Work out how a Rust function can stand in for this pure virtual
+/// method. For now, we only support methods whose types can be passed
+/// straight through cxx in both directions, so there's no wrapper
+/// between the C++ override and the Rust implementation.
+fn analyze_method(analysis: &FnAnalysisBody) -> Option<SubclassMethod> {
+    let wrapper = analysis.cpp_wrapper.as_ref()?;
+    let cpp_name = match &wrapper.payload {
+        FunctionWrapperPayload::FunctionCall(_, id) => id.to_string(),
+        _ => return None,
+    };
+    let mut params = analysis.param_details.iter();
+    let this = params.next()?;
+    let is_const = matches!(this.conversion.unwrapped_type, Type::Reference(_));
+    let params = params
+        .map(|pd| {
+            if passes_straight_through(&pd.conversion)
+                && !matches!(pd.conversion.unwrapped_type, Type::Ptr(_))
+            {
+                Some((pd.name.clone(), pd.conversion.clone()))
+            } else {
+                None
+            }
+        })
+        .collect::<Option<Vec<_>>>()?;
+    let ret = match &wrapper.return_conversion {
+        Some(ret)
+            if !passes_straight_through(ret)
+                || matches!(ret.unwrapped_type, Type::Reference(_) | Type::Ptr(_)) =>
+        {
+            return None
+        }
+        ret => ret.clone(),
+    };
+    Some(SubclassMethod {
+        name: make_ident(&analysis.rust_name),
+        cpp_name,
+        is_const,
+        params,
+        ret,
+    })
+}
+
+fn passes_straight_through(conversion: &TypeConversionPolicy) -> bool {
+    !conversion.cpp_work_needed() && !conversion.rust_work_needed()
+}
@@ -20,7 +20,7 @@ use syn::ItemType;
 use crate::{
     conversion::{
         analysis::type_converter::{add_analysis, Annotated, TypeConversionContext, TypeConverter},
-        api::{AnalysisPhase, Api, ApiName, TypedefKind, UnanalyzedApi},
+        api::{AnalysisPhase, Api, ApiName, CppLayout, TypedefKind, UnanalyzedApi},
         convert_error::{ConvertErrorWithContext, ErrorContext},
         error_reporter::convert_apis,
         ConvertError,
@@ -41,8 +41,10 @@ pub(crate) struct TypedefAnalysis;
 
 impl AnalysisPhase for TypedefAnalysis {
     type TypedefAnalysis = TypedefAnalysisBody;
-    type StructAnalysis = ();
+    type StructAnalysis = Option<CppLayout>;
     type FunAnalysis = ();
+    type StaticAnalysis = ();
+    type EnumAnalysis = ();
 }
 
 #[allow(clippy::needless_collect)] // we need the extra collect because the closure borrows extra_apis
@@ -79,6 +81,7 @@ pub(crate) fn convert_typedef_targets(
                 },
             }))
         },
+        Api::static_unchanged,
     );
     results.extend(extra_apis.into_iter().map(add_analysis));
     results
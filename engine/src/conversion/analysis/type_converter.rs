@@ -18,14 +18,14 @@ use crate::{
         codegen_cpp::type_to_cpp::type_to_cpp,
         ConvertError,
     },
-    known_types::known_types,
+    known_types::{known_types_for, TypeDatabase},
     types::{make_ident, Namespace, QualifiedName},
 };
 use autocxx_parser::IncludeCppConfig;
 use quote::ToTokens;
 use std::collections::{HashMap, HashSet};
 use syn::{
-    parse_quote, punctuated::Punctuated, GenericArgument, PathArguments, PathSegment, Type,
+    parse_quote, punctuated::Punctuated, GenericArgument, Item, PathArguments, PathSegment, Type,
     TypePath, TypePtr,
 };
 
@@ -104,6 +104,9 @@ pub(crate) struct TypeConverter<'a> {
     types_found: HashSet<QualifiedName>,
     typedefs: HashMap<QualifiedName, Type>,
     concrete_templates: HashMap<String, QualifiedName>,
+    /// Those of our concrete types which instantiate a smart pointer
+    /// template named in `smart_ptr!`.
+    smart_pointers: HashSet<QualifiedName>,
     forward_declarations: HashSet<QualifiedName>,
     config: &'a IncludeCppConfig,
 }
@@ -117,11 +120,18 @@ impl<'a> TypeConverter<'a> {
             types_found: Self::find_types(apis),
             typedefs: Self::find_typedefs(apis),
             concrete_templates: Self::find_concrete_templates(apis),
+            smart_pointers: Self::find_smart_pointers(config, apis),
             forward_declarations: Self::find_incomplete_types(apis),
             config,
         }
     }
 
+    /// The types known on the target, which may have special names in
+    /// bindgen's output.
+    fn known_types(&self) -> &'static TypeDatabase {
+        known_types_for(self.config.target_triple())
+    }
+
     pub(crate) fn convert_boxed_type(
         &mut self,
         ty: Box<Type>,
@@ -151,7 +161,7 @@ impl<'a> TypeConverter<'a> {
                     // doesn't simply get renamed to a different type _identifier_.
                     // This plain type-by-value (as far as bindgen is concerned)
                     // is actually a &str.
-                    if known_types().should_dereference_in_cpp(&qn) {
+                    if self.known_types().should_dereference_in_cpp(&qn) {
                         Annotated::new(
                             Type::Reference(parse_quote! {
                                 &str
@@ -211,7 +221,7 @@ impl<'a> TypeConverter<'a> {
             // already, and if not, qualify it according to the current
             // namespace. This is a bit of a shortcut compared to having a full
             // resolution pass which can search all known namespaces.
-            if !known_types().is_known_type(&ty) {
+            if !self.known_types().is_known_type(&ty) {
                 let num_segments = typ.path.segments.len();
                 if num_segments > 1 {
                     return Err(ConvertError::UnsupportedBuiltInType(ty));
@@ -230,7 +240,11 @@ impl<'a> TypeConverter<'a> {
         }
 
         let original_tn = QualifiedName::from_type_path(&typ);
-        original_tn.validate_ok_for_cxx()?;
+        // Known types may have names which cxx couldn't cope with (e.g.
+        // __m128), but we'll substitute those below.
+        if !self.known_types().is_known_type(&original_tn) {
+            original_tn.validate_ok_for_cxx()?;
+        }
         if self.config.is_on_blocklist(&original_tn.to_cpp_name()) {
             return Err(ConvertError::Blocked(original_tn));
         }
@@ -259,7 +273,16 @@ impl<'a> TypeConverter<'a> {
 
         // Now let's see if it's a known type.
         // (We may entirely reject some types at this point too.)
-        let mut typ = match known_types().consider_substitution(&tn) {
+        // If asked, use plain Rust primitives for C integer types whose
+        // size is fixed on this target. We still record the C type in
+        // our deps, so that we generate assertions that this is right.
+        let primitive = if self.config.primitive_ctypes() {
+            self.known_types()
+                .primitive_for_ctype(&tn, self.config.target_triple())
+        } else {
+            None
+        };
+        let mut typ = match primitive.or_else(|| self.known_types().consider_substitution(&tn)) {
             Some(mut substitute_type) => {
                 if let Some(last_seg_args) =
                     typ.path.segments.into_iter().last().map(|ps| ps.arguments)
@@ -276,7 +299,7 @@ impl<'a> TypeConverter<'a> {
 
         // Finally let's see if it's generic.
         if let Some(last_seg) = Self::get_generic_args(&mut typ) {
-            if known_types().is_cxx_acceptable_generic(&tn) {
+            if self.known_types().is_cxx_acceptable_generic(&tn) {
                 // this is a type of generic understood by cxx (e.g. CxxVector)
                 // so let's convert any generic type arguments. This recurses.
                 self.confirm_inner_type_is_acceptable_generic_payload(
@@ -293,8 +316,15 @@ impl<'a> TypeConverter<'a> {
                 // Oh poop. It's a generic type which cxx won't be able to handle.
                 // We'll have to come up with a concrete type in both the cxx::bridge (in Rust)
                 // and a corresponding typedef in C++.
-                let (new_tn, api) = self.get_templated_typename(&Type::Path(typ))?;
+                let rs_definition = Type::Path(typ);
+                let (new_tn, api) = self.get_templated_typename(&rs_definition)?;
                 extra_apis.extend(api.into_iter());
+                if let Some(pointee) = smart_ptr_pointee(self.config, &rs_definition) {
+                    // The smart pointer derefs to its pointee, so we'll
+                    // need bindings for that too.
+                    deps.insert(QualifiedName::from_type_path(pointee));
+                    self.smart_pointers.insert(new_tn.clone());
+                }
                 deps.remove(&tn);
                 typ = new_tn.to_type_path();
                 deps.insert(new_tn);
@@ -400,6 +430,13 @@ impl<'a> TypeConverter<'a> {
         }
     }
 
+    /// Whether this is one of our concrete types which instantiates a
+    /// smart pointer template named in `smart_ptr!`. Such types are
+    /// passed by value, rather than via [cxx::UniquePtr].
+    pub(crate) fn is_smart_pointer(&self, tn: &QualifiedName) -> bool {
+        self.smart_pointers.contains(tn)
+    }
+
     fn confirm_inner_type_is_acceptable_generic_payload(
         &self,
         path_args: &PathArguments,
@@ -453,10 +490,16 @@ impl<'a> TypeConverter<'a> {
                 | Api::Typedef { .. }
                 | Api::Enum { .. }
                 | Api::Struct { .. } => Some(api.name()),
-                Api::StringConstructor { .. }
+                Api::BindgenLayout { item, .. } if !matches!(item, Item::Impl(_)) => {
+                    Some(api.name())
+                }
+                Api::BindgenLayout { .. }
+                | Api::StringConstructor { .. }
                 | Api::Function { .. }
                 | Api::Const { .. }
+                | Api::Static { .. }
                 | Api::CType { .. }
+                | Api::Subclass { .. }
                 | Api::IgnoredItem { .. } => None,
             })
             .cloned()
@@ -491,6 +534,22 @@ impl<'a> TypeConverter<'a> {
             .collect()
     }
 
+    fn find_smart_pointers<A: AnalysisPhase>(
+        config: &IncludeCppConfig,
+        apis: &[Api<A>],
+    ) -> HashSet<QualifiedName> {
+        apis.iter()
+            .filter_map(|api| match &api {
+                Api::ConcreteType { rs_definition, .. }
+                    if smart_ptr_pointee(config, rs_definition).is_some() =>
+                {
+                    Some(api.name().clone())
+                }
+                _ => None,
+            })
+            .collect()
+    }
+
     fn find_incomplete_types<A: AnalysisPhase>(apis: &[Api<A>]) -> HashSet<QualifiedName> {
         apis.iter()
             .filter_map(|api| match api {
@@ -502,6 +561,28 @@ impl<'a> TypeConverter<'a> {
     }
 }
 
+/// If this type instantiates a class template which the user has told
+/// us is a smart pointer (per `smart_ptr!`), the type it points to.
+pub(crate) fn smart_ptr_pointee<'b>(
+    config: &IncludeCppConfig,
+    ty: &'b Type,
+) -> Option<&'b TypePath> {
+    match ty {
+        Type::Path(typ)
+            if config.is_smart_pointer(&QualifiedName::from_type_path(typ).to_cpp_name()) =>
+        {
+            match &typ.path.segments.last()?.arguments {
+                PathArguments::AngleBracketed(ab) => match ab.args.first() {
+                    Some(GenericArgument::Type(Type::Path(pointee))) => Some(pointee),
+                    _ => None,
+                },
+                _ => None,
+            }
+        }
+        _ => None,
+    }
+}
+
 /// Processing functions sometimes results in new types being materialized.
 /// These types haven't been through the analysis phases (chicken and egg
 /// problem) but fortunately, don't need to. We need to keep the type
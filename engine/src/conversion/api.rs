@@ -12,12 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+use std::collections::HashSet;
+
 use crate::types::{Namespace, QualifiedName};
 use syn::{
-    ForeignItemFn, Ident, ImplItem, ItemConst, ItemEnum, ItemStruct, ItemType, ItemUse, Type,
+    ForeignItemFn, ForeignItemStatic, Ident, ImplItem, Item, ItemConst, ItemEnum, ItemStruct,
+    ItemType, ItemUse, Pat, Path, Type,
 };
 
 use super::{
+    analysis::fun::function_wrapper::TypeConversionPolicy,
     convert_error::{ConvertErrorWithContext, ErrorContext},
     ConvertError,
 };
@@ -56,21 +60,48 @@ pub(crate) struct FuncToConvert {
     pub(crate) self_ty: Option<QualifiedName>,
 }
 
+/// A pure virtual method which a Rust type implements on behalf of
+/// a C++ subclass.
+pub(crate) struct SubclassMethod {
+    /// The name of the method in Rust; also used for the trait method.
+    pub(crate) name: Ident,
+    /// The name of the C++ method being overridden.
+    pub(crate) cpp_name: String,
+    /// Whether `this` is const, in which case the Rust implementation
+    /// receives `&self` rather than `&mut self`.
+    pub(crate) is_const: bool,
+    /// Parameters other than `this`. None of these need any conversion.
+    pub(crate) params: Vec<(Pat, TypeConversionPolicy)>,
+    pub(crate) ret: Option<TypeConversionPolicy>,
+}
+
 /// Layers of analysis which may be applied to decorate each API.
 /// See description of the purpose of this trait within `Api`.
 pub(crate) trait AnalysisPhase {
     type TypedefAnalysis;
     type StructAnalysis;
     type FunAnalysis;
+    type StaticAnalysis;
+    type EnumAnalysis;
 }
 
-/// No analysis has been applied to this API.
+/// The size and alignment of a type, as clang told bindgen.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub(crate) struct CppLayout {
+    pub(crate) size: usize,
+    pub(crate) align: usize,
+}
+
+/// No analysis has been applied to this API, except that structs
+/// have their layout if bindgen told us it.
 pub(crate) struct NullAnalysis;
 
 impl AnalysisPhase for NullAnalysis {
     type TypedefAnalysis = ();
-    type StructAnalysis = ();
+    type StructAnalysis = Option<CppLayout>;
     type FunAnalysis = ();
+    type StaticAnalysis = ();
+    type EnumAnalysis = ();
 }
 
 #[derive(Clone)]
@@ -139,6 +170,13 @@ pub(crate) enum Api<T: AnalysisPhase> {
         name: ApiName,
         const_item: ItemConst,
     },
+    /// A global variable, for which we generate an accessor
+    /// which resolves its address once.
+    Static {
+        name: ApiName,
+        static_item: ForeignItemStatic,
+        analysis: T::StaticAnalysis,
+    },
     /// A typedef found in the bindgen output which we wish
     /// to pass on in our output
     Typedef {
@@ -149,7 +187,11 @@ pub(crate) enum Api<T: AnalysisPhase> {
     },
     /// An enum encountered in the
     /// `bindgen` output.
-    Enum { name: ApiName, item: ItemEnum },
+    Enum {
+        name: ApiName,
+        item: ItemEnum,
+        analysis: T::EnumAnalysis,
+    },
     /// A struct encountered in the
     /// `bindgen` output.
     Struct {
@@ -157,11 +199,36 @@ pub(crate) enum Api<T: AnalysisPhase> {
         item: ItemStruct,
         analysis: T::StructAnalysis,
     },
+    /// Something bindgen generated to describe the layout of a POD
+    /// struct, which cxx needn't know about: bitfield storage and
+    /// accessors, or an anonymous struct or union. We pass these through
+    /// unchanged into the bindgen mod.
+    BindgenLayout {
+        name: ApiName,
+        item: Item,
+        deps: HashSet<QualifiedName>,
+    },
     /// A variable-length C integer type (e.g. int, unsigned long).
     CType {
         name: ApiName,
         typename: QualifiedName,
     },
+    /// A C++ subclass of an abstract class, generated on behalf of
+    /// a Rust type, whose pure virtual methods each call straight into
+    /// that type's implementation of them. `name` is the name by which
+    /// cxx knows the Rust type: its path, flattened so that types of
+    /// the same name in different modules don't clash.
+    Subclass {
+        name: ApiName,
+        /// The path to the Rust type from within the generated mod.
+        rust_path: Path,
+        superclass: QualifiedName,
+        methods: Vec<SubclassMethod>,
+        /// Whether this is the first subclass of `superclass`, and so
+        /// should define the trait which Rust types implement.
+        defines_trait: bool,
+        deps: HashSet<QualifiedName>,
+    },
     /// Some item which couldn't be processed by autocxx for some reason.
     /// We will have emitted a warning message about this, but we want
     /// to mark that it's ignored so that we don't attempt to process
@@ -181,10 +248,13 @@ impl<T: AnalysisPhase> Api<T> {
             Api::StringConstructor { name } => name,
             Api::Function { name, .. } => name,
             Api::Const { name, .. } => name,
+            Api::Static { name, .. } => name,
             Api::Typedef { name, .. } => name,
             Api::Enum { name, .. } => name,
             Api::Struct { name, .. } => name,
+            Api::BindgenLayout { name, .. } => name,
             Api::CType { name, .. } => name,
+            Api::Subclass { name, .. } => name,
             Api::IgnoredItem { name, .. } => name,
         }
     }
@@ -261,10 +331,27 @@ impl<T: AnalysisPhase> Api<T> {
         }))
     }
 
+    pub(crate) fn static_unchanged(
+        name: ApiName,
+        static_item: ForeignItemStatic,
+        analysis: T::StaticAnalysis,
+    ) -> Result<Option<Api<T>>, ConvertErrorWithContext> {
+        Ok(Some(Api::Static {
+            name,
+            static_item,
+            analysis,
+        }))
+    }
+
     pub(crate) fn enum_unchanged(
         name: ApiName,
         item: ItemEnum,
+        analysis: T::EnumAnalysis,
     ) -> Result<Option<Api<T>>, ConvertErrorWithContext> {
-        Ok(Some(Api::Enum { name, item }))
+        Ok(Some(Api::Enum {
+            name,
+            item,
+            analysis,
+        }))
     }
 }
@@ -15,29 +15,92 @@
 mod function_wrapper_cpp;
 pub(crate) mod type_to_cpp;
 
-use crate::{types::QualifiedName, CppFilePair};
-use autocxx_parser::IncludeCppConfig;
+use crate::{
+    known_types::known_types,
+    types::{flatten_path, make_ident, QualifiedName},
+    CppFilePair, CXX_GENERATED_HEADER_NAME,
+};
+use autocxx_parser::{CppTrait, Hotness, IncludeCppConfig};
 use itertools::Itertools;
 use std::collections::HashSet;
-use syn::Type;
-use type_to_cpp::{original_name_map_from_apis, type_to_cpp, CppNameMap};
+use syn::{Ident, Type, TypePath};
+use type_to_cpp::{
+    namespaced_name_using_original_name_map, original_name_map_from_apis, type_to_cpp, CppNameMap,
+};
 
 use super::{
-    analysis::fun::{
-        function_wrapper::{FunctionWrapper, FunctionWrapperPayload},
-        FnAnalysis,
+    analysis::{
+        fun::{
+            function_wrapper::{FunctionWrapper, FunctionWrapperPayload},
+            FnAnalysis,
+        },
+        type_converter::smart_ptr_pointee,
     },
-    api::Api,
+    api::{Api, CppLayout, SubclassMethod},
     ConvertError,
 };
 
-/// Instructions for new C++ which we need to generate.
-#[derive(Clone)]
-pub(crate) enum AdditionalNeed {
+/// Instructions for new C++ which we need to generate. These borrow
+/// from the analysis results rather than copying them.
+pub(crate) enum AdditionalNeed<'a> {
     MakeStringConstructor,
-    FunctionWrapper(Box<FunctionWrapper>),
-    CTypeTypedef(QualifiedName),
-    ConcreteTemplatedTypeTypedef(QualifiedName, Box<Type>),
+    FunctionWrapper(&'a FunctionWrapper),
+    CTypeTypedef(&'a QualifiedName),
+    ConcreteTemplatedTypeTypedef(&'a QualifiedName, &'a Type),
+    /// An accessor (with the given name) returning the address of a global.
+    GlobalAccessor(&'a Ident, &'a QualifiedName),
+    /// Functions exposing the operators needed to implement the given
+    /// Rust traits for a type, plus whatever else the flags call for.
+    TraitHelpers(&'a QualifiedName, &'a [CppTrait], TypeHelperFlags),
+    /// A subclass of the given abstract class on behalf of the given
+    /// Rust type, overriding these methods.
+    Subclass(&'a QualifiedName, &'a QualifiedName, &'a [SubclassMethod]),
+}
+
+/// Which C++ helpers a type needs beyond those for its traits.
+#[derive(Clone, Copy, Default)]
+pub(crate) struct TypeHelperFlags {
+    /// The type is relocatable, so Rust's `Drop` calls its destructor.
+    pub(crate) relocatable: bool,
+    /// The relocatable type has its own `IsRelocatable` typedef, so cxx
+    /// needs no telling.
+    pub(crate) declares_relocatable: bool,
+    /// The type is constructed in Rust, so check it's trivially
+    /// default constructible.
+    pub(crate) rust_constructible: bool,
+    /// Check the type's size and alignment are as they were when we
+    /// generated bindings.
+    pub(crate) layout: Option<CppLayout>,
+}
+
+impl TypeHelperFlags {
+    pub(crate) fn any(&self) -> bool {
+        self.relocatable || self.rust_constructible || self.layout.is_some()
+    }
+}
+
+/// The name of a function we generate to expose some C++ operator
+/// for a type, e.g. `eq` for `operator==`. These all live in the
+/// global namespace and in the flat [cxx::bridge] mod, so the name
+/// includes the type's namespace, flattened such that `a::b_c` and
+/// `a_b::c` get different helpers.
+pub(crate) fn trait_helper_name(tyname: &QualifiedName, operation: &str) -> Ident {
+    make_ident(format!(
+        "{}_autocxx_{}",
+        flatten_path(tyname.segment_iter()),
+        operation
+    ))
+}
+
+/// The name of a function or class we generate to support a C++
+/// subclass implemented by the given Rust type. Its name is already
+/// flattened, per [crate::types::flatten_path].
+pub(crate) fn subclass_helper_name(rust_type: &QualifiedName, item: &str) -> Ident {
+    make_ident(format!(
+        "{}_autocxx_subclass_{}",
+        rust_type.get_final_item(),
+        item
+    ))
 }
 
 #[derive(Ord, PartialOrd, Eq, PartialEq, Clone, Hash)]
@@ -70,6 +133,7 @@ impl Header {
 struct AdditionalFunction {
     type_definition: Option<String>, // are output before main declarations
     declaration: Option<String>,
+    implementation: Option<String>, // are output in a separate .cc file
     headers: Vec<Header>,
 }
 
@@ -110,19 +174,31 @@ impl<'a> CppCodeGenerator<'a> {
         }
     }
 
-    fn add_needs(
+    fn add_needs<'b>(
         &mut self,
-        additions: impl Iterator<Item = AdditionalNeed>,
+        additions: impl Iterator<Item = AdditionalNeed<'b>>,
     ) -> Result<(), ConvertError> {
         for need in additions {
             match need {
                 AdditionalNeed::MakeStringConstructor => self.generate_string_constructor(),
                 AdditionalNeed::FunctionWrapper(by_value_wrapper) => {
-                    self.generate_by_value_wrapper(&by_value_wrapper)?
+                    self.generate_by_value_wrapper(by_value_wrapper)?
                 }
-                AdditionalNeed::CTypeTypedef(tn) => self.generate_ctype_typedef(&tn),
+                AdditionalNeed::CTypeTypedef(tn) => self.generate_ctype_typedef(tn),
                 AdditionalNeed::ConcreteTemplatedTypeTypedef(tn, def) => {
-                    self.generate_typedef(&tn, type_to_cpp(&def, &self.original_name_map)?)
+                    self.generate_typedef(tn, type_to_cpp(def, &self.original_name_map)?);
+                    if let Some(pointee) = smart_ptr_pointee(self.config, def) {
+                        self.generate_smart_ptr_helpers(tn, pointee)?;
+                    }
+                }
+                AdditionalNeed::GlobalAccessor(accessor_name, global) => {
+                    self.generate_global_accessor(accessor_name, global)
+                }
+                AdditionalNeed::TraitHelpers(tyname, traits, flags) => {
+                    self.generate_trait_helpers(tyname, traits, flags)
+                }
+                AdditionalNeed::Subclass(rust_type, superclass, methods) => {
+                    self.generate_subclass(rust_type, superclass, methods)?
                 }
             }
         }
@@ -148,9 +224,28 @@ impl<'a> CppCodeGenerator<'a> {
             );
             log::info!("Additional C++ decls:\n{}", declarations);
             let header_name = format!("autocxxgen_{}.h", self.config.get_mod_name());
+            // Implementations live in a .cc file only if they need to see
+            // the declarations generated by cxx, which in turn include our
+            // header.
+            let implementation = if self
+                .additional_functions
+                .iter()
+                .any(|x| x.implementation.is_some())
+            {
+                let implementations = self.concat_additional_items(|x| x.implementation.as_ref());
+                Some(
+                    format!(
+                        "#include \"{}\"\n#include <memory>\n#include <utility>\n\n{}",
+                        CXX_GENERATED_HEADER_NAME, implementations
+                    )
+                    .into_bytes(),
+                )
+            } else {
+                None
+            };
             Some(CppFilePair {
                 header: declarations.into_bytes(),
-                implementation: None,
+                implementation,
                 header_name,
             })
         }
@@ -176,6 +271,7 @@ impl<'a> CppCodeGenerator<'a> {
         self.additional_functions.push(AdditionalFunction {
             type_definition: None,
             declaration,
+            implementation: None,
             headers: vec![
                 Header::system("memory"),
                 Header::system("string"),
@@ -240,7 +336,9 @@ impl<'a> CppCodeGenerator<'a> {
         let receiver = if is_a_method { arg_list.next() } else { None };
         let arg_list = arg_list.join(", ");
         let mut underlying_function_call = match &details.payload {
-            FunctionWrapperPayload::Constructor => arg_list,
+            FunctionWrapperPayload::Constructor | FunctionWrapperPayload::VectorConstructor => {
+                arg_list
+            }
             FunctionWrapperPayload::FunctionCall(ns, id) => match receiver {
                 Some(receiver) => format!("{}.{}({})", receiver, id.to_string(), arg_list),
                 None => {
@@ -267,29 +365,341 @@ impl<'a> CppCodeGenerator<'a> {
                 ret.cpp_conversion(&underlying_function_call, &self.original_name_map)?
             );
         };
+        // Wrappers are normally defined inline in the header, so that the
+        // C++ compiler can see straight through them. For functions which
+        // a profile says are rarely called, we instead define them out of
+        // line, which keeps the header (and thus every translation unit
+        // which includes it) smaller.
+        let (declaration, implementation) = if details.hotness == Hotness::Cold {
+            (
+                Some(format!("{};", declaration)),
+                Some(format!(
+                    "{} {{ {}; }}",
+                    declaration, underlying_function_call
+                )),
+            )
+        } else {
+            (
+                Some(format!(
+                    "inline {} {{ {}; }}",
+                    declaration, underlying_function_call,
+                )),
+                None,
+            )
+        };
+        let mut headers = vec![Header::system("memory")];
+        if matches!(details.payload, FunctionWrapperPayload::VectorConstructor) {
+            headers.push(Header::system("vector"));
+        }
+        self.additional_functions.push(AdditionalFunction {
+            type_definition: None,
+            declaration,
+            implementation,
+            headers,
+        });
+        Ok(())
+    }
+
+    fn generate_global_accessor(&mut self, accessor_name: &Ident, global: &QualifiedName) {
+        // As with function wrappers, this goes in the global namespace.
+        // Using decltype means we don't need to spell out the C++ type,
+        // and preserves its constness.
+        let global = format!("::{}", global.to_cpp_name());
         let declaration = Some(format!(
-            "inline {} {{ {}; }}",
-            declaration, underlying_function_call,
+            "inline decltype(&{}) {}() {{ return &{}; }}",
+            global, accessor_name, global
         ));
         self.additional_functions.push(AdditionalFunction {
             type_definition: None,
             declaration,
-            headers: vec![Header::system("memory")],
+            implementation: None,
+            headers: Vec::new(),
+        })
+    }
+
+    fn generate_trait_helpers(
+        &mut self,
+        tyname: &QualifiedName,
+        traits: &[CppTrait],
+        flags: TypeHelperFlags,
+    ) {
+        let ty = format!(
+            "::{}",
+            namespaced_name_using_original_name_map(tyname, &self.original_name_map)
+        );
+        let mut headers = Vec::new();
+        let mut declarations: Vec<String> = traits
+            .iter()
+            .map(|t| match t {
+                CppTrait::Eq => format!(
+                    "inline bool {}(const {}& a, const {}& b) {{ return a == b; }}",
+                    trait_helper_name(tyname, "eq"),
+                    ty,
+                    ty
+                ),
+                CppTrait::Ord => format!(
+                    "inline bool {}(const {}& a, const {}& b) {{ return a < b; }}",
+                    trait_helper_name(tyname, "lt"),
+                    ty,
+                    ty
+                ),
+                CppTrait::Hash => {
+                    headers.push(Header::system("cstddef"));
+                    headers.push(Header::system("functional"));
+                    format!(
+                        "inline size_t {}(const {}& a) {{ return std::hash<{}>{{}}(a); }}",
+                        trait_helper_name(tyname, "hash"),
+                        ty,
+                        ty
+                    )
+                }
+            })
+            .collect();
+        if flags.relocatable {
+            // cxx insists that types held by value in Rust are trivial,
+            // unless told otherwise, which the type may already do itself.
+            if !flags.declares_relocatable {
+                headers.push(Header::system("type_traits"));
+                headers.push(Header::user("cxx.h"));
+                declarations.push(format!(
+                    "namespace rust {{ template <> struct IsRelocatable<{}> : std::true_type {{}}; }}",
+                    ty
+                ));
+            }
+            declarations.push(format!(
+                "inline void {}({}* obj) {{ using autocxx_type = {}; obj->~autocxx_type(); }}",
+                trait_helper_name(tyname, "destroy"),
+                ty,
+                ty
+            ));
+        }
+        if flags.rust_constructible {
+            // Rust's new() and Default bypass any C++ constructor, and
+            // Default zeroes everything, so make sure there's nothing
+            // to bypass: no user-written default constructor and no
+            // default member initializers.
+            headers.push(Header::system("type_traits"));
+            declarations.push(format!(
+                "static_assert(std::is_trivially_default_constructible<{}>::value, \"rust_constructible! types must not have a user-provided default constructor or default member initializers\");",
+                ty
+            ));
+        }
+        if let Some(layout) = flags.layout {
+            // Rust holds POD types by value, and its own checks compare
+            // them against these numbers too. Opaque types are zero-sized
+            // in Rust, so this is the only check that C++ hasn't changed
+            // under us, e.g. with different compiler flags.
+            declarations.push(format!(
+                "static_assert(sizeof({}) == {} && alignof({}) == {}, \"the layout of {} differs from when bindings were generated\");",
+                ty, layout.size, ty, layout.align, ty
+            ));
+        }
+        self.additional_functions.push(AdditionalFunction {
+            type_definition: None,
+            declaration: Some(declarations.join("\n")),
+            implementation: None,
+            headers,
+        })
+    }
+
+    /// Rust holds smart pointers (per `smart_ptr!`) by value, and reads
+    /// the pointer straight out of them. So we check, as far as C++
+    /// lets us, that the only thing in one is the pointer which `get()`
+    /// returns; Rust checks that it's the same value in debug builds.
+    /// cxx needs telling that it's OK to move them with `memcpy`, and
+    /// Rust's `Clone` and `Drop` call the copy constructor and destructor,
+    /// which adjust any reference count. The pointer comes back to Rust
+    /// as a `size_t`, which is what cxx makes of `usize`.
+    fn generate_smart_ptr_helpers(
+        &mut self,
+        tn: &QualifiedName,
+        pointee: &TypePath,
+    ) -> Result<(), ConvertError> {
+        let ty = tn.get_final_item();
+        let pointee = type_to_cpp(&Type::Path(pointee.clone()), &self.original_name_map)?;
+        let declarations = vec![
+            format!(
+                "static_assert(sizeof({}) == sizeof(void*), \"smart_ptr! types must contain just a pointer\");",
+                ty
+            ),
+            format!(
+                "static_assert(std::is_standard_layout<{}>::value, \"smart_ptr! types must have standard layout\");",
+                ty
+            ),
+            format!(
+                "static_assert(std::is_same<decltype(std::declval<const {}&>().get()), {}*>::value, \"smart_ptr! types must have a get() returning the pointer they hold\");",
+                ty, pointee
+            ),
+            format!(
+                "inline size_t {}(const {}& obj) {{ return static_cast<size_t>(reinterpret_cast<uintptr_t>(obj.get())); }}",
+                trait_helper_name(tn, "get"),
+                ty
+            ),
+            format!(
+                "namespace rust {{ template <> struct IsRelocatable<{}> : std::true_type {{}}; }}",
+                ty
+            ),
+            format!(
+                "inline {} {}(const {}& obj) {{ return obj; }}",
+                ty,
+                trait_helper_name(tn, "clone"),
+                ty
+            ),
+            format!(
+                "inline void {}({}* obj) {{ obj->~{}(); }}",
+                trait_helper_name(tn, "destroy"),
+                ty,
+                ty
+            ),
+        ];
+        self.additional_functions.push(AdditionalFunction {
+            type_definition: None,
+            declaration: Some(declarations.join("\n")),
+            implementation: None,
+            headers: vec![
+                Header::system("cstddef"),
+                Header::system("cstdint"),
+                Header::system("type_traits"),
+                Header::system("utility"),
+                Header::user("cxx.h"),
+            ],
+        });
+        Ok(())
+    }
+
+    fn generate_subclass(
+        &mut self,
+        rust_type: &QualifiedName,
+        superclass: &QualifiedName,
+        methods: &[SubclassMethod],
+    ) -> Result<(), ConvertError> {
+        // The Rust type, and the functions implementing each method,
+        // are declared by cxx in its header, which includes ours. So
+        // we declare only what cxx needs from us, and define the
+        // subclass itself in a .cc file.
+        let rust_type_name = rust_type.get_final_item();
+        let superclass = format!(
+            "::{}",
+            namespaced_name_using_original_name_map(superclass, &self.original_name_map)
+        );
+        let subclass = subclass_helper_name(rust_type, "cpp");
+        let make_unique = subclass_helper_name(rust_type, "make_unique");
+        let make_unique_signature = format!(
+            "std::unique_ptr<{}> {}(rust::Box<{}> obj)",
+            superclass, make_unique, rust_type_name
+        );
+        let overrides: Result<Vec<_>, ConvertError> = methods
+            .iter()
+            .map(|method| {
+                let args: Result<Vec<_>, ConvertError> = method
+                    .params
+                    .iter()
+                    .enumerate()
+                    .map(|(counter, (_, ty))| {
+                        Ok(format!(
+                            "{} arg{}",
+                            ty.unconverted_type(&self.original_name_map)?,
+                            counter
+                        ))
+                    })
+                    .collect();
+                let arg_list: Result<Vec<_>, ConvertError> = method
+                    .params
+                    .iter()
+                    .enumerate()
+                    .map(|(counter, (_, ty))| {
+                        ty.cpp_conversion(&format!("arg{}", counter), &self.original_name_map)
+                    })
+                    .collect();
+                let arg_list = std::iter::once("*obj".to_string())
+                    .chain(arg_list?)
+                    .join(", ");
+                let ret_type = method.ret.as_ref().map_or(Ok("void".to_string()), |x| {
+                    x.converted_type(&self.original_name_map)
+                })?;
+                Ok(format!(
+                    "  {} {}({}){} override {{ {}{}({}); }}",
+                    ret_type,
+                    method.cpp_name,
+                    args?.join(", "),
+                    if method.is_const { " const" } else { "" },
+                    if method.ret.is_some() { "return " } else { "" },
+                    subclass_helper_name(rust_type, &method.name.to_string()),
+                    arg_list
+                ))
+            })
+            .collect();
+        let implementation = format!(
+            "class {} : public {} {{\npublic:\n  {}(rust::Box<{}> obj) : obj(std::move(obj)) {{}}\n{}\nprivate:\n  rust::Box<{}> obj;\n}};\n\n{} {{ return std::make_unique<{}>(std::move(obj)); }}\n",
+            subclass,
+            superclass,
+            subclass,
+            rust_type_name,
+            overrides?.join("\n"),
+            rust_type_name,
+            make_unique_signature,
+            subclass
+        );
+        self.additional_functions.push(AdditionalFunction {
+            type_definition: Some(format!("struct {};", rust_type_name)),
+            declaration: Some(format!("{};", make_unique_signature)),
+            implementation: Some(implementation),
+            headers: vec![Header::system("memory"), Header::user("cxx.h")],
         });
         Ok(())
     }
 
     fn generate_ctype_typedef(&mut self, tn: &QualifiedName) {
         let cpp_name = tn.to_cpp_name();
-        self.generate_typedef(tn, cpp_name)
+        if let Some(primitive) = self.primitive_for_ctype(tn) {
+            // Rust refers to this type as a fixed-width primitive, so
+            // no typedef is needed, but cxx relies on the types being
+            // identical.
+            self.additional_functions.push(AdditionalFunction {
+                type_definition: Some(format!(
+                    "static_assert(std::is_same<{0}, {1}>::value, \"primitive_ctypes!: {0} is not {1} on this target\");",
+                    cpp_name, primitive,
+                )),
+                declaration: None,
+                implementation: None,
+                headers: vec![Header::system("cstdint"), Header::system("type_traits")],
+            });
+            return;
+        }
+        let headers = if known_types().is_simd_vector(tn) {
+            vec![Header::system("immintrin.h")]
+        } else {
+            Vec::new()
+        };
+        self.generate_typedef_with_headers(tn, cpp_name, headers)
+    }
+
+    /// The C++ name of the fixed-width type which stands in for this
+    /// variable-length C type, if `primitive_ctypes!` applies to it.
+    fn primitive_for_ctype(&self, tn: &QualifiedName) -> Option<String> {
+        if !self.config.primitive_ctypes() {
+            return None;
+        }
+        let primitive = known_types().primitive_for_ctype(tn, self.config.target_triple())?;
+        known_types().special_cpp_name(&QualifiedName::from_type_path(&primitive))
     }
 
     fn generate_typedef(&mut self, tn: &QualifiedName, definition: String) {
+        self.generate_typedef_with_headers(tn, definition, Vec::new())
+    }
+
+    fn generate_typedef_with_headers(
+        &mut self,
+        tn: &QualifiedName,
+        definition: String,
+        headers: Vec<Header>,
+    ) {
         let our_name = tn.get_final_item();
         self.additional_functions.push(AdditionalFunction {
             type_definition: Some(format!("typedef {} {};", definition, our_name)),
             declaration: None,
-            headers: Vec::new(),
+            implementation: None,
+            headers,
         })
     }
 }
@@ -16,7 +16,7 @@ use proc_macro2::TokenStream;
 use quote::quote;
 use syn::{
     parse::Parser, parse_quote, punctuated::Punctuated, token::Unsafe, Attribute, FnArg,
-    ForeignItem, Ident, ImplItem, Item, ReturnType,
+    ForeignItem, Ident, ImplItem, Item, ReturnType, Type,
 };
 
 use super::{
@@ -27,11 +27,15 @@ use super::{
 use crate::{conversion::api::FuncToConvert, types::make_ident};
 use crate::{
     conversion::{
-        analysis::fun::{ArgumentAnalysis, FnAnalysisBody, FnKind, MethodKind, RustRenameStrategy},
+        analysis::fun::{
+            function_wrapper::TypeConversionPolicy, ArgumentAnalysis, FnAnalysisBody, FnKind,
+            MethodKind, RustRenameStrategy,
+        },
         api::ImplBlockDetails,
     },
     types::{Namespace, QualifiedName},
 };
+use autocxx_parser::Hotness;
 
 pub(super) fn gen_function(
     ns: &Namespace,
@@ -42,12 +46,14 @@ pub(super) fn gen_function(
     let cxxbridge_name = analysis.cxxbridge_name;
     let rust_name = analysis.rust_name;
     let ret_type = analysis.ret_type;
+    let ret_conversion = analysis.ret_conversion;
     let param_details = analysis.param_details;
     let wrapper_function_needed = analysis.cpp_wrapper.is_some();
     let params = analysis.params;
     let vis = analysis.vis;
     let kind = analysis.kind;
     let doc_attr = get_doc_attr(&fun.item.attrs);
+    let hotness = analysis.hotness;
 
     let mut cpp_name_attr = Vec::new();
     let mut impl_entry = None;
@@ -74,29 +80,49 @@ pub(super) fn gen_function(
     let any_param_needs_rust_conversion = param_details
         .iter()
         .any(|pd| pd.conversion.rust_work_needed());
+    let c_string_ret = ret_conversion.as_ref().filter(|c| c.is_c_string());
     let rust_wrapper_needed = any_param_needs_rust_conversion
+        || c_string_ret.is_some()
         || (cxxbridge_name != rust_name && matches!(kind, FnKind::Method(..)));
+    // cxx insists that anything taking or returning a raw pointer is
+    // unsafe, even where our wrapper presents a safe API using CStr.
+    let passes_c_strings =
+        c_string_ret.is_some() || param_details.iter().any(|pd| pd.conversion.is_c_string());
+    let bridge_unsafety = if passes_c_strings {
+        Some(parse_quote!(unsafe))
+    } else {
+        unsafety
+    };
     if rust_wrapper_needed {
-        if let FnKind::Method(ref type_name, ref method_kind) = kind {
+        let is_constructor = matches!(kind, FnKind::Method(_, MethodKind::Constructor));
+        let wrapper = WrapperSignature::new(
+            &param_details,
+            is_constructor,
+            &ret_type,
+            c_string_ret,
+            unsafety,
+            bridge_unsafety.is_some(),
+        );
+        if let FnKind::Method(ref type_name, _) = kind {
             // Method, or static method.
             impl_entry = Some(generate_method_impl(
                 &param_details,
-                matches!(method_kind, MethodKind::Constructor),
+                is_constructor,
                 type_name,
                 &cxxbridge_name,
                 &rust_name,
-                &ret_type,
-                &unsafety,
+                &wrapper,
                 &doc_attr,
+                hotness,
             ));
         } else {
             // Generate plain old function
             materialization = Use::Custom(generate_function_impl(
                 &param_details,
                 &rust_name,
-                &ret_type,
-                &unsafety,
+                &wrapper,
                 &doc_attr,
+                hotness,
             ));
         }
     }
@@ -135,7 +161,7 @@ pub(super) fn gen_function(
         #(#rust_name_attr)*
         #(#cpp_name_attr)*
         #doc_attr
-        #vis #unsafety fn #cxxbridge_name ( #params ) #ret_type;
+        #vis #bridge_unsafety fn #cxxbridge_name ( #params ) #ret_type;
     ));
     RsCodegenResult {
         extern_c_mod_item: Some(extern_c_mod_item),
@@ -147,16 +173,94 @@ pub(super) fn gen_function(
     }
 }
 
+/// The shape of a Rust wrapper function around a cxx::bridge function.
+struct WrapperSignature<'a> {
+    generics: TokenStream,
+    ret_type: ReturnType,
+    ret_conversion: Option<&'a TypeConversionPolicy>,
+    /// Whether a returned C string borrows from `&self`.
+    ret_borrows_self: bool,
+    unsafety: Option<Unsafe>,
+    call_needs_unsafe_block: bool,
+}
+
+impl<'a> WrapperSignature<'a> {
+    fn new(
+        param_details: &[ArgumentAnalysis],
+        is_constructor: bool,
+        ret_type: &ReturnType,
+        c_string_ret: Option<&'a TypeConversionPolicy>,
+        unsafety: Option<Unsafe>,
+        bridge_is_unsafe: bool,
+    ) -> Self {
+        match c_string_ret {
+            None => WrapperSignature {
+                generics: TokenStream::new(),
+                ret_type: ret_type.clone(),
+                ret_conversion: None,
+                ret_borrows_self: false,
+                call_needs_unsafe_block: bridge_is_unsafe && unsafety.is_none(),
+                unsafety,
+            },
+            Some(conversion) => {
+                // A C string from a const method is tied to the object's
+                // lifetime. That's only enough to make it safe if the user
+                // has also promised, per c_strings!, that it lives that
+                // long and is NUL-terminated: CStr::from_ptr would read
+                // past the end of anything else. Otherwise, it's up to the
+                // caller.
+                let ret_borrows_self = !is_constructor
+                    && param_details.iter().any(|pd| {
+                        pd.self_type.is_some()
+                            && matches!(pd.conversion.unwrapped_type, Type::Reference(_))
+                    });
+                let unsafety = if ret_borrows_self && conversion.is_nul_terminated_c_string() {
+                    unsafety
+                } else {
+                    Some(parse_quote!(unsafe))
+                };
+                let converted_ret_type = conversion.rust_wrapper_return_type();
+                WrapperSignature {
+                    generics: quote! { <'a> },
+                    ret_type: parse_quote! { -> #converted_ret_type },
+                    ret_conversion: Some(conversion),
+                    ret_borrows_self,
+                    call_needs_unsafe_block: unsafety.is_none(),
+                    unsafety,
+                }
+            }
+        }
+    }
+
+    fn body(&self, call: TokenStream) -> TokenStream {
+        let call = match self.ret_conversion {
+            Some(conversion) => conversion.rust_return_conversion(call),
+            None => call,
+        };
+        if self.call_needs_unsafe_block {
+            quote! { unsafe { #call } }
+        } else {
+            call
+        }
+    }
+}
+
 fn generate_arg_lists(
     param_details: &[ArgumentAnalysis],
     is_constructor: bool,
+    wrapper: &WrapperSignature,
 ) -> (Punctuated<FnArg, syn::Token![,]>, Vec<TokenStream>) {
     let mut wrapper_params: Punctuated<FnArg, syn::Token![,]> = Punctuated::new();
     let mut arg_list = Vec::new();
 
     for pd in param_details {
-        let type_name = pd.conversion.rust_wrapper_unconverted_type();
+        let mut type_name = pd.conversion.rust_wrapper_unconverted_type().into_owned();
         let wrapper_arg_name = if pd.self_type.is_some() && !is_constructor {
+            if wrapper.ret_borrows_self {
+                if let Type::Reference(r) = &mut type_name {
+                    r.lifetime = Some(parse_quote! { 'a });
+                }
+            }
             parse_quote!(self)
         } else {
             pd.name.clone()
@@ -169,6 +273,17 @@ fn generate_arg_lists(
     (wrapper_params, arg_list)
 }
 
+/// Hints for the Rust compiler based upon any profile the user gave us:
+/// hot wrappers should be inlined into their callers, whereas cold ones
+/// should be kept out of the way.
+fn hotness_attrs(hotness: Hotness) -> TokenStream {
+    match hotness {
+        Hotness::Hot => quote! { #[inline] },
+        Hotness::Cold => quote! { #[cold] #[inline(never)] },
+        Hotness::Unknown => TokenStream::new(),
+    }
+}
+
 /// Generate an 'impl Type { methods-go-here }' item
 #[allow(clippy::too_many_arguments)] // it's true, but probably best for now
 fn generate_method_impl(
@@ -177,17 +292,28 @@ fn generate_method_impl(
     impl_block_type_name: &QualifiedName,
     cxxbridge_name: &Ident,
     rust_name: &str,
-    ret_type: &ReturnType,
-    unsafety: &Option<Unsafe>,
+    wrapper: &WrapperSignature,
     doc_attr: &Option<Attribute>,
+    hotness: Hotness,
 ) -> Box<ImplBlockDetails> {
-    let (wrapper_params, arg_list) = generate_arg_lists(param_details, is_constructor);
+    let (wrapper_params, arg_list) = generate_arg_lists(param_details, is_constructor, wrapper);
+    let hotness_attrs = hotness_attrs(hotness);
     let rust_name = make_ident(&rust_name);
+    let WrapperSignature {
+        generics,
+        ret_type,
+        unsafety,
+        ..
+    } = wrapper;
+    let body = wrapper.body(quote! {
+        cxxbridge::#cxxbridge_name ( #(#arg_list),* )
+    });
     Box::new(ImplBlockDetails {
         item: ImplItem::Method(parse_quote! {
             #doc_attr
-            pub #unsafety fn #rust_name ( #wrapper_params ) #ret_type {
-                cxxbridge::#cxxbridge_name ( #(#arg_list),* )
+            #hotness_attrs
+            pub #unsafety fn #rust_name #generics ( #wrapper_params ) #ret_type {
+                #body
             }
         }),
         ty: impl_block_type_name.get_final_ident(),
@@ -198,16 +324,27 @@ fn generate_method_impl(
 fn generate_function_impl(
     param_details: &[ArgumentAnalysis],
     rust_name: &str,
-    ret_type: &ReturnType,
-    unsafety: &Option<Unsafe>,
+    wrapper: &WrapperSignature,
     doc_attr: &Option<Attribute>,
+    hotness: Hotness,
 ) -> Box<Item> {
-    let (wrapper_params, arg_list) = generate_arg_lists(param_details, false);
+    let (wrapper_params, arg_list) = generate_arg_lists(param_details, false, wrapper);
+    let hotness_attrs = hotness_attrs(hotness);
     let rust_name = make_ident(&rust_name);
+    let WrapperSignature {
+        generics,
+        ret_type,
+        unsafety,
+        ..
+    } = wrapper;
+    let body = wrapper.body(quote! {
+        cxxbridge::#rust_name ( #(#arg_list),* )
+    });
     Box::new(Item::Fn(parse_quote! {
         #doc_attr
-        pub #unsafety fn #rust_name ( #wrapper_params ) #ret_type {
-            cxxbridge::#rust_name ( #(#arg_list),* )
+        #hotness_attrs
+        pub #unsafety fn #rust_name #generics ( #wrapper_params ) #ret_type {
+            #body
         }
     }))
 }
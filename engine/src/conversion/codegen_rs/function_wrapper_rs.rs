@@ -13,6 +13,7 @@
 // limitations under the License.
 
 use proc_macro2::TokenStream;
+use std::borrow::Cow;
 use syn::{Pat, Type};
 
 use crate::conversion::analysis::fun::function_wrapper::{
@@ -22,17 +23,45 @@ use quote::quote;
 use syn::parse_quote;
 
 impl TypeConversionPolicy {
-    pub(super) fn rust_wrapper_unconverted_type(&self) -> Type {
+    pub(super) fn rust_wrapper_unconverted_type(&self) -> Cow<'_, Type> {
         match self.rust_conversion {
-            RustConversionType::None => self.converted_rust_type(),
-            RustConversionType::FromStr => parse_quote! { impl ToCppString },
+            RustConversionType::None | RustConversionType::ToCStr { .. } => {
+                self.converted_rust_type()
+            }
+            RustConversionType::FromStr => Cow::Owned(parse_quote! { impl ToCppString }),
+            RustConversionType::FromCStr => Cow::Owned(parse_quote! { &::std::ffi::CStr }),
         }
     }
 
     pub(super) fn rust_conversion(&self, var: Pat) -> TokenStream {
         match self.rust_conversion {
-            RustConversionType::None => quote! { #var },
+            RustConversionType::None | RustConversionType::ToCStr { .. } => quote! { #var },
             RustConversionType::FromStr => quote! ( #var .into_cpp() ),
+            RustConversionType::FromCStr => quote! ( #var .as_ptr() ),
+        }
+    }
+
+    /// The type returned by the Rust wrapper function. A C string
+    /// borrows from whatever the caller ties the lifetime `'a` to.
+    pub(super) fn rust_wrapper_return_type(&self) -> Cow<'_, Type> {
+        match self.rust_conversion {
+            RustConversionType::ToCStr { .. } => Cow::Owned(parse_quote! { &'a ::std::ffi::CStr }),
+            _ => self.unconverted_rust_type(),
+        }
+    }
+
+    /// Converts the value returned by cxx into what the Rust wrapper
+    /// function returns. Must be called in an unsafe context.
+    pub(super) fn rust_return_conversion(&self, call: TokenStream) -> TokenStream {
+        match self.rust_conversion {
+            RustConversionType::ToCStr { .. } => quote! {
+                {
+                    let ptr = #call;
+                    assert!(!ptr.is_null());
+                    ::std::ffi::CStr::from_ptr(ptr)
+                }
+            },
+            _ => call,
         }
     }
 }
@@ -18,6 +18,9 @@ mod function_wrapper_rs;
 mod impl_item_creator;
 mod namespace_organizer;
 mod non_pod_struct;
+mod static_codegen;
+mod subclass;
+mod trait_impls;
 mod unqualify;
 
 use std::collections::HashMap;
@@ -28,7 +31,10 @@ use autocxx_parser::IncludeCppConfig;
 pub(crate) use non_pod_struct::make_non_pod;
 
 use proc_macro2::TokenStream;
-use syn::{parse_quote, ForeignItem, Ident, Item, ItemForeignMod, ItemMod};
+use syn::{
+    parse_quote, ForeignItem, Ident, Item, ItemEnum, ItemForeignMod, ItemMod, ItemStruct, Type,
+    TypePath,
+};
 
 use crate::{
     known_types::known_types,
@@ -40,13 +46,17 @@ use self::{
     fun_codegen::gen_function,
     namespace_organizer::{HasNs, NamespaceEntries},
     non_pod_struct::new_non_pod_struct,
+    static_codegen::gen_static,
+    subclass::gen_subclass,
+    trait_impls::gen_trait_impls,
 };
 
+use super::codegen_cpp::trait_helper_name;
 use super::codegen_cpp::type_to_cpp::{
     namespaced_name_using_original_name_map, original_name_map_from_apis, CppNameMap,
 };
 use super::{
-    analysis::fun::FnAnalysis,
+    analysis::{fun::FnAnalysis, pod::EnumKind, type_converter::smart_ptr_pointee},
     api::{AnalysisPhase, Api, ImplBlockDetails, TypeKind, TypedefKind},
 };
 use super::{convert_error::ErrorContext, ConvertError};
@@ -108,6 +118,20 @@ fn get_string_items() -> Vec<Item> {
                 }
             }
         }),
+        // Strings from autocxx::cxx_str! are created once, via our
+        // make_string, and shared thereafter.
+        Item::Trait(parse_quote! {
+            pub trait AsCppStr {
+                fn as_cpp_str(self) -> &'static cxx::CxxString;
+            }
+        }),
+        Item::Impl(parse_quote! {
+            impl AsCppStr for &'static autocxx::CxxStrCache {
+                fn as_cpp_str(self) -> &'static cxx::CxxString {
+                    self.get_or_make(make_string)
+                }
+            }
+        }),
     ]
     .to_vec()
 }
@@ -385,14 +409,21 @@ impl<'a> RsCodeGenerator<'a> {
                     materialization: Use::UsedFromCxxBridgeWithAlias(make_ident("make_string")),
                 }
             }
-            Api::ConcreteType { .. } => RsCodegenResult {
-                global_items: self.generate_extern_type_impl(TypeKind::NonPod, &name),
-                bridge_items: create_impl_items(&id, self.config),
-                extern_c_mod_item: Some(ForeignItem::Verbatim(self.generate_cxxbridge_type(&name))),
-                bindgen_mod_item: Some(Item::Struct(new_non_pod_struct(id.clone()))),
-                impl_entry: None,
-                materialization: Use::Unused,
-            },
+            Api::ConcreteType { rs_definition, .. } => {
+                match smart_ptr_pointee(self.config, &rs_definition) {
+                    Some(pointee) => self.generate_smart_ptr(&name, pointee),
+                    None => RsCodegenResult {
+                        global_items: self.generate_extern_type_impl(TypeKind::NonPod, &name),
+                        bridge_items: create_impl_items(&id, self.config),
+                        extern_c_mod_item: Some(ForeignItem::Verbatim(
+                            self.generate_cxxbridge_type(&name),
+                        )),
+                        bindgen_mod_item: Some(Item::Struct(new_non_pod_struct(id.clone()))),
+                        impl_entry: None,
+                        materialization: Use::Unused,
+                    },
+                }
+            }
             Api::ForwardDeclaration { .. } => RsCodegenResult {
                 extern_c_mod_item: Some(ForeignItem::Verbatim(self.generate_cxxbridge_type(&name))),
                 bridge_items: Vec::new(),
@@ -412,6 +443,11 @@ impl<'a> RsCodeGenerator<'a> {
                 bindgen_mod_item: Some(Item::Const(const_item)),
                 materialization: Use::UsedFromBindgen,
             },
+            Api::Static {
+                static_item,
+                analysis,
+                ..
+            } => gen_static(static_item, analysis),
             Api::Typedef { analysis, .. } => RsCodegenResult {
                 extern_c_mod_item: None,
                 bridge_items: Vec::new(),
@@ -424,21 +460,60 @@ impl<'a> RsCodeGenerator<'a> {
                 materialization: Use::UsedFromBindgen,
             },
             Api::Struct { item, analysis, .. } => {
-                self.generate_type(&name, id, item, analysis.kind, Item::Struct)
-            }
-            Api::Enum { item, .. } => {
-                self.generate_type(&name, id, item, TypeKind::Pod, Item::Enum)
+                let rust_constructors = if analysis.rust_constructible {
+                    Self::generate_rust_constructors(&name, &item)
+                } else {
+                    Vec::new()
+                };
+                let mut results = self.generate_type(&name, id, item, analysis.kind, Item::Struct);
+                results.global_items.extend(rust_constructors);
+                if !analysis.traits.is_empty() || analysis.relocatable {
+                    let (extern_fns, trait_impls) =
+                        gen_trait_impls(&name, &analysis.traits, analysis.relocatable);
+                    let mut extern_c_mod_item = self.generate_cxxbridge_type(&name);
+                    extern_c_mod_item.extend(extern_fns);
+                    results.extern_c_mod_item = Some(ForeignItem::Verbatim(extern_c_mod_item));
+                    results.global_items.extend(trait_impls);
+                }
+                results
             }
-            Api::CType { .. } => RsCodegenResult {
+            Api::Enum {
+                item,
+                analysis: EnumKind::Enum,
+                ..
+            } => self.generate_type(&name, id, item, TypeKind::Pod, Item::Enum),
+            Api::Enum {
+                item,
+                analysis: EnumKind::Newtype(repr),
+                ..
+            } => self.generate_type(&name, id, item, TypeKind::Pod, |item| {
+                Self::generate_newtype_enum(item, repr)
+            }),
+            Api::BindgenLayout { item, .. } => RsCodegenResult {
                 global_items: Vec::new(),
                 impl_entry: None,
                 bridge_items: Vec::new(),
-                extern_c_mod_item: Some(ForeignItem::Verbatim(quote! {
-                    type #id = autocxx::#id;
-                })),
-                bindgen_mod_item: None,
-                materialization: Use::Unused,
+                extern_c_mod_item: None,
+                materialization: match item {
+                    Item::Impl(_) => Use::Unused,
+                    _ => Use::UsedFromBindgen,
+                },
+                bindgen_mod_item: Some(item),
             },
+            Api::CType { typename, .. } if self.config.primitive_ctypes() => {
+                match known_types().primitive_for_ctype(&typename, self.config.target_triple()) {
+                    Some(primitive) => Self::generate_primitive_ctype_check(&typename, primitive),
+                    None => Self::generate_ctype(id, &typename),
+                }
+            }
+            Api::CType { typename, .. } => Self::generate_ctype(id, &typename),
+            Api::Subclass {
+                rust_path,
+                superclass,
+                methods,
+                defines_trait,
+                ..
+            } => gen_subclass(&name, &rust_path, &superclass, &methods, defines_trait),
             Api::IgnoredItem { err, ctx, .. } => Self::generate_error_entry(err, ctx),
         }
     }
@@ -529,6 +604,170 @@ impl<'a> RsCodeGenerator<'a> {
         }
     }
 
+    fn generate_ctype(id: Ident, typename: &QualifiedName) -> RsCodegenResult {
+        RsCodegenResult {
+            global_items: Vec::new(),
+            impl_entry: None,
+            bridge_items: Vec::new(),
+            extern_c_mod_item: Some(ForeignItem::Verbatim(quote! {
+                type #id = autocxx::#id;
+            })),
+            bindgen_mod_item: Self::generate_simd_vector_alias(typename),
+            materialization: Use::Unused,
+        }
+    }
+
+    /// A smart pointer (per `smart_ptr!`) is held by value in Rust, as a
+    /// handle containing the raw pointer. It derefs straight to the pointee
+    /// without calling into C++, except to check in debug builds that the
+    /// pointer is what `get()` returns; cloning and dropping it call the C++
+    /// copy constructor and destructor, which look after any reference count.
+    fn generate_smart_ptr(&self, name: &QualifiedName, pointee: &TypePath) -> RsCodegenResult {
+        let id = name.get_final_ident();
+        let fulltypath = name.get_bindgen_path_idents();
+        let get = trait_helper_name(name, "get");
+        let clone = trait_helper_name(name, "clone");
+        let destroy = trait_helper_name(name, "destroy");
+        let mut extern_c_mod_item = self.generate_cxxbridge_type(name);
+        extern_c_mod_item.extend(quote! {
+            fn #get(obj: &#id) -> usize;
+            fn #clone(obj: &#id) -> #id;
+            unsafe fn #destroy(obj: *mut #id);
+        });
+        let mut global_items = self.generate_extern_type_impl(TypeKind::Pod, name);
+        global_items.extend(vec![
+            parse_quote! {
+                impl #(#fulltypath)::* {
+                    /// The raw pointer held by this smart pointer.
+                    pub fn as_ptr(&self) -> *mut #pointee {
+                        self.ptr
+                    }
+
+                    pub fn is_null(&self) -> bool {
+                        self.ptr.is_null()
+                    }
+                }
+            },
+            parse_quote! {
+                impl std::ops::Deref for #(#fulltypath)::* {
+                    type Target = #pointee;
+                    fn deref(&self) -> &Self::Target {
+                        debug_assert_eq!(
+                            self.ptr as usize,
+                            cxxbridge::#get(self),
+                            "smart pointer doesn't hold the pointer its get() returns"
+                        );
+                        unsafe { self.ptr.as_ref() }.expect("dereferenced a null smart pointer")
+                    }
+                }
+            },
+            parse_quote! {
+                impl Clone for #(#fulltypath)::* {
+                    fn clone(&self) -> Self {
+                        cxxbridge::#clone(self)
+                    }
+                }
+            },
+            parse_quote! {
+                impl Drop for #(#fulltypath)::* {
+                    fn drop(&mut self) {
+                        unsafe { cxxbridge::#destroy(self) }
+                    }
+                }
+            },
+        ]);
+        RsCodegenResult {
+            global_items,
+            bridge_items: create_impl_items(&id, self.config),
+            extern_c_mod_item: Some(ForeignItem::Verbatim(extern_c_mod_item)),
+            bindgen_mod_item: Some(Item::Struct(parse_quote! {
+                #[repr(transparent)]
+                pub struct #id {
+                    pub(crate) ptr: *mut #pointee,
+                }
+            })),
+            impl_entry: None,
+            materialization: Use::Unused,
+        }
+    }
+
+    /// Turns the Rust enum which bindgen gave us into a newtype around
+    /// its underlying integer, with an associated constant for each
+    /// variant. Code using `Enum::Variant` or matching against variants
+    /// needn't change.
+    fn generate_newtype_enum(item: ItemEnum, repr: Type) -> Item {
+        let id = &item.ident;
+        let vis = &item.vis;
+        let attrs = item.attrs.iter().filter(|a| !a.path.is_ident("repr"));
+        let mut next_value = quote! { 0 };
+        let consts: Vec<_> = item
+            .variants
+            .iter()
+            .map(|v| {
+                let value = match &v.discriminant {
+                    Some((_, expr)) => quote! { #expr },
+                    None => next_value.clone(),
+                };
+                next_value = quote! { #value + 1 };
+                let variant_attrs = &v.attrs;
+                let variant_id = &v.ident;
+                quote! {
+                    #(#variant_attrs)*
+                    pub const #variant_id: #id = #id(#value);
+                }
+            })
+            .collect();
+        Item::Verbatim(quote! {
+            #[repr(transparent)]
+            #(#attrs)*
+            #vis struct #id(pub #repr);
+            #[allow(non_upper_case_globals)]
+            impl #id {
+                #(#consts)*
+            }
+        })
+    }
+
+    /// Under `primitive_ctypes!`, APIs use a Rust primitive in place of
+    /// this C type, so there's nothing to declare. Instead, check that
+    /// Rust agrees with us about the size of the C type on this target.
+    /// (The C++ side makes a similar check.)
+    fn generate_primitive_ctype_check(
+        typename: &QualifiedName,
+        primitive: TypePath,
+    ) -> RsCodegenResult {
+        let c_type = make_ident(typename.get_final_item());
+        let primitive_id = &primitive.path.segments.last().unwrap().ident;
+        let check_fn = make_ident(format!("{}_is_{}", c_type, primitive_id));
+        RsCodegenResult {
+            global_items: vec![Item::Fn(parse_quote! {
+                #[allow(dead_code)]
+                fn #check_fn(x: ::std::os::raw::#c_type) -> #primitive {
+                    x
+                }
+            })],
+            impl_entry: None,
+            bridge_items: Vec::new(),
+            extern_c_mod_item: None,
+            bindgen_mod_item: None,
+            materialization: Use::Unused,
+        }
+    }
+
+    /// bindgen refers to SIMD vector types (which we asked it not to
+    /// generate) by their C++ names, e.g. in the fields of POD structs.
+    /// Make those names refer to the `core::arch` types.
+    fn generate_simd_vector_alias(typename: &QualifiedName) -> Option<Item> {
+        if known_types().is_simd_vector(typename) {
+            let cpp_name = make_ident(typename.to_cpp_name());
+            Some(Item::Type(parse_quote! {
+                pub type #cpp_name = core::arch::x86_64::#cpp_name;
+            }))
+        } else {
+            None
+        }
+    }
+
     /// Because errors may be generated for invalid types or identifiers,
     /// we may need to scrub the name
     fn sanitize_error_ident(id: &Ident) -> Option<Ident> {
@@ -578,6 +817,39 @@ impl<'a> RsCodeGenerator<'a> {
         })]
     }
 
+    /// Generates a field-wise `new` and a `Default` implementation for a
+    /// simple POD type, so that it can be constructed on the Rust stack
+    /// without calling into C++.
+    fn generate_rust_constructors(tyname: &QualifiedName, item: &ItemStruct) -> Vec<Item> {
+        let fulltypath = tyname.get_bindgen_path_idents();
+        let (field_names, field_types): (Vec<_>, Vec<_>) = item
+            .fields
+            .iter()
+            .map(|f| (f.ident.as_ref().unwrap(), &f.ty))
+            .unzip();
+        vec![
+            Item::Impl(parse_quote! {
+                impl #(#fulltypath)::* {
+                    /// Creates a new instance from the values of each field.
+                    pub fn new(#(#field_names: #field_types),*) -> Self {
+                        Self {
+                            #(#field_names),*
+                        }
+                    }
+                }
+            }),
+            Item::Impl(parse_quote! {
+                impl Default for #(#fulltypath)::* {
+                    /// Creates a zero-initialized instance, just like
+                    /// C++ value-initialization.
+                    fn default() -> Self {
+                        unsafe { std::mem::zeroed() }
+                    }
+                }
+            }),
+        ]
+    }
+
     fn generate_cxxbridge_type(&self, name: &QualifiedName) -> TokenStream {
         let ns = name.get_namespace();
         let id = name.get_final_ident();
@@ -13,11 +13,11 @@
 // limitations under the License.
 
 use super::doc_attr::get_doc_attr;
-use crate::types::make_ident;
-use proc_macro2::Ident;
+use crate::{conversion::analysis::get_repr_align, types::make_ident};
+use proc_macro2::{Ident, Span};
 use quote::quote;
 use syn::parse::Parser;
-use syn::{parse_quote, Field, GenericParam, ItemStruct};
+use syn::{parse_quote, Field, GenericParam, ItemStruct, LitInt, Type};
 
 pub(crate) fn new_non_pod_struct(id: Ident) -> ItemStruct {
     let mut s = parse_quote! {
@@ -38,11 +38,24 @@ pub(crate) fn make_non_pod(s: &mut ItemStruct) {
     // by Rust code
     // (see https://doc.rust-lang.org/1.47.0/reference/behavior-considered-undefined.html).
     // Rustc can use least-significant bits of the reference for other storage.
+    // The exception is where bindgen has told us the type is over-aligned
+    // (e.g. alignas(64)), in which case we know its real alignment and
+    // keep it, so that anything in Rust which holds one is aligned too.
+    let align = get_repr_align(&s.attrs);
+    let repr = match align {
+        Some(align) => {
+            let align = LitInt::new(&align.to_string(), Span::call_site());
+            parse_quote!(
+                #[repr(C, align(#align))]
+            )
+        }
+        None => parse_quote!(
+            #[repr(C, packed)]
+        ),
+    };
     let attrs = get_doc_attr(&s.attrs)
         .into_iter()
-        .chain(std::iter::once(parse_quote!(
-            #[repr(C, packed)]
-        )));
+        .chain(std::iter::once(repr));
     s.attrs = attrs.collect();
     // Now fill in fields. Usually, we just want a single field
     // but if this is a generic type we need to faff a bit.
@@ -64,10 +77,16 @@ pub(crate) fn make_non_pod(s: &mut ItemStruct) {
             _ => None,
         });
     // See cxx's opaque::Opaque for rationale for this type... in
-    // short, it's to avoid being Send/Sync.
+    // short, it's to avoid being Send/Sync. If we're not packed, it
+    // mustn't contribute any alignment of its own.
+    let unallocatable_type: Type = if align.is_some() {
+        parse_quote! { ::std::marker::PhantomData<[*const u8; 0]> }
+    } else {
+        parse_quote! { [*const u8; 0] }
+    };
     s.fields = syn::Fields::Named(parse_quote! {
         {
-            do_not_attempt_to_allocate_nonpod_types: [*const u8; 0],
+            do_not_attempt_to_allocate_nonpod_types: #unallocatable_type,
             _pinned: core::marker::PhantomData<core::marker::PhantomPinned>,
             #(#generic_type_fields),*
         }
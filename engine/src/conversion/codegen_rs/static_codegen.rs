@@ -0,0 +1,83 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use quote::quote;
+use syn::{parse_quote, ForeignItem, ForeignItemStatic, Item, ReturnType};
+
+use super::{doc_attr::get_doc_attr, unqualify::unqualify_ret_type, RsCodegenResult, Use};
+use crate::conversion::analysis::fun::StaticAnalysisBody;
+
+/// Generates an accessor for a global variable. The C++ accessor
+/// is called the first time this is used, and the address is then
+/// cached such that subsequent accesses are simply memory loads.
+pub(super) fn gen_static(
+    static_item: ForeignItemStatic,
+    analysis: StaticAnalysisBody,
+) -> RsCodegenResult {
+    let id = static_item.ident;
+    // This is the type as bindgen knows it, and we're going to
+    // place this accessor within the bindgen mod.
+    let ty = static_item.ty;
+    let doc_attr = get_doc_attr(&static_item.attrs);
+    let cxxbridge_name = analysis.cxxbridge_name;
+    let cxxbridge_type = analysis.cxxbridge_type;
+    let ret_type: ReturnType = parse_quote! { -> #cxxbridge_type };
+    let ret_type = unqualify_ret_type(ret_type);
+    let cache_address = quote! {
+        static ADDRESS: ::std::sync::atomic::AtomicPtr<#ty> =
+            ::std::sync::atomic::AtomicPtr::new(::std::ptr::null_mut());
+        let mut address = ADDRESS.load(::std::sync::atomic::Ordering::Relaxed);
+    };
+    let accessor: Item = if analysis.mutable {
+        parse_quote! {
+            #doc_attr
+            ///
+            /// # Safety
+            ///
+            /// This global may be modified from C++ at any time, and
+            /// callers must ensure no other references to it exist while
+            /// this one is alive.
+            pub unsafe fn #id() -> ::std::pin::Pin<&'static mut #ty> {
+                #cache_address
+                if address.is_null() {
+                    address = cxxbridge::#cxxbridge_name() as *mut #ty;
+                    ADDRESS.store(address, ::std::sync::atomic::Ordering::Relaxed);
+                }
+                ::std::pin::Pin::new_unchecked(&mut *address)
+            }
+        }
+    } else {
+        parse_quote! {
+            #doc_attr
+            pub fn #id() -> &'static #ty {
+                #cache_address
+                if address.is_null() {
+                    address = unsafe { cxxbridge::#cxxbridge_name() } as *mut #ty;
+                    ADDRESS.store(address, ::std::sync::atomic::Ordering::Relaxed);
+                }
+                unsafe { &*address }
+            }
+        }
+    };
+    RsCodegenResult {
+        extern_c_mod_item: Some(ForeignItem::Fn(parse_quote!(
+            unsafe fn #cxxbridge_name() #ret_type;
+        ))),
+        bridge_items: Vec::new(),
+        global_items: Vec::new(),
+        bindgen_mod_item: Some(accessor),
+        impl_entry: None,
+        materialization: Use::UsedFromBindgen,
+    }
+}
@@ -0,0 +1,123 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use proc_macro2::TokenStream;
+use quote::quote;
+use syn::{parse_quote, ForeignItem, Ident, Item, Path};
+
+use super::{unqualify::unqualify_type, RsCodegenResult, Use};
+use crate::{
+    conversion::{api::SubclassMethod, codegen_cpp::subclass_helper_name},
+    types::{make_ident, QualifiedName},
+};
+
+/// The trait which Rust types implement to provide the pure virtual
+/// methods of the given C++ class.
+fn subclass_trait_name(superclass: &QualifiedName) -> Ident {
+    make_ident(format!("{}Methods", superclass.get_final_item()))
+}
+
+/// Generates the Rust side of a C++ subclass implemented by a Rust type.
+/// Each overridden method in C++ calls a function declared in an
+/// `extern "Rust"` section of the [cxx::bridge], and that function calls
+/// the Rust type's implementation of the method directly. There's no
+/// dynamic dispatch on the Rust side, nor any allocation per call.
+pub(super) fn gen_subclass(
+    rust_type: &QualifiedName,
+    rust_path: &Path,
+    superclass: &QualifiedName,
+    methods: &[SubclassMethod],
+    defines_trait: bool,
+) -> RsCodegenResult {
+    let id = rust_type.get_final_ident();
+    let superclass_id = superclass.get_final_ident();
+    let superclass_path = superclass.get_bindgen_path_idents();
+    let trait_id = subclass_trait_name(superclass);
+    let make_unique = subclass_helper_name(rust_type, "make_unique");
+    let mut trait_items = Vec::new();
+    let mut extern_rust_fns = TokenStream::new();
+    let mut global_items = vec![Item::Use(parse_quote! {
+        use #rust_path as #id;
+    })];
+    for method in methods {
+        let method_id = &method.name;
+        let helper = subclass_helper_name(rust_type, &method_id.to_string());
+        let (receiver, this_type) = if method.is_const {
+            (quote! { &self }, quote! { &#id })
+        } else {
+            (quote! { &mut self }, quote! { &mut #id })
+        };
+        let (names, types): (Vec<_>, Vec<_>) = method
+            .params
+            .iter()
+            .map(|(name, ty)| (name, &ty.unwrapped_type))
+            .unzip();
+        let bridge_types = types.iter().map(|ty| unqualify_type((*ty).clone()));
+        let (ret, bridge_ret) = match &method.ret {
+            Some(ret) => {
+                let ty = &ret.unwrapped_type;
+                let bridge_ty = unqualify_type(ty.clone());
+                (quote! { -> #ty }, quote! { -> #bridge_ty })
+            }
+            None => (TokenStream::new(), TokenStream::new()),
+        };
+        trait_items.push(quote! {
+            fn #method_id(#receiver, #(#names: #types),*) #ret;
+        });
+        extern_rust_fns.extend(quote! {
+            fn #helper(autocxx_self: #this_type, #(#names: #bridge_types),*) #bridge_ret;
+        });
+        global_items.push(Item::Fn(parse_quote! {
+            #[allow(non_snake_case)]
+            fn #helper(autocxx_self: #this_type, #(#names: #types),*) #ret {
+                <#id as #trait_id>::#method_id(autocxx_self, #(#names),*)
+            }
+        }));
+    }
+    if defines_trait {
+        global_items.push(Item::Trait(parse_quote! {
+            /// The pure virtual methods of a C++ abstract class, to be
+            /// implemented by any Rust type named in a `subclass!` directive
+            /// for that class.
+            pub trait #trait_id {
+                #(#trait_items)*
+            }
+        }));
+    }
+    global_items.push(Item::Impl(parse_quote! {
+        impl #id {
+            /// Moves this object into a new instance of a C++ subclass,
+            /// whose pure virtual methods call this type's implementations
+            /// of them.
+            pub fn into_cpp(self) -> cxx::UniquePtr<#(#superclass_path)::*> {
+                cxxbridge::#make_unique(Box::new(self))
+            }
+        }
+    }));
+    RsCodegenResult {
+        extern_c_mod_item: Some(ForeignItem::Verbatim(quote! {
+            fn #make_unique(obj: Box<#id>) -> UniquePtr<#superclass_id>;
+        })),
+        bridge_items: vec![Item::ForeignMod(parse_quote! {
+            extern "Rust" {
+                type #id;
+                #extern_rust_fns
+            }
+        })],
+        global_items,
+        bindgen_mod_item: None,
+        impl_entry: None,
+        materialization: Use::Unused,
+    }
+}
@@ -0,0 +1,112 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use autocxx_parser::CppTrait;
+use proc_macro2::TokenStream;
+use quote::quote;
+use syn::{parse_quote, Item};
+
+use crate::{conversion::codegen_cpp::trait_helper_name, types::QualifiedName};
+
+/// Generates implementations of Rust traits for a C++ type, each calling
+/// through to a C++ helper function which uses the relevant operator.
+/// Relocatable types also get a `Drop` implementation which calls the
+/// C++ destructor in place.
+/// Returns the declarations of those helpers for the [cxx::bridge] and
+/// the trait implementations themselves.
+pub(super) fn gen_trait_impls(
+    tyname: &QualifiedName,
+    traits: &[CppTrait],
+    relocatable: bool,
+) -> (TokenStream, Vec<Item>) {
+    let id = tyname.get_final_ident();
+    let fulltypath = tyname.get_bindgen_path_idents();
+    let mut extern_fns = TokenStream::new();
+    let mut impls = Vec::new();
+    for t in traits {
+        match t {
+            CppTrait::Eq => {
+                let eq = trait_helper_name(tyname, "eq");
+                extern_fns.extend(quote! {
+                    fn #eq(a: &#id, b: &#id) -> bool;
+                });
+                impls.push(parse_quote! {
+                    impl PartialEq for #(#fulltypath)::* {
+                        fn eq(&self, other: &Self) -> bool {
+                            cxxbridge::#eq(self, other)
+                        }
+                    }
+                });
+                impls.push(parse_quote! {
+                    impl Eq for #(#fulltypath)::* {}
+                });
+            }
+            CppTrait::Ord => {
+                let lt = trait_helper_name(tyname, "lt");
+                extern_fns.extend(quote! {
+                    fn #lt(a: &#id, b: &#id) -> bool;
+                });
+                impls.push(parse_quote! {
+                    impl PartialOrd for #(#fulltypath)::* {
+                        fn partial_cmp(&self, other: &Self) -> Option<std::cmp::Ordering> {
+                            Some(self.cmp(other))
+                        }
+                    }
+                });
+                impls.push(parse_quote! {
+                    impl Ord for #(#fulltypath)::* {
+                        fn cmp(&self, other: &Self) -> std::cmp::Ordering {
+                            if cxxbridge::#lt(self, other) {
+                                std::cmp::Ordering::Less
+                            } else if cxxbridge::#lt(other, self) {
+                                std::cmp::Ordering::Greater
+                            } else {
+                                std::cmp::Ordering::Equal
+                            }
+                        }
+                    }
+                });
+            }
+            CppTrait::Hash => {
+                let hash = trait_helper_name(tyname, "hash");
+                extern_fns.extend(quote! {
+                    fn #hash(a: &#id) -> usize;
+                });
+                impls.push(parse_quote! {
+                    impl std::hash::Hash for #(#fulltypath)::* {
+                        fn hash<H: std::hash::Hasher>(&self, state: &mut H) {
+                            state.write_usize(cxxbridge::#hash(self))
+                        }
+                    }
+                });
+            }
+        }
+    }
+    if relocatable {
+        let destroy = trait_helper_name(tyname, "destroy");
+        extern_fns.extend(quote! {
+            unsafe fn #destroy(obj: *mut #id);
+        });
+        impls.push(parse_quote! {
+            impl Drop for #(#fulltypath)::* {
+                fn drop(&mut self) {
+                    // Any fields which need dropping are ManuallyDrop, so
+                    // this is the only thing which destroys them.
+                    unsafe { cxxbridge::#destroy(self) }
+                }
+            }
+        });
+    }
+    (extern_fns, impls)
+}
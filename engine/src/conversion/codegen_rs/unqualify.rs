@@ -56,7 +56,7 @@ where
     new_pun
 }
 
-fn unqualify_type(typ: Type) -> Type {
+pub(crate) fn unqualify_type(typ: Type) -> Type {
     match typ {
         Type::Path(typ) => Type::Path(unqualify_type_path(typ)),
         Type::Reference(mut typeref) => {
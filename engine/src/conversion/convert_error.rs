@@ -34,12 +34,12 @@ pub enum ConvertError {
     NotOneInputReference(String),
     UnsupportedType(String),
     UnknownType(String),
-    StaticData(String),
     InfinitelyRecursiveTypedef(QualifiedName),
     UnexpectedUseStatement(Option<Ident>),
     TemplatedTypeContainingNonPathArg(QualifiedName),
     InvalidPointee,
     DidNotGenerateAnything(String),
+    NoTypeForTraits(String),
     TypeContainingForwardDeclaration(QualifiedName),
     Blocked(QualifiedName),
     UnusedTemplateParam,
@@ -50,6 +50,10 @@ pub enum ConvertError {
     ReservedName,
     DuplicateCxxBridgeName,
     UnsupportedReceiver,
+    InvalidSubclassBase(String),
+    UnsupportedSubclassMethod(String),
+    UnrecognizedLinkName(String),
+    NotRustConstructible(String, String),
 }
 
 fn format_maybe_identifier(id: &Option<Ident>) -> String {
@@ -76,12 +80,12 @@ impl Display for ConvertError {
             ConvertError::NotOneInputReference(fn_name) => write!(f, "Function {} has a return reference parameter, but 0 or >1 input reference parameters, so the lifetime of the output reference cannot be deduced.", fn_name)?,
             ConvertError::UnsupportedType(ty_desc) => write!(f, "Encountered type not yet supported by autocxx: {}", ty_desc)?,
             ConvertError::UnknownType(ty_desc) => write!(f, "Encountered type not yet known by autocxx: {}", ty_desc)?,
-            ConvertError::StaticData(ty_desc) => write!(f, "Encountered mutable static data, not yet supported: {}", ty_desc)?,
             ConvertError::InfinitelyRecursiveTypedef(tn) => write!(f, "Encountered typedef to itself - this is a known bindgen bug: {}", tn.to_cpp_name())?,
             ConvertError::UnexpectedUseStatement(maybe_ident) => write!(f, "Unexpected 'use' statement encountered: {}", format_maybe_identifier(maybe_ident))?,
             ConvertError::TemplatedTypeContainingNonPathArg(tn) => write!(f, "Type {} was parameterized over something complex which we don't yet support", tn)?,
             ConvertError::InvalidPointee => write!(f, "Pointer pointed to something unsupported")?,
             ConvertError::DidNotGenerateAnything(directive) => write!(f, "The 'generate' or 'generate_pod' directive for '{}' did not result in any code being generated. Perhaps this was mis-spelled or you didn't qualify the name with any namespaces? Otherwise please report a bug.", directive)?,
+            ConvertError::NoTypeForTraits(directive) => write!(f, "The 'impl_traits' directive for '{}' did not match any struct or class. Perhaps this was mis-spelled or you didn't qualify the name with any namespaces?", directive)?,
             ConvertError::TypeContainingForwardDeclaration(tn) => write!(f, "Found an attempt at using a forward declaration ({}) inside a templated cxx type such as UniquePtr or CxxVector", tn.to_cpp_name())?,
             ConvertError::Blocked(tn) => write!(f, "Found an attempt at using a type marked as blocked! ({})", tn.to_cpp_name())?,
             ConvertError::UnusedTemplateParam => write!(f, "This function or method uses a type where one of the template parameters was incomprehensible to bindgen/autocxx - probably because it uses template specialization.")?,
@@ -92,6 +96,10 @@ impl Display for ConvertError {
             ConvertError::ReservedName => write!(f, "The item name is a reserved word in Rust.")?,
             ConvertError::DuplicateCxxBridgeName => write!(f, "This item name is used in multiple namespaces. At present, autocxx and cxx allow only one type of a given name. This limitation will be fixed in future.")?,
             ConvertError::UnsupportedReceiver => write!(f, "This is a method on a type which can't be used as the receiver in Rust (i.e. self/this). This is probably because some type involves template specialization.")?,
+            ConvertError::InvalidSubclassBase(superclass) => write!(f, "The 'subclass' directive names {}, which isn't a C++ class with pure virtual methods for which autocxx could generate bindings. Pure virtual methods inherited from its base classes can't yet be overridden.", superclass)?,
+            ConvertError::UnsupportedSubclassMethod(method) => write!(f, "The pure virtual method {} can't yet be implemented in Rust. Its parameters and return type must be usable from Rust without any conversion, and it mustn't take pointers or return a reference.", method)?,
+            ConvertError::NotRustConstructible(ty, reason) => write!(f, "The 'rust_constructible' directive names {}, which can't be constructed in Rust because {}.", ty, reason)?,
+            ConvertError::UnrecognizedLinkName(link_name) => write!(f, "autocxx couldn't work out the C++ name of this variable from its symbol name {}. It may be a static member of a templated class, which isn't yet supported.", link_name)?,
         }
         Ok(())
     }
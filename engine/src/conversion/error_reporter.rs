@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-use syn::{ItemEnum, ItemStruct};
+use syn::{ForeignItemStatic, ItemEnum, ItemStruct};
 
 use super::{
     api::{AnalysisPhase, Api, ApiName, FuncToConvert, TypedefKind},
@@ -49,13 +49,14 @@ where
 /// Run some code which generates an API. Add that API, or if
 /// anything goes wrong, instead add a note of the problem in our
 /// output API such that users will see documentation for the problem.
-pub(crate) fn convert_apis<FF, SF, EF, TF, A, B>(
+pub(crate) fn convert_apis<FF, SF, EF, TF, VF, A, B>(
     in_apis: Vec<Api<A>>,
     out_apis: &mut Vec<Api<B>>,
     mut func_conversion: FF,
     mut struct_conversion: SF,
     mut enum_conversion: EF,
     mut typedef_conversion: TF,
+    mut static_conversion: VF,
 ) where
     A: AnalysisPhase,
     B: AnalysisPhase,
@@ -69,13 +70,22 @@ pub(crate) fn convert_apis<FF, SF, EF, TF, A, B>(
         ItemStruct,
         A::StructAnalysis,
     ) -> Result<Option<Api<B>>, ConvertErrorWithContext>,
-    EF: FnMut(ApiName, ItemEnum) -> Result<Option<Api<B>>, ConvertErrorWithContext>,
+    EF: FnMut(
+        ApiName,
+        ItemEnum,
+        A::EnumAnalysis,
+    ) -> Result<Option<Api<B>>, ConvertErrorWithContext>,
     TF: FnMut(
         ApiName,
         TypedefKind,
         Option<QualifiedName>,
         A::TypedefAnalysis,
     ) -> Result<Option<Api<B>>, ConvertErrorWithContext>,
+    VF: FnMut(
+        ApiName,
+        ForeignItemStatic,
+        A::StaticAnalysis,
+    ) -> Result<Option<Api<B>>, ConvertErrorWithContext>,
 {
     out_apis.extend(in_apis.into_iter().filter_map(|api| {
         let tn = api.name().clone();
@@ -93,10 +103,32 @@ pub(crate) fn convert_apis<FF, SF, EF, TF, A, B>(
             Api::ForwardDeclaration { name } => Ok(Some(Api::ForwardDeclaration { name })),
             Api::StringConstructor { name } => Ok(Some(Api::StringConstructor { name })),
             Api::Const { name, const_item } => Ok(Some(Api::Const { name, const_item })),
+            Api::BindgenLayout { name, item, deps } => {
+                Ok(Some(Api::BindgenLayout { name, item, deps }))
+            }
             Api::CType { name, typename } => Ok(Some(Api::CType { name, typename })),
+            Api::Subclass {
+                name,
+                rust_path,
+                superclass,
+                methods,
+                defines_trait,
+                deps,
+            } => Ok(Some(Api::Subclass {
+                name,
+                rust_path,
+                superclass,
+                methods,
+                defines_trait,
+                deps,
+            })),
             Api::IgnoredItem { name, err, ctx } => Ok(Some(Api::IgnoredItem { name, err, ctx })),
             // Apply a mapping to the following
-            Api::Enum { name, item } => enum_conversion(name, item),
+            Api::Enum {
+                name,
+                item,
+                analysis,
+            } => enum_conversion(name, item, analysis),
             Api::Typedef {
                 name,
                 item,
@@ -113,6 +145,11 @@ pub(crate) fn convert_apis<FF, SF, EF, TF, A, B>(
                 item,
                 analysis,
             } => struct_conversion(name, item, analysis),
+            Api::Static {
+                name,
+                static_item,
+                analysis,
+            } => static_conversion(name, static_item, analysis),
         };
         api_or_error(tn, result)
     }))
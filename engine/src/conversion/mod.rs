@@ -36,7 +36,9 @@ use self::{
     analysis::{
         abstract_types::mark_types_abstract, check_names,
         gc::filter_apis_by_following_edges_from_allowlist, pod::analyze_pod_apis,
-        remove_ignored::filter_apis_by_ignored_dependents, tdef::convert_typedef_targets,
+        remove_ignored::filter_apis_by_ignored_dependents,
+        rust_constructors::mark_types_rust_constructible, subclass::add_subclass_apis,
+        tdef::convert_typedef_targets,
     },
     api::{AnalysisPhase, Api},
     codegen_rs::RsCodeGenerator,
@@ -130,6 +132,13 @@ impl<'a> BridgeConverter<'a> {
                 // to generate UniquePtr implementations for the type, since it can't
                 // be instantiated.
                 mark_types_abstract(&self.config, &mut analyzed_apis);
+                // Simple POD types which the user says have trivial C++
+                // constructors can instead be constructed on the Rust
+                // side, without any FFI.
+                mark_types_rust_constructible(&self.config, &mut analyzed_apis)?;
+                // Describe any C++ subclasses we need to generate for Rust
+                // types implementing the pure virtual methods of abstract types.
+                add_subclass_apis(&self.config, &mut analyzed_apis);
                 Self::dump_apis("main analyses", &analyzed_apis);
                 // Remove any APIs whose names are not compatible with cxx.
                 let analyzed_apis = check_names(analyzed_apis);
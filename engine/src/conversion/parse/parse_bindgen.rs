@@ -16,7 +16,7 @@ use std::collections::HashSet;
 
 use crate::{
     conversion::{
-        api::{ApiName, TypedefKind, UnanalyzedApi},
+        api::{ApiName, CppLayout, TypedefKind, UnanalyzedApi},
         ConvertError,
     },
     types::Namespace,
@@ -27,10 +27,16 @@ use crate::{
         convert_error::{ConvertErrorWithContext, ErrorContext},
         error_reporter::report_any_error,
     },
-    types::validate_ident_ok_for_cxx,
+    types::{is_bindgen_layout_type, make_ident, validate_ident_ok_for_cxx},
 };
 use autocxx_parser::IncludeCppConfig;
-use syn::{parse_quote, Attribute, Fields, Ident, Item, LitStr, TypePath, UseTree};
+use proc_macro2::TokenStream;
+use quote::quote;
+use syn::{
+    parse_quote, punctuated::Punctuated, visit::Visit, Attribute, Expr, ExprCall, ExprField,
+    ExprLit, ExprMacro, ExprMethodCall, Field, Fields, Ident, ImplItem, Item, ItemFn, ItemImpl,
+    ItemMacro, Lit, LitStr, Member, Stmt, Token, Type, TypePath, UseTree,
+};
 
 use super::super::utilities::generate_utilities;
 
@@ -160,6 +166,11 @@ impl<'a> ParseBindgen<'a> {
                 if s.ident.to_string().ends_with("__bindgen_vtable") {
                     return Ok(());
                 }
+                if is_bindgen_layout_type(&s.ident.to_string()) {
+                    let deps = Self::get_field_deps(s.fields.iter());
+                    self.add_layout_item(ns, s.ident.clone(), Item::Struct(s), deps);
+                    return Ok(());
+                }
                 let is_forward_declaration = Self::spot_forward_declaration(&s.fields);
                 // cxx::bridge can't cope with type aliases to generic
                 // types at the moment.
@@ -170,7 +181,7 @@ impl<'a> ParseBindgen<'a> {
                     UnanalyzedApi::Struct {
                         name,
                         item: s,
-                        analysis: (),
+                        analysis: None,
                     }
                 };
                 self.latest_virtual_this_type = Some(api.name().clone());
@@ -183,12 +194,18 @@ impl<'a> ParseBindgen<'a> {
                 let api = UnanalyzedApi::Enum {
                     name: api_name_qualified(ns, e.ident.clone(), &e.attrs)?,
                     item: e,
+                    analysis: (),
                 };
                 if !self.config.is_on_blocklist(&api.name().to_cpp_name()) {
                     self.apis.push(api);
                 }
                 Ok(())
             }
+            Item::Union(u) if is_bindgen_layout_type(&u.ident.to_string()) => {
+                let deps = Self::get_field_deps(u.fields.named.iter());
+                self.add_layout_item(ns, u.ident.clone(), Item::Union(u), deps);
+                Ok(())
+            }
             Item::Impl(imp) => {
                 // We *mostly* ignore all impl blocks generated by bindgen.
                 // Methods also appear in 'extern "C"' blocks which
@@ -197,7 +214,11 @@ impl<'a> ParseBindgen<'a> {
                 // We do however record which methods were spotted, since
                 // we have no other way of working out which functions are
                 // static methods vs plain functions.
-                mod_converter.convert_impl_items(imp);
+                // The exception is bitfield accessors, which are pure Rust
+                // and which we pass straight through.
+                if let Some(imp) = self.split_out_bitfield_accessors(imp, ns) {
+                    mod_converter.convert_impl_items(imp);
+                }
                 Ok(())
             }
             Item::Mod(itm) => {
@@ -278,6 +299,28 @@ impl<'a> ParseBindgen<'a> {
                 });
                 Ok(())
             }
+            Item::Fn(f) => {
+                // The only functions bindgen generates are layout tests.
+                // Those for template instantiations start with a double
+                // underscore, and we skip them.
+                let fn_name = f.sig.ident.to_string();
+                if let Some(tyname) = fn_name.strip_prefix("bindgen_test_layout_") {
+                    let ty_id = make_ident(tyname);
+                    let tn = QualifiedName::new(ns, ty_id.clone());
+                    if self.config.is_on_blocklist(&tn.to_cpp_name()) {
+                        return Ok(());
+                    }
+                    if let Some(layout) = Self::layout_test_to_cpp_layout(&f) {
+                        self.record_layout(&tn, layout);
+                    }
+                    if let Some(checks) = Self::layout_test_to_static_checks(&f) {
+                        let mut deps = HashSet::new();
+                        deps.insert(tn);
+                        self.add_layout_item(ns, ty_id, checks, deps);
+                    }
+                }
+                Ok(())
+            }
             _ => Err(ConvertErrorWithContext(
                 ConvertError::UnexpectedItemInMod,
                 None,
@@ -285,6 +328,206 @@ impl<'a> ParseBindgen<'a> {
         }
     }
 
+    fn add_layout_item(
+        &mut self,
+        ns: &Namespace,
+        id: Ident,
+        item: Item,
+        deps: HashSet<QualifiedName>,
+    ) {
+        self.apis.push(UnanalyzedApi::BindgenLayout {
+            name: ApiName::new(ns, id),
+            item,
+            deps,
+        });
+    }
+
+    /// Records the layout of a struct we've already seen, which the C++
+    /// we generate checks against the compiler's own, whether or not
+    /// the type turns out to be POD.
+    fn record_layout(&mut self, tn: &QualifiedName, layout: CppLayout) {
+        if let Some(UnanalyzedApi::Struct { analysis, .. }) = self
+            .apis
+            .iter_mut()
+            .rev()
+            .find(|api| matches!(api, UnanalyzedApi::Struct { name, .. } if name.name == *tn))
+        {
+            *analysis = Some(layout);
+        }
+    }
+
+    /// The arguments of each `assert_eq!` in one of bindgen's layout tests.
+    fn layout_test_assertions(
+        f: &ItemFn,
+    ) -> impl Iterator<Item = Punctuated<Expr, Token![,]>> + '_ {
+        f.block.stmts.iter().filter_map(|stmt| match stmt {
+            Stmt::Item(Item::Macro(ItemMacro { mac, .. }))
+            | Stmt::Semi(Expr::Macro(ExprMacro { mac, .. }), _)
+                if mac.path.is_ident("assert_eq") =>
+            {
+                mac.parse_body_with(Punctuated::<Expr, Token![,]>::parse_terminated)
+                    .ok()
+            }
+            _ => None,
+        })
+    }
+
+    /// The size and alignment which a layout test expects.
+    fn layout_test_to_cpp_layout(f: &ItemFn) -> Option<CppLayout> {
+        let mut size = None;
+        let mut align = None;
+        for args in Self::layout_test_assertions(f) {
+            let mut args = args.into_iter();
+            let (call, value) = match (args.next(), args.next()) {
+                (
+                    Some(Expr::Call(call)),
+                    Some(Expr::Lit(ExprLit {
+                        lit: Lit::Int(value),
+                        ..
+                    })),
+                ) => (call, value),
+                _ => continue,
+            };
+            let value = value.base10_parse().ok();
+            match Self::size_or_align_call(&call) {
+                Some("size_of") => size = value,
+                Some("align_of") => align = value,
+                _ => {}
+            }
+        }
+        Some(CppLayout {
+            size: size?,
+            align: align?,
+        })
+    }
+
+    /// bindgen generates tests which check the size and alignment of each
+    /// type matches that which clang told it. Turn these into compile-time
+    /// checks, so that we know that any Rust storage of the type matches
+    /// C++. Opaque types are zero-sized in Rust, so these checks are later
+    /// discarded for them, leaving only the C++ checks of [CppLayout].
+    /// Field offset checks are dropped.
+    fn layout_test_to_static_checks(f: &ItemFn) -> Option<Item> {
+        let checks: Vec<TokenStream> = Self::layout_test_assertions(f)
+            .filter_map(|args| {
+                let mut args = args.into_iter();
+                let rust_value = args.next()?;
+                let cpp_value = args.next()?;
+                match (&rust_value, &cpp_value) {
+                    (Expr::Call(call), Expr::Lit(_))
+                        if Self::size_or_align_call(call).is_some() =>
+                    {
+                        Some(quote! {
+                            const _: [(); #cpp_value] = [(); #rust_value];
+                        })
+                    }
+                    _ => None,
+                }
+            })
+            .collect();
+        if checks.is_empty() {
+            None
+        } else {
+            Some(Item::Const(parse_quote! {
+                const _: () = {
+                    #(#checks)*
+                };
+            }))
+        }
+    }
+
+    /// Whether this is a call to `size_of` or `align_of`, and which.
+    fn size_or_align_call(call: &ExprCall) -> Option<&'static str> {
+        match &*call.func {
+            Expr::Path(p) => {
+                let ident = &p.path.segments.last()?.ident;
+                if ident == "size_of" {
+                    Some("size_of")
+                } else if ident == "align_of" {
+                    Some("align_of")
+                } else {
+                    None
+                }
+            }
+            _ => None,
+        }
+    }
+
+    fn get_field_deps<'b>(fields: impl Iterator<Item = &'b Field>) -> HashSet<QualifiedName> {
+        fields
+            .filter_map(|f| match &f.ty {
+                Type::Path(typ) => Some(QualifiedName::from_type_path(typ)),
+                _ => None,
+            })
+            .collect()
+    }
+
+    /// bindgen generates Rust accessors for bitfields, in the same
+    /// impl block as the wrappers for C++ methods. Record the former as
+    /// a layout item and return whatever is left.
+    fn split_out_bitfield_accessors(
+        &mut self,
+        mut imp: ItemImpl,
+        ns: &Namespace,
+    ) -> Option<ItemImpl> {
+        let ty_id = match imp.self_ty.as_ref() {
+            Type::Path(typ) => typ.path.segments.last().unwrap().ident.clone(),
+            _ => return Some(imp),
+        };
+        if is_bindgen_layout_type(&ty_id.to_string()) {
+            // e.g. the implementation of __BindgenBitfieldUnit itself.
+            self.add_layout_item(ns, ty_id, Item::Impl(imp), HashSet::new());
+            return None;
+        }
+        let (accessors, others): (Vec<_>, Vec<_>) = std::mem::take(&mut imp.items)
+            .into_iter()
+            .partition(Self::is_bitfield_accessor);
+        if !accessors.is_empty() {
+            let mut accessor_imp = imp.clone();
+            accessor_imp.items = accessors;
+            let bitfield_unit =
+                QualifiedName::new(&Namespace::new(), make_ident("__BindgenBitfieldUnit"));
+            self.add_layout_item(
+                ns,
+                ty_id,
+                Item::Impl(accessor_imp),
+                std::iter::once(bitfield_unit).collect(),
+            );
+        }
+        imp.items = others;
+        Some(imp)
+    }
+
+    /// Spots the methods bindgen generates for bitfields:
+    /// `new_bitfield_N` constructors for the storage unit, and getters
+    /// and `set_` setters whose bodies call `self._bitfield_N.get` or
+    /// `.set`. Other methods which happen to mention such a field are
+    /// left alone.
+    fn is_bitfield_accessor(item: &ImplItem) -> bool {
+        let m = match item {
+            ImplItem::Method(m) => m,
+            _ => return false,
+        };
+        let name = m.sig.ident.to_string();
+        if let Some(unit) = name.strip_prefix("new_bitfield_") {
+            return is_all_digits(unit);
+        }
+        let (unit_access, expected_args) = if name.starts_with("set_") {
+            ("set", 2)
+        } else {
+            ("get", 1)
+        };
+        if m.sig.inputs.len() != expected_args {
+            return false;
+        }
+        let mut finder = BitfieldUnitAccessFinder {
+            method: unit_access,
+            found: false,
+        };
+        finder.visit_block(&m.block);
+        finder.found
+    }
+
     fn spot_forward_declaration(s: &Fields) -> bool {
         s.iter()
             .filter_map(|f| f.ident.as_ref())
@@ -302,6 +545,56 @@ impl<'a> ParseBindgen<'a> {
                 return Err(ConvertError::DidNotGenerateAnything(generate_directive));
             }
         }
+        // Traits are implemented in terms of operators which only
+        // a complete type can have.
+        let struct_names: HashSet<_> = self
+            .apis
+            .iter()
+            .filter(|api| matches!(api, UnanalyzedApi::Struct { .. }))
+            .map(|api| api.name().to_cpp_name())
+            .collect();
+        for (ty, _) in self.config.get_trait_requests() {
+            if !struct_names.contains(ty) {
+                return Err(ConvertError::NoTypeForTraits(ty.to_string()));
+            }
+        }
         Ok(())
     }
 }
+
+/// Looks for a call to `method` on a `self._bitfield_N` field.
+struct BitfieldUnitAccessFinder {
+    method: &'static str,
+    found: bool,
+}
+
+impl<'ast> Visit<'ast> for BitfieldUnitAccessFinder {
+    fn visit_expr_method_call(&mut self, call: &'ast ExprMethodCall) {
+        if call.method == self.method && is_bitfield_unit(&call.receiver) {
+            self.found = true;
+        }
+        syn::visit::visit_expr_method_call(self, call);
+    }
+}
+
+fn is_bitfield_unit(expr: &Expr) -> bool {
+    match expr {
+        Expr::Field(ExprField {
+            base,
+            member: Member::Named(field),
+            ..
+        }) => {
+            matches!(base.as_ref(), Expr::Path(path) if path.path.is_ident("self"))
+                && field
+                    .to_string()
+                    .strip_prefix("_bitfield_")
+                    .map(is_all_digits)
+                    .unwrap_or(false)
+        }
+        _ => false,
+    }
+}
+
+fn is_all_digits(s: &str) -> bool {
+    !s.is_empty() && s.chars().all(|c| c.is_ascii_digit())
+}
@@ -16,7 +16,6 @@ use crate::conversion::error_reporter::report_any_error;
 use crate::conversion::{
     api::{FuncToConvert, UnanalyzedApi},
     convert_error::ConvertErrorWithContext,
-    convert_error::ErrorContext,
 };
 use crate::{
     conversion::ConvertError,
@@ -42,6 +41,8 @@ pub(crate) struct ParseForeignMod {
     // may actually be methods (static or otherwise). Mapping from
     // function name to type name.
     method_receivers: HashMap<Ident, QualifiedName>,
+    // Global variables, which need no further context.
+    statics: Vec<UnanalyzedApi>,
     ignored_apis: Vec<UnanalyzedApi>,
 }
 
@@ -51,6 +52,7 @@ impl ParseForeignMod {
             ns,
             funcs_to_convert: Vec::new(),
             method_receivers: HashMap::new(),
+            statics: Vec::new(),
             ignored_apis: Vec::new(),
         }
     }
@@ -85,10 +87,14 @@ impl ParseForeignMod {
                 });
                 Ok(())
             }
-            ForeignItem::Static(item) => Err(ConvertErrorWithContext(
-                ConvertError::StaticData(item.ident.to_string()),
-                Some(ErrorContext::Item(item.ident)),
-            )),
+            ForeignItem::Static(item) => {
+                self.statics.push(UnanalyzedApi::Static {
+                    name: api_name(&self.ns, item.ident.clone(), &item.attrs),
+                    static_item: item,
+                    analysis: (),
+                });
+                Ok(())
+            }
             _ => Err(ConvertErrorWithContext(
                 ConvertError::UnexpectedForeignItem,
                 None,
@@ -126,6 +132,7 @@ impl ParseForeignMod {
     /// the resulting APIs.
     pub(crate) fn finished(mut self, apis: &mut Vec<UnanalyzedApi>) {
         apis.append(&mut self.ignored_apis);
+        apis.append(&mut self.statics);
         while !self.funcs_to_convert.is_empty() {
             let mut fun = self.funcs_to_convert.remove(0);
             fun.self_ty = self.method_receivers.get(&fun.item.sig.ident).cloned();
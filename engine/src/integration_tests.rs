@@ -185,6 +185,7 @@ enum TestError {
     RsFileRead(std::io::Error),
     RsFileParse(syn::Error),
     RsCodeExaminationFail,
+    FastParseMismatch,
 }
 
 #[allow(clippy::too_many_arguments)] // least typing for each test
@@ -277,6 +278,10 @@ where
     let rs_path = write_rust_to_file(&rust_code);
 
     info!("Path is {:?}", tdir.path());
+    if std::env::var_os("AUTOCXX_VERIFY_FAST_PARSE").is_some() {
+        // Panic, since tests which expect failure accept any error.
+        verify_fast_parse(&rs_path, tdir.path(), extra_clang_args).unwrap();
+    }
     let build_results = crate::builder::build_to_custom_directory(
         &rs_path,
         &[tdir.path()],
@@ -341,6 +346,54 @@ where
     Ok(())
 }
 
+/// Checks that [crate::AUTOCXX_FAST_PARSE] makes no difference to the
+/// outcome of generating code for a test: the same code, or the same
+/// error. Set `AUTOCXX_VERIFY_FAST_PARSE` when running the tests to
+/// check this across all of them. Whether generation ought to succeed
+/// is for each test to check, since some expect it to fail.
+fn verify_fast_parse(
+    rs_path: &Path,
+    inc_dir: &Path,
+    extra_clang_args: &[&str],
+) -> Result<(), TestError> {
+    let mut fast_clang_args = extra_clang_args.to_vec();
+    fast_clang_args.extend(crate::FAST_PARSE_CLANG_ARGS);
+    if generate_in_memory(rs_path, inc_dir, extra_clang_args)
+        == generate_in_memory(rs_path, inc_dir, &fast_clang_args)
+    {
+        Ok(())
+    } else {
+        Err(TestError::FastParseMismatch)
+    }
+}
+
+/// All the code generated for a file, as text, or the error with which
+/// generation failed.
+fn generate_in_memory(
+    rs_path: &Path,
+    inc_dir: &Path,
+    clang_args: &[&str],
+) -> Result<String, String> {
+    let mut parsed_file = crate::parse_file(rs_path).map_err(|e| e.to_string())?;
+    parsed_file
+        .resolve_all(vec![inc_dir.to_path_buf()], clang_args, None)
+        .map_err(|e| e.to_string())?;
+    let artifacts = parsed_file
+        .generate_artifacts()
+        .map_err(|e| e.to_string())?;
+    let mut output = String::new();
+    for (filename, rs) in artifacts.rs {
+        output.push_str(&format!("{}\n{}\n", filename, rs));
+    }
+    for cpp in artifacts.cpp {
+        output.push_str(&String::from_utf8_lossy(&cpp.header));
+        if let Some(implementation) = cpp.implementation {
+            output.push_str(&String::from_utf8_lossy(&implementation));
+        }
+    }
+    Ok(output)
+}
+
 #[test]
 fn test_return_void() {
     let cxx = indoc! {"
@@ -774,6 +827,460 @@ fn test_take_as_pod_with_is_relocatable() {
     run_test(cxx, hdr, rs, &["take_bob"], &["Bob"]);
 }
 
+#[test]
+fn test_drop_pod_with_is_relocatable() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <type_traits>
+        inline uint32_t& destroyed_count() {
+            static uint32_t count = 0;
+            return count;
+        }
+        struct Bob {
+            uint32_t a;
+            inline Bob() : a(0) {}
+            inline ~Bob() { destroyed_count()++; }
+            inline Bob(Bob&& other_bob) : a(other_bob.a) {}
+            using IsRelocatable = std::true_type;
+        };
+        inline Bob make_bob(uint32_t a) {
+            Bob b;
+            b.a = a;
+            return b;
+        }
+        inline uint32_t get_a(const Bob& b) {
+            return b.a;
+        }
+        inline uint32_t get_destroyed() {
+            return destroyed_count();
+        }
+    "};
+    let rs = quote! {
+        let bob = ffi::make_bob(3);
+        assert_eq!(ffi::get_a(&bob), 3);
+        let before = ffi::get_destroyed();
+        drop(bob);
+        assert_eq!(ffi::get_destroyed(), before + 1);
+    };
+    run_test(
+        "",
+        hdr,
+        rs,
+        &["make_bob", "get_a", "get_destroyed"],
+        &["Bob"],
+    );
+}
+
+#[test]
+fn test_take_as_pod_with_is_not_relocatable() {
+    // Only a marker aliasing std::true_type makes a type relocatable.
+    let cxx = indoc! {"
+        uint32_t take_bob(Bob a) {
+            return a.a;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <type_traits>
+        struct Bob {
+            uint32_t a;
+            uint32_t b;
+            inline Bob() {}
+            inline ~Bob() {}
+            inline Bob(Bob&& other_bob) {}
+            using IsRelocatable = std::false_type;
+        };
+        uint32_t take_bob(Bob a);
+    "};
+    let rs = quote! {
+        let a = ffi::Bob { a: 12, b: 13 };
+        assert_eq!(ffi::take_bob(a), 12);
+    };
+    run_test_expect_fail(cxx, hdr, rs, &["take_bob"], &["Bob"]);
+}
+
+#[test]
+fn test_relocatable_with_generate_all() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct Bob {
+            uint32_t a;
+            inline Bob() : a(0) {}
+            inline ~Bob() {}
+            inline Bob(Bob&& other_bob) : a(other_bob.a) {}
+        };
+        inline Bob make_bob(uint32_t a) {
+            Bob b;
+            b.a = a;
+            return b;
+        }
+    "};
+    let rs = quote! {
+        let bob = ffi::make_bob(3);
+        assert_eq!(bob.a, 3);
+    };
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &[],
+        &[],
+        Some(quote! {
+            generate_all!()
+            relocatable!("Bob")
+        }),
+        &[],
+        None,
+    );
+}
+
+#[test]
+fn test_relocatable_with_unique_ptr_field() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <memory>
+        inline uint32_t& destroyed_count() {
+            static uint32_t count = 0;
+            return count;
+        }
+        struct Payload {
+            uint32_t val;
+            inline ~Payload() { destroyed_count()++; }
+        };
+        struct Holder {
+            std::unique_ptr<Payload> payload;
+            uint32_t extra;
+        };
+        inline Holder make_holder(uint32_t val) {
+            Holder h;
+            h.payload = std::unique_ptr<Payload>(new Payload());
+            h.payload->val = val;
+            h.extra = 1;
+            return h;
+        }
+        inline uint32_t get_total(const Holder& h) {
+            return h.payload->val + h.extra;
+        }
+        inline uint32_t take_holder(Holder h) {
+            return h.payload->val;
+        }
+        inline uint32_t get_destroyed() {
+            return destroyed_count();
+        }
+    "};
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                generate!("make_holder")
+                generate!("get_total")
+                generate!("take_holder")
+                generate!("get_destroyed")
+                relocatable!("Holder")
+            }
+            fn main() {
+                let holder = ffi::make_holder(3);
+                assert_eq!(holder.extra, 1);
+                assert_eq!(ffi::get_total(&holder), 4);
+                let before = ffi::get_destroyed();
+                drop(holder);
+                assert_eq!(ffi::get_destroyed(), before + 1);
+                let holder = ffi::make_holder(5);
+                assert_eq!(ffi::take_holder(holder), 5);
+                assert_eq!(ffi::get_destroyed(), before + 2);
+            }
+        }
+    };
+    do_run_test_manual("", hdr, rs, &[], None).unwrap();
+}
+
+#[test]
+fn test_pod_with_unique_ptr_field_not_relocatable() {
+    // Without relocatable!, nothing would destroy the unique_ptr.
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <memory>
+        struct Payload {
+            uint32_t val;
+        };
+        struct Holder {
+            std::unique_ptr<Payload> payload;
+            uint32_t extra;
+        };
+        inline uint32_t get_extra(const Holder& h) {
+            return h.extra;
+        }
+    "};
+    let rs = quote! {};
+    run_test_expect_fail("", hdr, rs, &["get_extra"], &["Holder"]);
+}
+
+#[test]
+fn test_pod_with_bitfields() {
+    let cxx = indoc! {"
+        Flags make_flags() {
+            Flags f;
+            f.a = 1;
+            f.b = 5;
+            f.c = 300;
+            return f;
+        }
+        uint32_t get_b(Flags f) {
+            return f.b;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct Flags {
+            uint32_t a : 1;
+            uint32_t b : 3;
+            uint32_t c : 12;
+        };
+        Flags make_flags();
+        uint32_t get_b(Flags f);
+    "};
+    let rs = quote! {
+        let mut f = ffi::make_flags();
+        assert_eq!(f.a(), 1);
+        assert_eq!(f.b(), 5);
+        assert_eq!(f.c(), 300);
+        f.set_b(2);
+        assert_eq!(ffi::get_b(f), 2);
+    };
+    run_test(cxx, hdr, rs, &["make_flags", "get_b"], &["Flags"]);
+}
+
+#[test]
+fn test_pod_with_anonymous_union() {
+    let cxx = indoc! {"
+        uint32_t get_bits(Value v) {
+            return v.bits;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct Value {
+            uint32_t tag;
+            union {
+                uint32_t bits;
+                float f;
+            };
+        };
+        uint32_t get_bits(Value v);
+    "};
+    let rs = quote! {
+        let mut v: ffi::Value = unsafe { std::mem::zeroed() };
+        v.tag = 1;
+        v.__bindgen_anon_1.bits = 42;
+        assert_eq!(ffi::get_bits(v), 42);
+    };
+    run_test(cxx, hdr, rs, &["get_bits"], &["Value"]);
+}
+
+#[test]
+fn test_over_aligned_types() {
+    let cxx = indoc! {"
+        Queue::Queue() : head(0) {}
+        Queue::~Queue() {}
+        Counter make_counter() {
+            Counter c;
+            c.count = 3;
+            return c;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct alignas(64) Counter {
+            uint64_t count;
+        };
+        struct alignas(64) Queue {
+            Queue();
+            ~Queue();
+            uint64_t head;
+        };
+        Counter make_counter();
+    "};
+    let rs = quote! {
+        assert_eq!(std::mem::align_of::<ffi::Counter>(), 64);
+        assert_eq!(std::mem::size_of::<ffi::Counter>(), 64);
+        let counters = [ffi::make_counter(), ffi::make_counter()];
+        assert_eq!(counters[1].count, 3);
+        assert_eq!(&counters[1] as *const _ as usize % 64, 0);
+        assert_eq!(std::mem::align_of::<ffi::Queue>(), 64);
+        let q = ffi::Queue::make_unique();
+        assert_eq!(q.as_ref().unwrap() as *const _ as usize % 64, 0);
+    };
+    run_test(cxx, hdr, rs, &["make_counter", "Queue"], &["Counter"]);
+}
+
+#[test]
+fn test_opaque_layout_checked() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct alignas(16) Queue {
+            Queue() {}
+            ~Queue() {}
+            uint64_t head;
+            uint64_t tail[3];
+        };
+    "};
+    // Queue is opaque, so zero-sized in Rust; its layout can only be
+    // checked in the generated C++.
+    let tdir = tempdir().unwrap();
+    write_to_file(&tdir, "input.h", &format!("#pragma once\n{}", hdr));
+    let hexathorpe = Token![#](Span::call_site());
+    let rs = quote! {
+        autocxx::include_cpp!(
+            #hexathorpe include "input.h"
+            safety!(unsafe_ffi)
+            generate!("Queue")
+        );
+    };
+    let rs_path = write_to_file(&tdir, "input.rs", &rs.to_string());
+    let output = generate_in_memory(&rs_path, tdir.path(), &[]).unwrap();
+    assert!(output.contains("static_assert(sizeof(::Queue) == 32 && alignof(::Queue) == 16"));
+}
+
+#[test]
+#[cfg(target_arch = "x86_64")]
+fn test_simd_by_value() {
+    let cxx = indoc! {"
+        __m128 add(__m128 a, __m128 b) {
+            return _mm_add_ps(a, b);
+        }
+        float first(Particle p) {
+            return _mm_cvtss_f32(p.pos);
+        }
+    "};
+    let hdr = indoc! {"
+        #include <immintrin.h>
+        struct Particle {
+            __m128 pos;
+            float mass;
+        };
+        __m128 add(__m128 a, __m128 b);
+        float first(Particle p);
+    "};
+    let rs = quote! {
+        use core::arch::x86_64::*;
+        let a = autocxx::m128(unsafe { _mm_set1_ps(1.5) });
+        let b = autocxx::m128(unsafe { _mm_set1_ps(2.0) });
+        let sum: __m128 = ffi::add(a, b).into();
+        assert_eq!(unsafe { _mm_cvtss_f32(sum) }, 3.5);
+        assert_eq!(std::mem::align_of::<ffi::Particle>(), 16);
+        let p = ffi::Particle {
+            pos: sum,
+            mass: 1.0,
+        };
+        assert_eq!(ffi::first(p), 3.5);
+    };
+    run_test(cxx, hdr, rs, &["add", "first"], &["Particle"]);
+}
+
+#[test]
+fn test_pod_constructed_in_rust() {
+    let cxx = indoc! {"
+        uint32_t area(Rect r) {
+            return r.size.w * r.size.h;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct Size {
+            uint32_t w;
+            uint32_t h;
+        };
+        struct Rect {
+            Size size;
+            int32_t origin[2];
+            const char* label;
+        };
+        uint32_t area(Rect r);
+    "};
+    let rs = quote! {
+        let r = ffi::Rect::default();
+        assert_eq!(r.size.w, 0);
+        assert!(r.label.is_null());
+        assert_eq!(ffi::area(r), 0);
+        let r = ffi::Rect::new(ffi::Size::new(3, 4), [1, 2], std::ptr::null());
+        assert_eq!(r.origin[1], 2);
+        assert_eq!(ffi::area(r), 12);
+    };
+    run_test_ex(
+        cxx,
+        hdr,
+        rs,
+        &["area"],
+        &[],
+        Some(quote! {
+            rust_constructible!("Rect")
+            rust_constructible!("Size")
+        }),
+        &[],
+        None,
+    );
+}
+
+#[test]
+fn test_pod_not_constructed_in_rust_unless_requested() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct Size {
+            uint32_t w = 1;
+            uint32_t h = 1;
+        };
+        inline uint32_t area(Size s) { return s.w * s.h; }
+    "};
+    let rs = quote! {};
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["area"],
+        &["Size"],
+        None,
+        &[],
+        Some(Box::new(|f| {
+            let mut ts = TokenStream::new();
+            f.to_tokens(&mut ts);
+            if ts.to_string().contains("impl Default for") {
+                Err(TestError::RsCodeExaminationFail)
+            } else {
+                Ok(())
+            }
+        })),
+    );
+}
+
+#[test]
+fn test_rust_constructible_with_constructor() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        struct Size {
+            Size() : w(1), h(1) {}
+            uint32_t w;
+            uint32_t h;
+        };
+        inline uint32_t area(Size s) { return s.w * s.h; }
+    "};
+    let rs = quote! {};
+    do_run_test(
+        "",
+        hdr,
+        rs,
+        &["area"],
+        &["Size"],
+        Some(quote! {
+            rust_constructible!("Size")
+        }),
+        &[],
+        None,
+    )
+    .expect_err("Unexpected success");
+}
+
 #[test]
 fn test_take_pod_by_ref() {
     let cxx = indoc! {"
@@ -1090,6 +1597,63 @@ fn test_take_char_by_ptr_in_wrapped_method() {
     run_test("", hdr, rs, &["A", "C"], &[]);
 }
 
+#[test]
+fn test_c_strings() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <cstring>
+        inline uint32_t count_chars(const char* s) {
+            return strlen(s);
+        }
+        inline uint32_t count_chars_raw(const char* s) {
+            return strlen(s);
+        }
+        inline const char* get_greeting() {
+            return \"hello\";
+        }
+        class Logger {
+        public:
+            Logger() : name(\"main\") {}
+            const char* get_name() const {
+                return name;
+            }
+            const char* get_tag() const {
+                return name;
+            }
+        private:
+            const char* name;
+        };
+    "};
+    let rs = quote! {
+        let msg = std::ffi::CStr::from_bytes_with_nul(b"abc\0").unwrap();
+        assert_eq!(ffi::count_chars(msg), 3);
+        assert_eq!(unsafe { ffi::count_chars_raw(msg.as_ptr()) }, 3);
+        let greeting: &'static std::ffi::CStr = unsafe { ffi::get_greeting() };
+        assert_eq!(greeting.to_str().unwrap(), "hello");
+        let logger = ffi::Logger::make_unique();
+        assert_eq!(logger.as_ref().unwrap().get_name().to_bytes(), b"main");
+        assert_eq!(
+            unsafe { logger.as_ref().unwrap().get_tag() }.to_bytes(),
+            b"main"
+        );
+    };
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["count_chars", "count_chars_raw", "get_greeting", "Logger"],
+        &[],
+        Some(quote! {
+            c_strings!("count_chars")
+            c_strings!("get_greeting")
+            c_strings!("Logger::get_name", nul_terminated)
+            c_strings!("Logger::get_tag")
+        }),
+        &[],
+        None,
+    );
+}
+
 #[test]
 fn test_take_nonpod_by_mut_ref() {
     let cxx = indoc! {"
@@ -1330,6 +1894,50 @@ fn test_enum_no_funcs() {
     run_test(cxx, hdr, rs, &["Bob"], &[]);
 }
 
+#[test]
+fn test_newtype_enum() {
+    let cxx = indoc! {"
+        Error give_unlisted_error() {
+            return static_cast<Error>(42);
+        }
+        bool is_not_found(Error e) {
+            return e == ERROR_NOT_FOUND;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        enum Error {
+            ERROR_OK = 0,
+            ERROR_NOT_FOUND = -4,
+            ERROR_TOO_BIG = 40000,
+        };
+        Error give_unlisted_error();
+        bool is_not_found(Error e);
+    "};
+    let rs = quote! {
+        assert!(ffi::is_not_found(ffi::Error::ERROR_NOT_FOUND));
+        assert!(!ffi::is_not_found(ffi::Error::ERROR_OK));
+        let unlisted = ffi::give_unlisted_error();
+        assert_eq!(unlisted.0, 42);
+        match unlisted {
+            ffi::Error::ERROR_OK | ffi::Error::ERROR_NOT_FOUND | ffi::Error::ERROR_TOO_BIG => {
+                panic!("Unexpected enumerator")
+            }
+            _ => {}
+        }
+    };
+    run_test_ex(
+        cxx,
+        hdr,
+        rs,
+        &["Error", "give_unlisted_error", "is_not_found"],
+        &[],
+        Some(quote! { newtype_enum!("Error") }),
+        &[],
+        Some(make_string_finder(vec!["pub struct Error"])),
+    );
+}
+
 #[test] // works, but causes compile warnings
 fn test_take_pod_class_by_value() {
     let cxx = indoc! {"
@@ -2211,6 +2819,119 @@ fn test_overload_constructors() {
     run_test(cxx, hdr, rs, &["Bob"], &[]);
 }
 
+#[test]
+fn test_make_vector() {
+    let cxx = indoc! {"
+        Bob::Bob() : id(7) {}
+        Bob::~Bob() {}
+        uint32_t Bob::get_id() const { return id; }
+        void Bob::set_id(uint32_t new_id) { id = new_id; }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <string>
+        class Bob {
+        public:
+            Bob();
+            ~Bob();
+            uint32_t get_id() const;
+            void set_id(uint32_t new_id);
+        private:
+            uint32_t id;
+            std::string name;
+        };
+    "};
+    let rs = quote! {
+        let mut bobs = ffi::Bob::make_vector(3);
+        assert_eq!(bobs.len(), 3);
+        assert_eq!(bobs.get(2).unwrap().get_id(), 7);
+        bobs.pin_mut().index_mut(1).unwrap().set_id(42);
+        assert_eq!(bobs.get(1).unwrap().get_id(), 42);
+        assert_eq!(bobs.get(0).unwrap().get_id(), 7);
+    };
+    run_test_ex(
+        cxx,
+        hdr,
+        rs,
+        &["Bob"],
+        &[],
+        Some(quote! {
+            make_vector!("Bob")
+        }),
+        &[],
+        None,
+    );
+}
+
+#[test]
+fn test_make_vector_not_generated_unless_requested() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        class Bob {
+        public:
+            Bob() : id(7) {}
+            uint32_t get_id() const { return id; }
+        private:
+            uint32_t id;
+        };
+    "};
+    let rs = quote! {
+        let bob = ffi::Bob::make_unique();
+        assert_eq!(bob.get_id(), 7);
+    };
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["Bob"],
+        &[],
+        None,
+        &[],
+        Some(Box::new(|f| {
+            let mut ts = TokenStream::new();
+            f.to_tokens(&mut ts);
+            if ts.to_string().contains("make_vector") {
+                Err(TestError::RsCodeExaminationFail)
+            } else {
+                Ok(())
+            }
+        })),
+    );
+}
+
+#[test]
+fn test_make_vector_name_clash() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        class Bob {
+        public:
+            Bob() : id(7) {}
+            uint32_t make_vector() const { return id + 1; }
+            uint32_t get_id() const { return id; }
+        private:
+            uint32_t id;
+        };
+    "};
+    let rs = quote! {
+        let bob = ffi::Bob::make_unique();
+        assert_eq!(bob.make_vector(), 8);
+        let bobs = ffi::Bob::make_vector1(2);
+        assert_eq!(bobs.get(1).unwrap().get_id(), 7);
+    };
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["Bob"],
+        &[],
+        Some(quote! {
+            make_vector!("Bob")
+        }),
+        &[],
+        None,
+    );
+}
+
 #[test]
 fn test_overload_functions() {
     let cxx = indoc! {"
@@ -2913,6 +3634,25 @@ fn test_make_string() {
     run_test("", hdr, rs, &["Bob"], &[]);
 }
 
+#[test]
+fn test_cxx_str() {
+    let hdr = indoc! {"
+        #include <string>
+        #include <cstdint>
+        inline uint32_t take_string(const std::string& s) { return s.size(); }
+    "};
+    let rs = quote! {
+        use ffi::AsCppStr;
+        let mut seen = None;
+        for _ in 0..3 {
+            let s = autocxx::cxx_str!("hello").as_cpp_str();
+            assert_eq!(ffi::take_string(s), 5);
+            assert!(std::ptr::eq(*seen.get_or_insert(s), s));
+        }
+    };
+    run_test("", hdr, rs, &["take_string"], &[]);
+}
+
 #[test]
 fn test_string_make_unique() {
     let hdr = indoc! {"
@@ -3692,85 +4432,387 @@ fn test_forward_declaration() {
         }
     "};
     let rs = quote! {
-        let b = ffi::B::make_unique();
-        let a = ffi::get_a();
-        b.daft(unsafe { a.as_ref().unwrap() });
-        unsafe { ffi::delete_a(a) };
+        let b = ffi::B::make_unique();
+        let a = ffi::get_a();
+        b.daft(unsafe { a.as_ref().unwrap() });
+        unsafe { ffi::delete_a(a) };
+    };
+    run_test(cpp, hdr, rs, &["B", "get_a", "delete_a"], &[]);
+}
+
+#[test]
+fn test_ulong() {
+    let hdr = indoc! {"
+    inline unsigned long daft(unsigned long a) { return a; }
+    "};
+    let rs = quote! {
+        assert_eq!(ffi::daft(autocxx::c_ulong(34)), autocxx::c_ulong(34));
+    };
+    run_test("", hdr, rs, &["daft"], &[]);
+}
+
+#[test]
+fn test_typedef_to_ulong() {
+    let hdr = indoc! {"
+        #include <cstddef>
+        inline size_t daft(size_t a) { return a; }
+    "};
+    let rs = quote! {
+        assert_eq!(ffi::daft(autocxx::c_ulong(34)), autocxx::c_ulong(34));
+    };
+    run_test("", hdr, rs, &["daft"], &[]);
+}
+
+#[test]
+fn test_generate_typedef_to_ulong() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        typedef uint32_t fish_t;
+    "};
+    let rs = quote! {
+        let _: ffi::fish_t;
+    };
+    run_test("", hdr, rs, &[], &["fish_t"]);
+}
+
+#[test]
+fn test_ulong_method() {
+    let hdr = indoc! {"
+    class A {
+        public:
+        A() {};
+        unsigned long daft(unsigned long a) const { return a; }
+    };
+    "};
+    let rs = quote! {
+        let a = ffi::A::make_unique();
+        assert_eq!(a.as_ref().unwrap().daft(autocxx::c_ulong(34)), autocxx::c_ulong(34));
+    };
+    run_test("", hdr, rs, &["A"], &[]);
+}
+
+#[test]
+fn test_ulong_wrapped_method() {
+    let hdr = indoc! {"
+    #include <cstdint>
+    struct B {
+        B() {};
+        uint32_t a;
+    };
+    class A {
+        public:
+        A() {};
+        unsigned long daft(unsigned long a, B) const { return a; }
+    };
+    "};
+    let rs = quote! {
+        let b = ffi::B::make_unique();
+        let a = ffi::A::make_unique();
+        assert_eq!(a.as_ref().unwrap().daft(autocxx::c_ulong(34), b), autocxx::c_ulong(34));
+    };
+    run_test("", hdr, rs, &["A", "B"], &[]);
+}
+
+#[test]
+fn test_fast_parse() {
+    let hdr = indoc! {"
+    #include <cstdint>
+    #include <vector>
+    template <typename T> T accumulate(const std::vector<T>& items) {
+        T total {};
+        for (const auto& item : items) {
+            total += item;
+        }
+        return total;
+    }
+    inline uint32_t sum_to(uint32_t n) {
+        std::vector<uint32_t> items;
+        for (uint32_t i = 1; i <= n; i++) {
+            items.push_back(i);
+        }
+        return accumulate(items);
+    }
+    "};
+    // FAST_PARSE_CLANG_ARGS are for libclang, not necessarily for the
+    // C++ compiler used by run_test_ex, so just compare the generated code.
+    let tdir = tempdir().unwrap();
+    write_to_file(&tdir, "input.h", &format!("#pragma once\n{}", hdr));
+    let hexathorpe = Token![#](Span::call_site());
+    let rs = quote! {
+        autocxx::include_cpp!(
+            #hexathorpe include "input.h"
+            safety!(unsafe_ffi)
+            generate!("sum_to")
+        );
     };
-    run_test(cpp, hdr, rs, &["B", "get_a", "delete_a"], &[]);
+    let rs_path = write_to_file(&tdir, "input.rs", &rs.to_string());
+    generate_in_memory(&rs_path, tdir.path(), &[]).unwrap();
+    verify_fast_parse(&rs_path, tdir.path(), &[]).unwrap();
 }
 
 #[test]
-fn test_ulong() {
+fn test_stl_stubs() {
     let hdr = indoc! {"
-    inline unsigned long daft(unsigned long a) { return a; }
+    #include <cstdint>
+    #include <map>
+    #include <memory>
+    #include <string>
+    #include <vector>
+    inline std::unique_ptr<std::string> make_name() {
+        return std::make_unique<std::string>(\"Bob\");
+    }
+    inline uint32_t sum(const std::vector<uint32_t>& items) {
+        uint32_t total = 0;
+        for (auto item : items) {
+            total += item;
+        }
+        return total;
+    }
+    inline size_t count_names(const std::map<std::string, uint32_t>& names) {
+        return names.size();
+    }
+    struct Person {
+        std::string name;
+        std::vector<uint32_t> scores;
+        std::unique_ptr<Person> manager;
+        uint32_t age;
+    };
     "};
+    // Like test_fast_parse, just compare the generated code.
+    let tdir = tempdir().unwrap();
+    write_to_file(&tdir, "input.h", &format!("#pragma once\n{}", hdr));
+    let hexathorpe = Token![#](Span::call_site());
     let rs = quote! {
-        assert_eq!(ffi::daft(autocxx::c_ulong(34)), autocxx::c_ulong(34));
-    };
-    run_test("", hdr, rs, &["daft"], &[]);
+        autocxx::include_cpp!(
+            #hexathorpe include "input.h"
+            safety!(unsafe_ffi)
+            generate!("make_name")
+            generate!("sum")
+            generate!("Person")
+        );
+    };
+    let rs_path = write_to_file(&tdir, "input.rs", &rs.to_string());
+    let stub_args = crate::stl_stubs::stl_stub_clang_args().unwrap();
+    let stub_args: Vec<&str> = stub_args.iter().map(|s| s.as_str()).collect();
+    let normal = generate_in_memory(&rs_path, tdir.path(), &[]);
+    // The layout of Person depends on that of the standard library
+    // types, which the generated C++ checks against the real headers.
+    assert!(normal
+        .as_ref()
+        .unwrap()
+        .contains("static_assert(sizeof(::Person) =="));
+    assert_eq!(
+        normal,
+        generate_in_memory(&rs_path, tdir.path(), &stub_args)
+    );
 }
 
 #[test]
-fn test_typedef_to_ulong() {
+fn test_profile() {
     let hdr = indoc! {"
-        #include <cstddef>
-        inline size_t daft(size_t a) { return a; }
+    #include <cstdint>
+    struct A {
+        static uint32_t hot() { return 1; }
+        static uint32_t cold() { return 2; }
+        static uint32_t unprofiled() { return 3; }
+    };
     "};
     let rs = quote! {
-        assert_eq!(ffi::daft(autocxx::c_ulong(34)), autocxx::c_ulong(34));
+        assert_eq!(ffi::A::hot(), 1);
+        assert_eq!(ffi::A::cold(), 2);
+        assert_eq!(ffi::A::unprofiled(), 3);
     };
-    run_test("", hdr, rs, &["daft"], &[]);
+    // Paths are relative to CARGO_MANIFEST_DIR, so use an absolute one.
+    let profile_dir = tempdir().unwrap();
+    let profile_path = write_to_file(&profile_dir, "profile.txt", "A::hot 1000\nA::cold 1\n");
+    let profile_path = profile_path.to_str().unwrap();
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["A"],
+        &[],
+        Some(quote! { profile_from_file!(#profile_path) }),
+        &[],
+        Some(make_string_finder(vec![
+            "# [inline] pub fn hot",
+            "# [cold] # [inline (never)] pub fn cold",
+        ])),
+    );
 }
 
 #[test]
-fn test_generate_typedef_to_ulong() {
+fn test_generate_if() {
     let hdr = indoc! {"
-        #include <cstdint>
-        typedef uint32_t fish_t;
+    #include <cstdint>
+    inline uint32_t net_fn() { return 1; }
+    inline uint32_t gpu_fn() { return 2; }
     "};
+    let tdir = tempdir().unwrap();
+    write_to_file(&tdir, "input.h", &format!("#pragma once\n{}", hdr));
+    let hexathorpe = Token![#](Span::call_site());
     let rs = quote! {
-        let _: ffi::fish_t;
+        autocxx::include_cpp!(
+            #hexathorpe include "input.h"
+            safety!(unsafe_ffi)
+            generate_if!("test-net", "net_fn")
+            generate_if!("test-gpu", "gpu_fn")
+        );
     };
-    run_test("", hdr, rs, &[], &["fish_t"]);
+    let rs_path = write_to_file(&tdir, "input.rs", &rs.to_string());
+    let mut parsed_file = crate::parse_file(&rs_path).unwrap();
+    parsed_file.set_cargo_features(&["test-net"]);
+    parsed_file
+        .resolve_all(vec![tdir.path().to_path_buf()], &[], None)
+        .unwrap();
+    let rs = parsed_file.generate_artifacts().unwrap().rs;
+    let rs: Vec<_> = rs.iter().map(|(_, ts)| ts.to_string()).collect();
+    let rs = rs.join("\n");
+    assert!(rs.contains("net_fn"));
+    assert!(!rs.contains("gpu_fn"));
 }
 
 #[test]
-fn test_ulong_method() {
+fn test_smart_ptr() {
     let hdr = indoc! {"
-    class A {
-        public:
-        A() {};
-        unsigned long daft(unsigned long a) const { return a; }
+    #include <cstdint>
+    namespace base {
+    template <typename T> class scoped_refptr {
+    public:
+        explicit scoped_refptr(T* ptr) : ptr_(ptr) { if (ptr_) ptr_->AddRef(); }
+        scoped_refptr(const scoped_refptr& other) : scoped_refptr(other.ptr_) {}
+        scoped_refptr(scoped_refptr&& other) : ptr_(other.ptr_) { other.ptr_ = nullptr; }
+        ~scoped_refptr() { if (ptr_) ptr_->Release(); }
+        T* get() const { return ptr_; }
+    private:
+        T* ptr_;
+    };
+    }
+    class Foo {
+    public:
+        Foo(uint32_t value) : value_(value), refs_(0) {}
+        void AddRef() { refs_++; }
+        void Release() { if (--refs_ == 0) delete this; }
+        uint32_t get() const { return value_; }
+        uint32_t refs() const { return refs_; }
+    private:
+        uint32_t value_;
+        uint32_t refs_;
     };
+    inline base::scoped_refptr<Foo> make_foo() {
+        return base::scoped_refptr<Foo>(new Foo(42));
+    }
+    inline uint32_t refs_while_held(base::scoped_refptr<Foo> foo) {
+        return foo.get()->refs();
+    }
     "};
     let rs = quote! {
-        let a = ffi::A::make_unique();
-        assert_eq!(a.as_ref().unwrap().daft(autocxx::c_ulong(34)), autocxx::c_ulong(34));
+        let p = ffi::make_foo();
+        assert_eq!(p.get(), 42);
+        assert_eq!(p.refs(), 1);
+        let q = p.clone();
+        assert_eq!(q.refs(), 2);
+        assert_eq!(p.as_ptr(), q.as_ptr());
+        drop(p);
+        assert_eq!(q.refs(), 1);
+        // Moved into C++ without another reference, which is released
+        // when C++ is done with it.
+        let r = q.clone();
+        assert_eq!(ffi::refs_while_held(r), 2);
+        assert_eq!(q.refs(), 1);
     };
-    run_test("", hdr, rs, &["A"], &[]);
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["make_foo", "refs_while_held", "Foo"],
+        &[],
+        Some(quote! {
+            smart_ptr!("base::scoped_refptr")
+        }),
+        &[],
+        None,
+    );
 }
 
 #[test]
-fn test_ulong_wrapped_method() {
+fn test_primitive_ctypes() {
     let hdr = indoc! {"
-    #include <cstdint>
-    struct B {
-        B() {};
-        uint32_t a;
+    inline int sum(const int* values, unsigned short count) {
+        int total = 0;
+        for (unsigned short i = 0; i < count; i++) {
+            total += values[i];
+        }
+        return total;
+    }
+    "};
+    let rs = quote! {
+        let values: Vec<i32> = vec![1, 2, 3];
+        let total: i32 = unsafe { ffi::sum(values.as_ptr(), 3u16) };
+        assert_eq!(total, 6);
     };
-    class A {
-        public:
-        A() {};
-        unsigned long daft(unsigned long a, B) const { return a; }
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["sum"],
+        &[],
+        Some(quote! {
+            primitive_ctypes!()
+        }),
+        &[],
+        None,
+    );
+}
+
+#[test]
+fn test_primitive_ctypes_per_target() {
+    // Whether long is int64_t depends on the target we generate for,
+    // not the one we're running on. Only compare the generated code,
+    // since we can't build for these targets.
+    let hdr = indoc! {"
+    inline long twice(long a) { return a * 2; }
+    "};
+    let tdir = tempdir().unwrap();
+    write_to_file(&tdir, "input.h", &format!("#pragma once\n{}", hdr));
+    let hexathorpe = Token![#](Span::call_site());
+    let rs = quote! {
+        autocxx::include_cpp!(
+            #hexathorpe include "input.h"
+            safety!(unsafe_ffi)
+            generate!("twice")
+            primitive_ctypes!()
+        );
     };
+    let rs_path = write_to_file(&tdir, "input.rs", &rs.to_string());
+    let linux =
+        generate_in_memory(&rs_path, tdir.path(), &["--target=s390x-unknown-linux-gnu"]).unwrap();
+    assert!(linux.contains("std::is_same<long, int64_t>"));
+    let mac =
+        generate_in_memory(&rs_path, tdir.path(), &["--target=aarch64-apple-darwin"]).unwrap();
+    assert!(!mac.contains("int64_t"));
+    assert!(mac.contains("c_long"));
+}
+
+#[test]
+fn test_ctype_slice_casts() {
+    let hdr = indoc! {"
+    inline int sum(const int* values, int count) {
+        int total = 0;
+        for (int i = 0; i < count; i++) {
+            total += values[i];
+        }
+        return total;
+    }
     "};
     let rs = quote! {
-        let b = ffi::B::make_unique();
-        let a = ffi::A::make_unique();
-        assert_eq!(a.as_ref().unwrap().daft(autocxx::c_ulong(34), b), autocxx::c_ulong(34));
+        let values = [1, 2, 3];
+        let wrapped = autocxx::c_int::from_raw_slice(&values);
+        assert_eq!(autocxx::c_int::as_raw_slice(wrapped), &values);
+        let total = unsafe { ffi::sum(wrapped.as_ptr(), autocxx::c_int(3)) };
+        assert_eq!(total, autocxx::c_int(6));
     };
-    run_test("", hdr, rs, &["A", "B"], &[]);
+    run_test("", hdr, rs, &["sum"], &[]);
 }
 
 #[test]
@@ -4582,99 +5624,366 @@ fn test_issue_264() {
         template <typename, typename, typename ad> class e {
           typedef q::w<ad> s;
         public:
-          typedef typename s::ab ab;
-        };
-        } // namespace c
-        } // namespace a
-        namespace ag {
-        namespace ah {
-        typedef a::f::ab t;
-        class ai {
-          t aj;
+          typedef typename s::ab ab;
+        };
+        } // namespace c
+        } // namespace a
+        namespace ag {
+        namespace ah {
+        typedef a::f::ab t;
+        class ai {
+          t aj;
+        };
+        class al;
+        namespace am {
+        class an {
+        public:
+          void ao(ai);
+        };
+        } // namespace am
+        class ap {
+        public:
+          al aq();
+        };
+        class ar {
+          am::an as;
+        };
+        class al {
+          ar at;
+        };
+        struct au {
+          ap av;
+        };
+        } // namespace ah
+        } // namespace ag
+        namespace operations_research {
+        class aw {
+          ag::ah::au ax;
+        };
+        class Solver {
+          aw ay;
+        };
+        } // namespace operations_research
+    "};
+    let rs = quote! {};
+    run_test("", hdr, rs, &["operations_research::Solver"], &[]);
+}
+
+#[test]
+fn test_unexpected_use() {
+    // https://github.com/google/autocxx/issues/303
+    let hdr = indoc! {"
+        typedef int a;
+        namespace b {
+        namespace c {
+        enum d : a;
+        }
+        } // namespace b
+        namespace {
+        using d = b::c::d;
+        }
+        namespace content {
+        class RenderFrameHost {
+        public:
+            RenderFrameHost() {}
+        d e;
+        };
+        } // namespace content
+        "};
+    let rs = quote! {
+        let _ = ffi::content::RenderFrameHost::make_unique();
+    };
+    run_test("", hdr, rs, &["content::RenderFrameHost"], &[]);
+}
+
+#[test]
+fn test_get_pure_virtual() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        class A {
+        public:
+            virtual uint32_t get_val() const = 0;
+        };
+        class B : public A {
+        public:
+            virtual uint32_t get_val() const { return 3; }
+        };
+        const B b;
+        inline const A* get_a() { return &b; };
+    "};
+    let rs = quote! {
+        let a = ffi::get_a();
+        let a_ref = unsafe { a.as_ref() }.unwrap();
+        assert_eq!(a_ref.get_val(), 3);
+    };
+    run_test("", hdr, rs, &["A", "get_a"], &[]);
+}
+
+#[test]
+fn test_subclass() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        class Observer {
+        public:
+            virtual ~Observer() {}
+            virtual uint32_t get_total() const = 0;
+            virtual void notify(uint32_t val) = 0;
+        };
+        inline uint32_t notify_twice(Observer& obs) {
+            obs.notify(2);
+            obs.notify(3);
+            return obs.get_total();
+        }
+    "};
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                generate!("notify_twice")
+                subclass!("Observer", Counter)
+            }
+            #[derive(Default)]
+            struct Counter {
+                total: u32,
+            }
+            impl ffi::ObserverMethods for Counter {
+                fn get_total(&self) -> u32 {
+                    self.total
+                }
+                fn notify(&mut self, val: u32) {
+                    self.total += val;
+                }
+            }
+            fn main() {
+                let mut obs = Counter::default().into_cpp();
+                assert_eq!(ffi::notify_twice(obs.pin_mut()), 5);
+                assert_eq!(ffi::notify_twice(obs.pin_mut()), 10);
+            }
+        }
+    };
+    do_run_test_manual("", hdr, rs, &[], None).unwrap();
+}
+
+#[test]
+fn test_subclass_types_in_modules() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        class Observer {
+        public:
+            virtual ~Observer() {}
+            virtual uint32_t get_total() const = 0;
+            virtual void notify(uint32_t val) = 0;
+        };
+        inline uint32_t notify_twice(Observer& obs) {
+            obs.notify(2);
+            obs.notify(3);
+            return obs.get_total();
+        }
+    "};
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                generate!("notify_twice")
+                subclass!("Observer", first::Counter)
+                subclass!("Observer", self::second::Counter)
+            }
+            mod first {
+                #[derive(Default)]
+                pub struct Counter {
+                    pub total: u32,
+                }
+            }
+            mod second {
+                #[derive(Default)]
+                pub struct Counter {
+                    pub total: u32,
+                }
+            }
+            impl ffi::ObserverMethods for first::Counter {
+                fn get_total(&self) -> u32 {
+                    self.total
+                }
+                fn notify(&mut self, val: u32) {
+                    self.total += val;
+                }
+            }
+            impl ffi::ObserverMethods for second::Counter {
+                fn get_total(&self) -> u32 {
+                    self.total
+                }
+                fn notify(&mut self, val: u32) {
+                    self.total += val * 2;
+                }
+            }
+            fn main() {
+                let mut single = first::Counter::default().into_cpp();
+                let mut double = second::Counter::default().into_cpp();
+                assert_eq!(ffi::notify_twice(single.pin_mut()), 5);
+                assert_eq!(ffi::notify_twice(double.pin_mut()), 10);
+            }
+        }
+    };
+    do_run_test_manual("", hdr, rs, &[], None).unwrap();
+}
+
+#[test]
+fn test_subclass_inherited_pure_virtual() {
+    // We'd only override Observer::get_total, so our subclass would
+    // still be abstract.
+    let hdr = indoc! {"
+        #include <cstdint>
+        class Notifiable {
+        public:
+            virtual ~Notifiable() {}
+            virtual void notify(uint32_t val) = 0;
         };
-        class al;
-        namespace am {
-        class an {
+        class Observer : public Notifiable {
         public:
-          void ao(ai);
+            virtual uint32_t get_total() const = 0;
         };
-        } // namespace am
-        class ap {
+    "};
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                generate!("Notifiable")
+                subclass!("Observer", Counter)
+            }
+            struct Counter;
+            fn main() {}
+        }
+    };
+    do_run_test_manual("", hdr, rs, &[], Some(make_error_finder("Counter"))).unwrap();
+}
+
+#[test]
+fn test_subclass_inherited_pure_virtual_unlisted_base() {
+    // As above, but we aren't asked to generate Notifiable, so we must
+    // still spot that it's abstract.
+    let hdr = indoc! {"
+        #include <cstdint>
+        class Notifiable {
         public:
-          al aq();
-        };
-        class ar {
-          am::an as;
-        };
-        class al {
-          ar at;
-        };
-        struct au {
-          ap av;
-        };
-        } // namespace ah
-        } // namespace ag
-        namespace operations_research {
-        class aw {
-          ag::ah::au ax;
+            virtual ~Notifiable() {}
+            virtual void notify(uint32_t val) = 0;
         };
-        class Solver {
-          aw ay;
+        class Observer : public Notifiable {
+        public:
+            virtual uint32_t get_total() const = 0;
         };
-        } // namespace operations_research
     "};
-    let rs = quote! {};
-    run_test("", hdr, rs, &["operations_research::Solver"], &[]);
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                subclass!("Observer", Counter)
+            }
+            struct Counter;
+            fn main() {}
+        }
+    };
+    do_run_test_manual("", hdr, rs, &[], Some(make_error_finder("Counter"))).unwrap();
 }
 
 #[test]
-fn test_unexpected_use() {
-    // https://github.com/google/autocxx/issues/303
+fn test_subclass_concrete_unlisted_base() {
     let hdr = indoc! {"
-        typedef int a;
-        namespace b {
-        namespace c {
-        enum d : a;
-        }
-        } // namespace b
-        namespace {
-        using d = b::c::d;
-        }
-        namespace content {
-        class RenderFrameHost {
+        #include <cstdint>
+        class Base {
         public:
-            RenderFrameHost() {}
-        d e;
+            virtual ~Base() {}
+            uint32_t get_offset() const { return 1; }
         };
-        } // namespace content
-        "};
-    let rs = quote! {
-        let _ = ffi::content::RenderFrameHost::make_unique();
+        class Observer : public Base {
+        public:
+            virtual uint32_t get_total() const = 0;
+        };
+        inline uint32_t total_plus_offset(const Observer& obs) {
+            return obs.get_total() + obs.get_offset();
+        }
+    "};
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                generate!("total_plus_offset")
+                subclass!("Observer", Counter)
+            }
+            struct Counter;
+            impl ffi::ObserverMethods for Counter {
+                fn get_total(&self) -> u32 {
+                    2
+                }
+            }
+            fn main() {
+                let obs = Counter.into_cpp();
+                assert_eq!(ffi::total_plus_offset(&obs), 3);
+            }
+        }
     };
-    run_test("", hdr, rs, &["content::RenderFrameHost"], &[]);
+    do_run_test_manual("", hdr, rs, &[], None).unwrap();
 }
 
 #[test]
-fn test_get_pure_virtual() {
+fn test_subclass_similar_paths() {
+    // These would both flatten to a_b_c if we just joined them with '_'.
     let hdr = indoc! {"
         #include <cstdint>
-        class A {
-        public:
-            virtual uint32_t get_val() const = 0;
-        };
-        class B : public A {
+        class Observer {
         public:
-            virtual uint32_t get_val() const { return 3; }
+            virtual ~Observer() {}
+            virtual uint32_t get_total() const = 0;
         };
-        const B b;
-        inline const A* get_a() { return &b; };
+        inline uint32_t read_total(const Observer& obs) {
+            return obs.get_total();
+        }
     "};
-    let rs = quote! {
-        let a = ffi::get_a();
-        let a_ref = unsafe { a.as_ref() }.unwrap();
-        assert_eq!(a_ref.get_val(), 3);
+    let rs = |hdr| {
+        let hexathorpe = Token![#](Span::call_site());
+        quote! {
+            autocxx::include_cpp! {
+                #hexathorpe include #hdr
+                safety!(unsafe_ffi)
+                generate!("read_total")
+                subclass!("Observer", a::b_c)
+                subclass!("Observer", a_b::c)
+            }
+            #[allow(non_camel_case_types)]
+            mod a {
+                pub struct b_c;
+            }
+            #[allow(non_camel_case_types)]
+            mod a_b {
+                pub struct c;
+            }
+            impl ffi::ObserverMethods for a::b_c {
+                fn get_total(&self) -> u32 {
+                    1
+                }
+            }
+            impl ffi::ObserverMethods for a_b::c {
+                fn get_total(&self) -> u32 {
+                    2
+                }
+            }
+            fn main() {
+                assert_eq!(ffi::read_total(&a::b_c.into_cpp()), 1);
+                assert_eq!(ffi::read_total(&a_b::c.into_cpp()), 2);
+            }
+        }
     };
-    run_test("", hdr, rs, &["A", "get_a"], &[]);
+    do_run_test_manual("", hdr, rs, &[], None).unwrap();
 }
 
 #[test]
@@ -5169,7 +6478,7 @@ fn test_error_generated_for_static_data() {
             A() {}
             uint32_t a;
         };
-        static A FOO = A();
+        extern A FOO[2];
     "};
     let rs = quote! {};
     run_test_ex(
@@ -5184,6 +6493,100 @@ fn test_error_generated_for_static_data() {
     );
 }
 
+#[test]
+fn test_const_global() {
+    let cxx = indoc! {"
+        const uint32_t LIMIT = 7;
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        extern const uint32_t LIMIT;
+    "};
+    let rs = quote! {
+        assert_eq!(*ffi::LIMIT(), 7);
+        assert!(std::ptr::eq(ffi::LIMIT(), ffi::LIMIT()));
+    };
+    run_test(cxx, hdr, rs, &["LIMIT"], &[]);
+}
+
+#[test]
+fn test_mutable_global_in_namespace() {
+    let cxx = indoc! {"
+        namespace cfg {
+            uint32_t counter = 3;
+            uint32_t get_counter() { return counter; }
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        namespace cfg {
+            extern uint32_t counter;
+            uint32_t get_counter();
+        }
+    "};
+    let rs = quote! {
+        let mut counter = unsafe { ffi::cfg::counter() };
+        assert_eq!(*counter, 3);
+        *counter = 4;
+        assert_eq!(ffi::cfg::get_counter(), 4);
+    };
+    run_test(cxx, hdr, rs, &["cfg::counter", "cfg::get_counter"], &[]);
+}
+
+#[test]
+fn test_mutable_global_nonpod() {
+    let cxx = indoc! {"
+        Config CONFIG;
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <string>
+        struct Config {
+            Config() : verbosity(2) {}
+            std::string name;
+            uint32_t verbosity;
+            uint32_t get_verbosity() const { return verbosity; }
+        };
+        extern Config CONFIG;
+    "};
+    let rs = quote! {
+        let config = unsafe { ffi::CONFIG() };
+        assert_eq!(config.get_verbosity(), 2);
+    };
+    run_test(cxx, hdr, rs, &["CONFIG", "Config"], &[]);
+}
+
+#[test]
+fn test_static_data_member() {
+    let cxx = indoc! {"
+        namespace cfg {
+            uint32_t Settings::level = 5;
+        }
+    "};
+    let hdr = indoc! {"
+        #include <cstdint>
+        namespace cfg {
+            struct Settings {
+                static uint32_t level;
+            };
+        }
+    "};
+    let rs = quote! {
+        let level = unsafe { ffi::cfg::Settings_level() };
+        assert_eq!(*level, 5);
+    };
+    run_test_ex(
+        cxx,
+        hdr,
+        rs,
+        &[],
+        &[],
+        Some(quote! { generate_all!() }),
+        &[],
+        None,
+    );
+}
+
 #[test]
 fn test_error_generated_for_array_dependent_function() {
     let hdr = indoc! {"
@@ -5422,6 +6825,61 @@ fn test_include_cpp_in_path() {
     do_run_test_manual("", hdr, rs, &[], None).unwrap();
 }
 
+#[test]
+fn test_header_overlay() {
+    // Nothing here exists on disk.
+    let dir = std::env::temp_dir().join("autocxx_no_such_dir");
+    let rs = indoc! {r#"
+        autocxx::include_cpp! {
+            #include "unsaved.h"
+            safety!(unsafe_ffi)
+            generate!("give_int")
+        }
+    "#};
+    let overlay = [crate::HeaderOverlay {
+        path: dir.join("unsaved.h"),
+        contents: "#pragma once\ninline int give_int() { return 5; }\n".into(),
+    }];
+    let mut parsed_file = crate::parse_source(rs).unwrap();
+    parsed_file
+        .resolve_all_with_overlay(vec![dir], &[], None, &overlay)
+        .unwrap();
+    let artifacts = parsed_file.generate_artifacts().unwrap();
+    assert_eq!(artifacts.rs.len(), 1);
+    assert!(artifacts.rs[0].1.to_string().contains("give_int"));
+    assert!(artifacts
+        .cpp
+        .iter()
+        .any(|pair| pair.implementation.is_some()));
+}
+
+#[test]
+fn test_header_overlay_not_included() {
+    // Overlays which nothing includes aren't parsed at all.
+    let dir = std::env::temp_dir().join("autocxx_no_such_dir");
+    let rs = indoc! {r#"
+        autocxx::include_cpp! {
+            #include "unsaved.h"
+            safety!(unsafe_ffi)
+            generate!("give_int")
+        }
+    "#};
+    let overlay = [
+        crate::HeaderOverlay {
+            path: dir.join("unsaved.h"),
+            contents: "inline int give_int() { return 5; }\n".into(),
+        },
+        crate::HeaderOverlay {
+            path: dir.join("half_written.h"),
+            contents: "inline int give_int() { return".into(),
+        },
+    ];
+    let mut parsed_file = crate::parse_source(rs).unwrap();
+    parsed_file
+        .resolve_all_with_overlay(vec![dir], &[], None, &overlay)
+        .unwrap();
+}
+
 #[test]
 fn test_bitset() {
     let hdr = indoc! {"
@@ -5857,6 +7315,103 @@ fn test_shared_ptr() {
     );
 }
 
+#[test]
+fn test_impl_traits() {
+    let hdr = indoc! {"
+        #include <cstdint>
+        #include <functional>
+        #include <memory>
+        #include <string>
+        namespace a {
+        class Key {
+        public:
+            Key(std::string name, uint32_t version) : name(name), version(version) {}
+            bool operator==(const Key& other) const {
+                return name == other.name && version == other.version;
+            }
+            bool operator<(const Key& other) const {
+                return version < other.version;
+            }
+            std::string name;
+            uint32_t version;
+        };
+        inline std::unique_ptr<Key> make_key(uint32_t version) {
+            return std::make_unique<Key>(\"key\", version);
+        }
+        }
+        namespace std {
+        template<> struct hash<a::Key> {
+            size_t operator()(const a::Key& k) const {
+                return std::hash<std::string>{}(k.name) ^ k.version;
+            }
+        };
+        }
+    "};
+    let rs = quote! {
+        let k1 = ffi::a::make_key(1);
+        let k1_again = ffi::a::make_key(1);
+        let k2 = ffi::a::make_key(2);
+        assert!(k1.as_ref().unwrap() == k1_again.as_ref().unwrap());
+        assert!(k1.as_ref().unwrap() < k2.as_ref().unwrap());
+        let mut set = std::collections::HashSet::new();
+        set.insert(k1.as_ref().unwrap());
+        set.insert(k1_again.as_ref().unwrap());
+        set.insert(k2.as_ref().unwrap());
+        assert_eq!(set.len(), 2);
+        let mut sorted = vec![k2.as_ref().unwrap(), k1.as_ref().unwrap()];
+        sorted.sort();
+        assert!(sorted[0] == k1.as_ref().unwrap());
+    };
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &["a::Key", "a::make_key"],
+        &[],
+        Some(quote! { impl_traits!("a::Key", Ord, Hash) }),
+        &[],
+        None,
+    );
+}
+
+#[test]
+fn test_impl_traits_similar_names() {
+    // The helpers for these would both be a_b_c_autocxx_eq if we just
+    // joined the names with '_'.
+    let hdr = indoc! {"
+        #include <cstdint>
+        namespace a {
+        struct b_c {
+            uint32_t v;
+            bool operator==(const b_c& other) const { return v == other.v; }
+        };
+        }
+        namespace a_b {
+        struct c {
+            uint32_t v;
+            bool operator==(const c& other) const { return v != other.v; }
+        };
+        }
+    "};
+    let rs = quote! {
+        assert!(ffi::a::b_c { v: 1 } == ffi::a::b_c { v: 1 });
+        assert!(ffi::a_b::c { v: 1 } == ffi::a_b::c { v: 2 });
+    };
+    run_test_ex(
+        "",
+        hdr,
+        rs,
+        &[],
+        &["a::b_c", "a_b::c"],
+        Some(quote! {
+            impl_traits!("a::b_c", Eq)
+            impl_traits!("a_b::c", Eq)
+        }),
+        &[],
+        None,
+    );
+}
+
 // Yet to test:
 // - Ifdef
 // - Out param pointers
@@ -32,6 +32,9 @@ enum Behavior {
     RustByValue,
     CByValue,
     CVariableLengthByValue,
+    /// A SIMD vector type such as `__m128`, which we pass by value
+    /// using a wrapper around its `core::arch` equivalent.
+    CSimdVectorByValue,
     CVoid,
 }
 
@@ -112,6 +115,13 @@ impl TypeDetails {
         }
     }
 
+    fn is_plain_c(&self) -> bool {
+        matches!(
+            self.behavior,
+            Behavior::CByValue | Behavior::CVariableLengthByValue | Behavior::CSimdVectorByValue
+        )
+    }
+
     fn to_typename(&self) -> QualifiedName {
         QualifiedName::new_from_cpp_name(&self.rs_name)
     }
@@ -124,10 +134,36 @@ pub(crate) struct TypeDatabase {
     canonical_names: HashMap<QualifiedName, QualifiedName>,
 }
 
-/// Returns a database of known types.
+/// Returns a database of known types, including those which only exist
+/// on some targets. Use [known_types_for] to recognize the types in
+/// bindgen's output.
 pub(crate) fn known_types() -> &'static TypeDatabase {
     static KNOWN_TYPES: OnceCell<TypeDatabase> = OnceCell::new();
-    KNOWN_TYPES.get_or_init(create_type_database)
+    KNOWN_TYPES.get_or_init(|| create_type_database(true))
+}
+
+/// Returns a database of the types known on the given clang target
+/// triple, or else the platform we're running on. The SIMD vector types
+/// are only known on x86_64, the only architecture for which autocxx has
+/// wrappers for them; elsewhere, any types of the same names are the
+/// codebase's own.
+pub(crate) fn known_types_for(target: Option<&str>) -> &'static TypeDatabase {
+    static KNOWN_TYPES_WITHOUT_SIMD: OnceCell<TypeDatabase> = OnceCell::new();
+    if has_x86_64_simd(target) {
+        known_types()
+    } else {
+        KNOWN_TYPES_WITHOUT_SIMD.get_or_init(|| create_type_database(false))
+    }
+}
+
+fn has_x86_64_simd(target: Option<&str>) -> bool {
+    match target {
+        Some(target) => {
+            let arch = target.split('-').next().unwrap_or_default();
+            arch == "x86_64" || arch == "amd64"
+        }
+        None => cfg!(target_arch = "x86_64"),
+    }
 }
 
 impl TypeDatabase {
@@ -136,8 +172,7 @@ impl TypeDatabase {
         // when we encounter something like 'std::unique_ptr'
         // in the bindgen-generated bindings, we'll immediately
         // start to refer to that as 'UniquePtr' henceforth.
-        let canonical_name = self.canonical_names.get(ty).unwrap_or(ty);
-        self.by_rs_name.get(canonical_name)
+        self.by_rs_name.get(self.canonical_name(ty))
     }
 
     /// Prelude of C++ for squirting into bindgen. This configures
@@ -158,24 +193,38 @@ impl TypeDatabase {
     }
 
     /// Types which are known to be safe (or unsafe) to hold and pass by
-    /// value in Rust.
+    /// value in Rust. This includes the non-canonical names of plain C
+    /// types, since bindgen may use those for struct fields.
     pub(crate) fn get_pod_safe_types(&self) -> impl Iterator<Item = (&QualifiedName, bool)> {
-        self.by_rs_name.iter().map(|(tn, td)| {
-            (
-                tn,
-                match td.behavior {
-                    Behavior::CxxContainerByValueSafe
-                    | Behavior::RustStr
-                    | Behavior::RustString
-                    | Behavior::RustByValue
-                    | Behavior::CByValue
-                    | Behavior::CVariableLengthByValue => true,
-                    Behavior::CxxString
-                    | Behavior::CxxContainerNotByValueSafe
-                    | Behavior::CVoid => false,
-                },
+        self.by_rs_name
+            .iter()
+            .chain(
+                self.canonical_names
+                    .iter()
+                    .filter_map(|(alias, canonical)| {
+                        self.by_rs_name
+                            .get(canonical)
+                            .filter(|td| td.is_plain_c())
+                            .map(|td| (alias, td))
+                    }),
             )
-        })
+            .map(|(tn, td)| {
+                (
+                    tn,
+                    match td.behavior {
+                        Behavior::CxxContainerByValueSafe
+                        | Behavior::RustStr
+                        | Behavior::RustString
+                        | Behavior::RustByValue
+                        | Behavior::CByValue
+                        | Behavior::CVariableLengthByValue
+                        | Behavior::CSimdVectorByValue => true,
+                        Behavior::CxxString
+                        | Behavior::CxxContainerNotByValueSafe
+                        | Behavior::CVoid => false,
+                    },
+                )
+            })
     }
 
     /// Whether this TypePath should be treated as a value in C++
@@ -209,11 +258,16 @@ impl TypeDatabase {
     }
 
     /// Get the list of types to give to bindgen to ask it _not_ to
-    /// generate code for.
+    /// generate code for. SIMD vector types are included because bindgen
+    /// would otherwise describe them as (insufficiently aligned) arrays.
     pub(crate) fn get_initial_blocklist(&self) -> impl Iterator<Item = &str> + '_ {
         self.by_rs_name
             .iter()
-            .filter_map(|(_, td)| td.get_prelude_entry().map(|_| td.cpp_name.as_str()))
+            .filter(|(_, td)| {
+                td.get_prelude_entry().is_some()
+                    || matches!(td.behavior, Behavior::CSimdVectorByValue)
+            })
+            .map(|(_, td)| td.cpp_name.as_str())
     }
 
     /// Whether this is one of the ctypes (mostly variable length integers)
@@ -223,12 +277,47 @@ impl TypeDatabase {
             .map(|td| {
                 matches!(
                     td.behavior,
-                    Behavior::CVariableLengthByValue | Behavior::CVoid
+                    Behavior::CVariableLengthByValue
+                        | Behavior::CSimdVectorByValue
+                        | Behavior::CVoid
                 )
             })
             .unwrap_or(false)
     }
 
+    /// The fixed-width Rust primitive which is the very same C++ type
+    /// as this variable-length C integer type (e.g. `i64` for `long` on
+    /// LP64 Linux), for the given clang target triple, or the host if
+    /// that's `None`. Only returns a primitive where the C++ type is
+    /// identical to the corresponding `<cstdint>` typedef, since cxx
+    /// checks function signatures exactly.
+    pub(crate) fn primitive_for_ctype(
+        &self,
+        ty: &QualifiedName,
+        target: Option<&str>,
+    ) -> Option<TypePath> {
+        let cpp_name = self.get(ty)?.cpp_name.as_str();
+        let model = CIntegerModel::for_target(target)?;
+        primitive_for_c_integer(cpp_name, &model).map(|prim| {
+            let prim = make_ident(prim);
+            parse_quote! { #prim }
+        })
+    }
+
+    /// Whether this is a SIMD vector type, which needs the intrinsics
+    /// header in C++ and `core::arch` in Rust.
+    pub(crate) fn is_simd_vector(&self, ty: &QualifiedName) -> bool {
+        self.get(ty)
+            .map(|td| matches!(td.behavior, Behavior::CSimdVectorByValue))
+            .unwrap_or(false)
+    }
+
+    /// The name by which autocxx refers to a known type, which may
+    /// differ from the name bindgen used.
+    pub(crate) fn canonical_name<'a>(&'a self, ty: &'a QualifiedName) -> &'a QualifiedName {
+        self.canonical_names.get(ty).unwrap_or(ty)
+    }
+
     /// Whether this is a generic type acceptable to cxx. Otherwise,
     /// if we encounter a generic, we'll replace it with a synthesized concrete
     /// type.
@@ -248,6 +337,12 @@ impl TypeDatabase {
                                // methods attached.
     }
 
+    /// Whether a value of this type may be created by zeroing its memory,
+    /// with the same result as C++ value-initialization.
+    pub(crate) fn is_zero_initializable(&self, ty: &QualifiedName) -> bool {
+        self.get(ty).map(|x| x.is_plain_c()).unwrap_or(false)
+    }
+
     pub(crate) fn conflicts_with_built_in_type(&self, ty: &QualifiedName) -> bool {
         self.get(ty).is_some()
     }
@@ -274,7 +369,7 @@ impl TypeDatabase {
     }
 }
 
-fn create_type_database() -> TypeDatabase {
+fn create_type_database(simd: bool) -> TypeDatabase {
     let mut db = TypeDatabase::default();
     db.insert(TypeDetails::new(
         "cxx::UniquePtr",
@@ -348,6 +443,12 @@ fn create_type_database() -> TypeDatabase {
         ));
     }
     db.insert(TypeDetails::new("bool", "bool", Behavior::CByValue, None));
+    db.insert(TypeDetails::new(
+        "usize",
+        "size_t",
+        Behavior::CByValue,
+        None,
+    ));
 
     db.insert(TypeDetails::new(
         "std::pin::Pin",
@@ -385,6 +486,19 @@ fn create_type_database() -> TypeDatabase {
         Behavior::CByValue,
         None,
     ));
+    // x86_64 SIMD vector types. These are passed by value using
+    // wrappers in the autocxx crate, since cxx needs an ExternType.
+    if simd {
+        for vector_type in &["m128", "m128d", "m128i", "m256", "m256d", "m256i"] {
+            db.insert(TypeDetails::new(
+                format!("autocxx::{}", vector_type),
+                format!("__{}", vector_type),
+                Behavior::CSimdVectorByValue,
+                Some(format!("core::arch::x86_64::__{}", vector_type)),
+            ));
+        }
+    }
+
     db.insert(TypeDetails::new(
         "autocxx::c_void",
         "void",
@@ -394,6 +508,115 @@ fn create_type_database() -> TypeDatabase {
     db
 }
 
+/// Which C integer types the `<cstdint>` fixed-width typedefs
+/// refer to on a given target.
+#[derive(Debug, PartialEq)]
+struct CIntegerModel {
+    /// Whether `int64_t` is `long` rather than `long long`.
+    int64_is_long: bool,
+}
+
+/// Architectures, by target triple prefix, and whether `long` is 64
+/// bits on each under the usual Unix ABI. Checked in order, so longer
+/// prefixes come first. `short` is 16 bits and `int` 32 bits on all of
+/// them.
+static ARCHITECTURES: &[(&str, bool)] = &[
+    ("x86_64", true),
+    ("amd64", true),
+    ("aarch64", true),
+    ("arm64", true),
+    ("powerpc64", true),
+    ("ppc64", true),
+    ("s390x", true),
+    ("sparcv9", true),
+    ("sparc64", true),
+    ("mips64", true),
+    ("mipsisa64", true),
+    ("riscv64", true),
+    ("loongarch64", true),
+    ("i386", false),
+    ("i486", false),
+    ("i586", false),
+    ("i686", false),
+    ("x86", false),
+    ("arm", false),
+    ("thumb", false),
+    ("powerpc", false),
+    ("ppc", false),
+    ("sparc", false),
+    ("mips", false),
+    ("riscv32", false),
+    ("wasm32", false),
+    ("hexagon", false),
+    ("m68k", false),
+];
+
+impl CIntegerModel {
+    /// Work out the model from a clang or Rust target triple, or else
+    /// for the platform we're running on. Returns `None` for
+    /// architectures we don't know about.
+    fn for_target(target: Option<&str>) -> Option<Self> {
+        let target = match target {
+            Some(target) => target,
+            None => {
+                return Some(CIntegerModel {
+                    int64_is_long: cfg!(target_pointer_width = "64")
+                        && !cfg!(windows)
+                        && !cfg!(target_vendor = "apple")
+                        && !cfg!(target_os = "openbsd"),
+                })
+            }
+        };
+        let mut components = target.split('-');
+        let arch = components.next().unwrap_or_default();
+        let (_, long_is_64) = ARCHITECTURES
+            .iter()
+            .find(|(prefix, _)| arch.starts_with(prefix))?;
+        let components: Vec<_> = components.collect();
+        let has_component = |names: &[&str]| {
+            components
+                .iter()
+                .any(|component| names.iter().any(|name| component.starts_with(name)))
+        };
+        // 64-bit Windows and UEFI are LLP64; ILP32 ABIs on 64-bit
+        // architectures have a 32-bit long; and Apple and OpenBSD
+        // define int64_t as long long even where long is 64 bits.
+        let int64_is_long = *long_is_64
+            && !has_component(&["windows", "uefi", "gnux32", "gnu_ilp32", "ilp32"])
+            && !has_component(&["apple", "darwin", "macos", "ios", "tvos", "watchos"])
+            && !has_component(&["openbsd"]);
+        Some(CIntegerModel { int64_is_long })
+    }
+}
+
+/// The target given to clang by any of these arguments, if one is.
+pub(crate) fn clang_target<'a>(clang_args: &[&'a str]) -> Option<&'a str> {
+    let mut target = None;
+    let mut args = clang_args.iter();
+    while let Some(arg) = args.next() {
+        if let Some(value) = arg.strip_prefix("--target=") {
+            target = Some(value);
+        } else if *arg == "-target" || *arg == "--target" {
+            target = args.next().copied();
+        }
+    }
+    target
+}
+
+fn primitive_for_c_integer(cpp_name: &str, model: &CIntegerModel) -> Option<&'static str> {
+    match cpp_name {
+        "short" => Some("i16"),
+        "unsigned short" => Some("u16"),
+        "int" => Some("i32"),
+        "unsigned int" => Some("u32"),
+        "long" if model.int64_is_long => Some("i64"),
+        "unsigned long" if model.int64_is_long => Some("u64"),
+        "long long" if !model.int64_is_long => Some("i64"),
+        "unsigned long long" if !model.int64_is_long => Some("u64"),
+        _ => None,
+    }
+}
+
 /// If a given type lacks a copy constructor, we should always use
 /// std::move in wrapper functions.
 pub(crate) fn type_lacks_copy_constructor(ty: &Type) -> bool {
@@ -407,9 +630,121 @@ pub(crate) fn type_lacks_copy_constructor(ty: &Type) -> bool {
     }
 }
 
+/// Whether this is a `const char*`, which we can present to Rust as a
+/// [std::ffi::CStr] without any copying.
+pub(crate) fn is_c_string(ty: &Type) -> bool {
+    match ty {
+        Type::Ptr(TypePtr {
+            mutability: None,
+            elem,
+            ..
+        }) => match elem.as_ref() {
+            Type::Path(typ) => known_types()
+                .special_cpp_name(&QualifiedName::from_type_path(typ))
+                .map_or(false, |cpp_name| cpp_name == "char"),
+            _ => false,
+        },
+        _ => false,
+    }
+}
+
 pub(crate) fn ensure_pointee_is_valid(ptr: &TypePtr) -> Result<(), ConvertError> {
     match *ptr.elem {
         Type::Path(..) => Ok(()),
         _ => Err(ConvertError::InvalidPointee),
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::{clang_target, known_types_for, primitive_for_c_integer, CIntegerModel};
+    use crate::types::QualifiedName;
+
+    fn model(target: &str) -> CIntegerModel {
+        CIntegerModel::for_target(Some(target)).unwrap()
+    }
+
+    #[test]
+    fn test_c_integer_models() {
+        let lp64 = model("x86_64-unknown-linux-gnu");
+        assert_eq!(primitive_for_c_integer("long", &lp64), Some("i64"));
+        assert_eq!(primitive_for_c_integer("long long", &lp64), None);
+        assert_eq!(primitive_for_c_integer("int", &lp64), Some("i32"));
+        let windows = model("x86_64-pc-windows-msvc");
+        assert_eq!(primitive_for_c_integer("long", &windows), None);
+        assert_eq!(
+            primitive_for_c_integer("unsigned long long", &windows),
+            Some("u64")
+        );
+        let mac = model("aarch64-apple-darwin");
+        assert_eq!(primitive_for_c_integer("long", &mac), None);
+        assert_eq!(primitive_for_c_integer("long long", &mac), Some("i64"));
+        let arm32 = model("armv7-unknown-linux-gnueabihf");
+        assert_eq!(primitive_for_c_integer("long", &arm32), None);
+        assert_eq!(
+            primitive_for_c_integer("unsigned short", &arm32),
+            Some("u16")
+        );
+        for lp64 in &[
+            "s390x-unknown-linux-gnu",
+            "sparcv9-sun-solaris",
+            "powerpc64le-unknown-linux-gnu",
+            "riscv64gc-unknown-linux-gnu",
+            "mips64el-unknown-linux-gnuabi64",
+            "aarch64-linux-android",
+            "x86_64-unknown-freebsd",
+        ] {
+            assert!(model(lp64).int64_is_long, "{}", lp64);
+        }
+        for llp64 in &[
+            "x86_64-unknown-linux-gnux32",
+            "aarch64-unknown-linux-gnu_ilp32",
+            "arm64-apple-macosx11.0.0",
+            "x86_64-unknown-openbsd",
+            "aarch64-pc-windows-gnullvm",
+            "x86_64-unknown-uefi",
+            "i686-unknown-linux-gnu",
+            "wasm32-unknown-unknown",
+        ] {
+            assert!(!model(llp64).int64_is_long, "{}", llp64);
+        }
+        // Not all targets have a 32-bit int.
+        assert_eq!(
+            CIntegerModel::for_target(Some("avr-unknown-gnu-atmega328")),
+            None
+        );
+        assert_eq!(CIntegerModel::for_target(Some("msp430-none-elf")), None);
+    }
+
+    #[test]
+    fn test_clang_target() {
+        assert_eq!(clang_target(&["-std=c++17"]), None);
+        assert_eq!(
+            clang_target(&["--target=s390x-unknown-linux-gnu"]),
+            Some("s390x-unknown-linux-gnu")
+        );
+        assert_eq!(
+            clang_target(&[
+                "-target",
+                "i686-pc-windows-msvc",
+                "--target=x86_64-apple-darwin"
+            ]),
+            Some("x86_64-apple-darwin")
+        );
+    }
+
+    #[test]
+    fn test_simd_types_per_target() {
+        let m128 = QualifiedName::new_from_cpp_name("__m128");
+        for target in &["x86_64-unknown-linux-gnu", "x86_64-pc-windows-msvc"] {
+            let known_types = known_types_for(Some(target));
+            assert!(known_types.is_simd_vector(&m128));
+            assert!(known_types.get_initial_blocklist().any(|ty| ty == "__m128"));
+        }
+        for target in &["aarch64-unknown-linux-gnu", "armv7-linux-androideabi"] {
+            let known_types = known_types_for(Some(target));
+            assert!(!known_types.is_known_type(&m128));
+            assert!(!known_types.get_initial_blocklist().any(|ty| ty == "__m128"));
+        }
+    }
+}
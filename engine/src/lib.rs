@@ -22,7 +22,9 @@ mod known_types;
 mod parse_callbacks;
 mod parse_file;
 mod rust_pretty_printer;
+mod stl_stubs;
 mod types;
+mod vfs_overlay;
 
 #[cfg(any(test, feature = "build"))]
 mod builder;
@@ -35,6 +37,7 @@ use conversion::BridgeConverter;
 use parse_callbacks::AutocxxParseCallbacks;
 use parse_file::CppBuildable;
 use proc_macro2::TokenStream as TokenStream2;
+use quote::ToTokens;
 use std::{
     collections::hash_map::DefaultHasher,
     fmt::Display,
@@ -47,17 +50,15 @@ use std::{
     path::Path,
     process::{Command, Stdio},
 };
-use tempfile::NamedTempFile;
-
-use quote::ToTokens;
 use syn::Result as ParseResult;
 use syn::{
     parse::{Parse, ParseStream},
     parse_quote, ItemMod, Macro,
 };
+use vfs_overlay::VfsOverlay;
 
 use itertools::{join, Itertools};
-use known_types::known_types;
+use known_types::{known_types, known_types_for};
 use log::info;
 
 /// We use a forked version of bindgen - for now.
@@ -65,8 +66,10 @@ use log::info;
 use autocxx_bindgen as bindgen;
 
 #[cfg(any(test, feature = "build"))]
-pub use builder::{build, expect_build, BuilderBuild, BuilderError, BuilderResult, BuilderSuccess};
-pub use parse_file::{parse_file, ParseError, ParsedFile};
+pub use builder::{
+    build, expect_build, BuilderBuild, BuilderError, BuilderResult, BuilderSuccess, AUTOCXX_PCH,
+};
+pub use parse_file::{parse_file, parse_source, GeneratedArtifacts, ParseError, ParsedFile};
 
 pub use cxx_gen::HEADER;
 
@@ -92,6 +95,17 @@ pub struct CppFilePair {
 /// All generated C++ content which should be written to disk.
 pub struct GeneratedCpp(pub Vec<CppFilePair>);
 
+/// Header contents to be used instead of whatever is on disk at the
+/// given path - for instance, unsaved changes in an editor. clang sees
+/// these through a virtual file system overlay, so the path should be
+/// the one at which `#include` directives would find the header, and
+/// the header is only parsed if something includes it.
+#[derive(Clone, Debug)]
+pub struct HeaderOverlay {
+    pub path: PathBuf,
+    pub contents: String,
+}
+
 /// Errors which may occur in generating bindings for these C++
 /// functions.
 #[derive(Debug)]
@@ -106,6 +120,11 @@ pub enum Error {
     /// Some error occcurred in converting the bindgen-style
     /// bindings to safe cxx bindings.
     Conversion(conversion::ConvertError),
+    /// A file given to `generate_from_file!` or `block_from_file!`
+    /// could not be read.
+    ListFile(std::io::Error),
+    /// The [HeaderOverlay]s could not be written out for clang.
+    Overlay(std::io::Error),
 }
 
 impl Display for Error {
@@ -115,6 +134,8 @@ impl Display for Error {
             Error::Parsing(err) => write!(f, "The Rust file could not be parsede: {}", err)?,
             Error::NoAutoCxxInc => write!(f, "No C++ include directory was provided.")?,
             Error::Conversion(err) => write!(f, "autocxx could not generate the requested bindings. {}", err)?,
+            Error::ListFile(err) => write!(f, "An allowlist or blocklist file could not be read: {}", err)?,
+            Error::Overlay(err) => write!(f, "The in-memory header overlays could not be prepared: {}", err)?,
         }
         Ok(())
     }
@@ -136,6 +157,42 @@ enum State {
 
 const AUTOCXX_CLANG_ARGS: &[&str; 4] = &["-x", "c++", "-std=c++14", "-DBINDGEN"];
 
+/// If this environment variable is set, we'll ask libclang to skip
+/// semantic analysis of the bodies of templated functions while
+/// generating bindings. We only need their signatures, and analyzing
+/// template-heavy inline code can dominate parse time.
+pub static AUTOCXX_FAST_PARSE: &str = "AUTOCXX_FAST_PARSE";
+
+/// The extra clang arguments used when [AUTOCXX_FAST_PARSE] is set.
+/// Delayed template parsing means clang merely records the tokens of
+/// function template bodies (including member functions of class
+/// templates) until they're instantiated, which bindgen never does.
+/// The bodies of non-template inline functions still get full semantic
+/// analysis, so headers with little templated code gain little. clang
+/// can skip all function bodies only when asked through the libclang
+/// API, which bindgen doesn't expose, not by any command-line option.
+pub const FAST_PARSE_CLANG_ARGS: &[&str] = &["-fdelayed-template-parsing"];
+
+/// If this environment variable is set, bindgen will parse your headers
+/// against minimal stub versions of `<string>`, `<vector>`, `<memory>`,
+/// `<map>`, `<set>`, `<unordered_map>`, `<unordered_set>` and `<utility>`
+/// instead of the real standard library headers, which saves parsing
+/// the whole standard library for each `include_cpp!`. The generated
+/// C++ is still compiled against the real headers. Your headers must
+/// need nothing from those headers beyond commonly-used declarations,
+/// and mustn't include other C++ standard library headers, which would
+/// conflict with the stubs. The stubs have the layout of libstdc++ on
+/// 64-bit platforms; the generated C++ checks the size and alignment of
+/// each type against the real headers, so a type containing standard
+/// library types laid out differently fails to compile.
+pub static AUTOCXX_STL_STUBS: &str = "AUTOCXX_STL_STUBS";
+
+/// The name under which to write [ParsedFile::pch_header], whether the
+/// builder precompiles it or `autocxx-gen` leaves that to your build
+/// system. A precompiled header goes alongside it, with a further
+/// suffix per compiler convention.
+pub static PCH_HEADER_NAME: &str = "autocxx_pch.h";
+
 /// Implement to learn of header files which get included
 /// by this build process, such that your build system can choose
 /// to rerun the build process if any such file changes in future.
@@ -284,13 +341,27 @@ impl IncludeCppEngine {
             .clang_args(make_clang_args(inc_dirs, extra_clang_args))
             .derive_copy(false)
             .derive_debug(false)
+            // Any enums requested by newtype_enum! are turned into
+            // newtypes later, during analysis and Rust codegen.
             .default_enum_style(bindgen::EnumVariation::Rust {
                 non_exhaustive: false,
             })
             .enable_cxx_namespaces()
             .generate_inline_functions(true)
-            .layout_tests(false); // TODO revisit later
-        for item in known_types().get_initial_blocklist() {
+            .layout_tests(true); // turned into static assertions in parse_bindgen
+        if std::env::var_os(AUTOCXX_FAST_PARSE).is_some() {
+            builder = builder.clang_args(FAST_PARSE_CLANG_ARGS);
+        }
+        if std::env::var_os(AUTOCXX_STL_STUBS).is_some() {
+            match stl_stubs::stl_stub_clang_args() {
+                Ok(args) => builder = builder.clang_args(args),
+                Err(err) => log::warn!(
+                    "Unable to write stub STL headers, so parsing the real ones: {}",
+                    err
+                ),
+            }
+        }
+        for item in known_types_for(self.config.target_triple()).get_initial_blocklist() {
             builder = builder.blocklist_item(item);
         }
 
@@ -361,6 +432,18 @@ impl IncludeCppEngine {
         inc_dirs: Vec<PathBuf>,
         extra_clang_args: &[&str],
         dep_recorder: Option<Box<dyn RebuildDependencyRecorder>>,
+    ) -> Result<()> {
+        self.generate_with_overlay(inc_dirs, extra_clang_args, dep_recorder, &[])
+    }
+
+    /// As [IncludeCppEngine::generate], but headers in `overlay`
+    /// are read from memory instead of from disk.
+    pub fn generate_with_overlay(
+        &mut self,
+        inc_dirs: Vec<PathBuf>,
+        extra_clang_args: &[&str],
+        dep_recorder: Option<Box<dyn RebuildDependencyRecorder>>,
+        overlay: &[HeaderOverlay],
     ) -> Result<()> {
         // If we are in parse only mode, do nothing. This is used for
         // doc tests to ensure the parsing is valid, but we can't expect
@@ -371,9 +454,25 @@ impl IncludeCppEngine {
             State::Generated(_) => panic!("Only call generate once"),
         }
 
+        self.config.load_list_files().map_err(Error::ListFile)?;
+        // Without a --target, bindgen tells clang the target cargo gives
+        // build scripts, if any.
+        let target = known_types::clang_target(extra_clang_args)
+            .map(str::to_string)
+            .or_else(|| std::env::var("TARGET").ok());
+        self.config.set_target_triple(target);
         let mod_name = self.config.get_mod_name();
+        let vfs_overlay = VfsOverlay::new(overlay).map_err(Error::Overlay)?;
+        let extra_clang_args: Vec<&str> = extra_clang_args
+            .iter()
+            .copied()
+            .chain(vfs_overlay.iter().flat_map(VfsOverlay::clang_args))
+            .collect();
         let mut builder = self.make_bindgen_builder(&inc_dirs, &extra_clang_args);
         if let Some(dep_recorder) = dep_recorder {
+            for f in self.config.list_files() {
+                dep_recorder.record_header_file_dependency(&f.to_string_lossy());
+            }
             builder = builder.parse_callbacks(Box::new(AutocxxParseCallbacks(dep_recorder)));
         }
         let header_contents = self.build_header();
@@ -439,10 +538,13 @@ impl IncludeCppEngine {
                 .join("\n");
             let input = format!("/*\nautocxx config:\n\n{:?}\n\nend autocxx config.\nautocxx preprocessed input:\n*/\n\n{}\n\n/* autocxx: extra headers added below for completeness. */\n\n{}\n{}\n",
                 self.config, header, suffix, cxx_gen::HEADER);
-            let mut tf = NamedTempFile::new().unwrap();
-            write!(tf, "{}", input).unwrap();
-            let tp = tf.into_temp_path();
-            preprocess(&tp, &PathBuf::from(output_path), inc_dirs, extra_clang_args).unwrap();
+            preprocess_contents(
+                &input,
+                &PathBuf::from(output_path),
+                inc_dirs,
+                extra_clang_args,
+            )
+            .unwrap();
         }
     }
 }
@@ -475,12 +577,16 @@ static ALL_KNOWN_SYSTEM_HEADERS: &[&str] = &[
     "sys/types.h",
 ];
 
+/// The name of the header generated by cxx, which declares the Rust
+/// side of the bridge to C++.
+pub(crate) const CXX_GENERATED_HEADER_NAME: &str = "cxxgen.h";
+
 pub fn do_cxx_cpp_generation(rs: TokenStream2) -> Result<CppFilePair, cxx_gen::Error> {
     let opt = cxx_gen::Opt::default();
     let cxx_generated = cxx_gen::generate_header_and_cc(rs, &opt)?;
     Ok(CppFilePair {
         header: cxx_generated.header,
-        header_name: "cxxgen.h".into(),
+        header_name: CXX_GENERATED_HEADER_NAME.into(),
         implementation: Some(cxx_generated.implementation),
     })
 }
@@ -527,13 +633,43 @@ pub fn preprocess(
     incs: &[PathBuf],
     extra_clang_args: &[&str],
 ) -> Result<(), std::io::Error> {
+    let mut cmd = make_preprocess_command(incs, extra_clang_args);
+    cmd.arg(listing_path.to_str().unwrap());
+    let result = cmd.output().expect("failed to execute clang++");
+    write_preprocessed(result, preprocess_path)
+}
+
+/// As [preprocess], but the input is passed in memory rather
+/// than in a file.
+fn preprocess_contents(
+    listing: &str,
+    preprocess_path: &Path,
+    incs: &[PathBuf],
+    extra_clang_args: &[&str],
+) -> Result<(), std::io::Error> {
+    let mut cmd = make_preprocess_command(incs, extra_clang_args);
+    cmd.arg("-");
+    cmd.stdin(Stdio::piped());
+    cmd.stdout(Stdio::piped());
+    let mut child = cmd.spawn().expect("failed to execute clang++");
+    child.stdin.take().unwrap().write_all(listing.as_bytes())?;
+    let result = child.wait_with_output()?;
+    write_preprocessed(result, preprocess_path)
+}
+
+fn make_preprocess_command(incs: &[PathBuf], extra_clang_args: &[&str]) -> Command {
     let mut cmd = Command::new(get_clang_path());
     cmd.arg("-E");
     cmd.arg("-C");
     cmd.args(make_clang_args(incs, extra_clang_args));
-    cmd.arg(listing_path.to_str().unwrap());
     cmd.stderr(Stdio::inherit());
-    let result = cmd.output().expect("failed to execute clang++");
+    cmd
+}
+
+fn write_preprocessed(
+    result: std::process::Output,
+    preprocess_path: &Path,
+) -> Result<(), std::io::Error> {
     if !result.status.success() {
         panic!("failed to preprocess");
     }
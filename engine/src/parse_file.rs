@@ -13,9 +13,10 @@
 // limitations under the License.
 
 use crate::{
-    cxxbridge::CxxBridge, Error as EngineError, GeneratedCpp, IncludeCppEngine,
-    RebuildDependencyRecorder,
+    cxxbridge::CxxBridge, CppFilePair, Error as EngineError, GeneratedCpp, HeaderOverlay,
+    IncludeCppEngine, RebuildDependencyRecorder,
 };
+use itertools::Itertools;
 use proc_macro2::TokenStream;
 use quote::ToTokens;
 use std::{collections::HashSet, fmt::Display, io::Read, path::PathBuf};
@@ -65,8 +66,13 @@ pub fn parse_file<P1: AsRef<Path>>(rs_file: P1) -> Result<ParsedFile, ParseError
     let mut file = std::fs::File::open(rs_file).map_err(ParseError::FileOpen)?;
     file.read_to_string(&mut source)
         .map_err(ParseError::FileRead)?;
+    parse_source(&source)
+}
+
+/// As [parse_file], for Rust source code which is already in memory.
+pub fn parse_source(source: &str) -> Result<ParsedFile, ParseError> {
     proc_macro2::fallback::force();
-    let source = syn::parse_file(&source).map_err(ParseError::Syntax)?;
+    let source = syn::parse_file(source).map_err(ParseError::Syntax)?;
     parse_file_contents(source)
 }
 
@@ -119,6 +125,16 @@ pub trait CppBuildable {
     fn generate_h_and_cxx(&self) -> Result<GeneratedCpp, cxx_gen::Error>;
 }
 
+/// Everything generated for a [ParsedFile], in memory.
+pub struct GeneratedArtifacts {
+    /// The Rust bindings for each `include_cpp!`, along with the
+    /// filename where the procedural macro will look for them.
+    pub rs: Vec<(String, TokenStream)>,
+    /// C++ headers and implementation files, for `include_cpp!`
+    /// and `#[cxx::bridge]` alike.
+    pub cpp: Vec<CppFilePair>,
+}
+
 impl ParsedFile {
     /// Get all the autocxxes in this parsed file.
     pub fn get_rs_buildables(&self) -> impl Iterator<Item = &IncludeCppEngine> {
@@ -144,6 +160,26 @@ impl ParsedFile {
         })
     }
 
+    /// A header including everything which the generated C++ for this
+    /// file commonly includes: the standard library headers used by cxx,
+    /// `cxx.h`, and the headers named in each `include_cpp!`. This is
+    /// suitable for use as a precompiled header.
+    pub fn pch_header(&self) -> String {
+        let system_headers = crate::ALL_KNOWN_SYSTEM_HEADERS
+            .iter()
+            .map(|hdr| format!("#include <{}>\n", hdr));
+        let user_headers = self
+            .get_rs_buildables()
+            .flat_map(|engine| engine.config.inclusions.iter())
+            .unique()
+            .map(|hdr| format!("#include \"{}\"\n", hdr));
+        format!(
+            "#pragma once\n{}#include \"cxx.h\"\n{}",
+            system_headers.format(""),
+            user_headers.format("")
+        )
+    }
+
     pub fn include_dirs(&self) -> impl Iterator<Item = &PathBuf> {
         self.0
             .iter()
@@ -154,11 +190,35 @@ impl ParsedFile {
             .flatten()
     }
 
+    /// Takes the Cargo features enabled for the crate being built, for
+    /// `generate_if!` in every `include_cpp!`, from `features` instead
+    /// of from the environment variables through which Cargo tells
+    /// build scripts. Call before `resolve_all`.
+    pub fn set_cargo_features(&mut self, features: &[&str]) {
+        for include_cpp in self.get_autocxxes_mut() {
+            include_cpp
+                .config
+                .set_cargo_features(features.iter().copied());
+        }
+    }
+
     pub fn resolve_all(
         &mut self,
         autocxx_inc: Vec<PathBuf>,
         extra_clang_args: &[&str],
         dep_recorder: Option<Box<dyn RebuildDependencyRecorder>>,
+    ) -> Result<(), ParseError> {
+        self.resolve_all_with_overlay(autocxx_inc, extra_clang_args, dep_recorder, &[])
+    }
+
+    /// As [ParsedFile::resolve_all], but headers in `overlay` are
+    /// read from memory instead of from disk.
+    pub fn resolve_all_with_overlay(
+        &mut self,
+        autocxx_inc: Vec<PathBuf>,
+        extra_clang_args: &[&str],
+        dep_recorder: Option<Box<dyn RebuildDependencyRecorder>>,
+        overlay: &[HeaderOverlay],
     ) -> Result<(), ParseError> {
         let mut mods_found = HashSet::new();
         let inner_dep_recorder: Option<Rc<dyn RebuildDependencyRecorder>> =
@@ -176,11 +236,25 @@ impl ParsedFile {
                 return Err(ParseError::ConflictingModNames);
             }
             include_cpp
-                .generate(autocxx_inc.clone(), extra_clang_args, dep_recorder)
+                .generate_with_overlay(autocxx_inc.clone(), extra_clang_args, dep_recorder, overlay)
                 .map_err(ParseError::AutocxxCodegenError)?
         }
         Ok(())
     }
+
+    /// Returns all the Rust and C++ code generated for this file,
+    /// without writing anything to disk. Call `resolve_all` first.
+    pub fn generate_artifacts(&self) -> Result<GeneratedArtifacts, cxx_gen::Error> {
+        let mut cpp = Vec::new();
+        for buildable in self.get_cpp_buildables() {
+            cpp.extend(buildable.generate_h_and_cxx()?.0);
+        }
+        let rs = self
+            .get_rs_buildables()
+            .map(|include_cpp| (include_cpp.get_rs_filename(), include_cpp.generate_rs()))
+            .collect();
+        Ok(GeneratedArtifacts { rs, cpp })
+    }
 }
 
 impl ToTokens for ParsedFile {
@@ -0,0 +1,55 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Declarations shared by autocxx's stub standard library headers.
+// These stubs are only ever used when bindgen parses headers with
+// AUTOCXX_STL_STUBS set; generated C++ is always compiled against the
+// real standard library. Declarations are enough to parse typical
+// headers, and data members mirror the layout of libstdc++ on 64-bit
+// platforms, but nothing here has a definition. Other standard libraries
+// may lay things out differently; the generated C++ checks the size and
+// alignment of every type bindgen saw, so any type containing one of
+// these fails to compile there rather than being mis-sized in Rust.
+
+#pragma once
+
+#include <cstddef>
+
+namespace std {
+
+template <typename T> class allocator {};
+template <typename C> struct char_traits {};
+template <typename T = void> struct less {};
+template <typename T = void> struct equal_to {};
+template <typename T> struct hash {};
+template <typename T> struct default_delete {};
+
+template <typename T> T&& move(T& t) noexcept;
+template <typename T> T&& move(T&& t) noexcept;
+template <typename T> T&& forward(T& t) noexcept;
+
+template <typename T1, typename T2> struct pair {
+    typedef T1 first_type;
+    typedef T2 second_type;
+    T1 first;
+    T2 second;
+    pair();
+    pair(const T1& a, const T2& b);
+};
+
+template <typename T1, typename T2> pair<T1, T2> make_pair(T1 a, T2 b);
+
+template <typename T> void swap(T& a, T& b) noexcept;
+
+} // namespace std
@@ -0,0 +1,65 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Minimal stand-ins for common C++ standard library headers, which
+//! bindgen can parse instead of the real ones when
+//! [crate::AUTOCXX_STL_STUBS] is set.
+
+use once_cell::sync::OnceCell;
+use std::{
+    collections::hash_map::DefaultHasher,
+    hash::{Hash, Hasher},
+    path::PathBuf,
+};
+
+const STUB_HEADERS: &[(&str, &str)] = &[
+    ("__autocxx_stl_stub.h", include_str!("__autocxx_stl_stub.h")),
+    ("map", include_str!("map")),
+    ("memory", include_str!("memory")),
+    ("set", include_str!("set")),
+    ("string", include_str!("string")),
+    ("unordered_map", include_str!("unordered_map")),
+    ("unordered_set", include_str!("unordered_set")),
+    ("utility", include_str!("utility")),
+    ("vector", include_str!("vector")),
+];
+
+/// Clang arguments which put the stub headers ahead of the real
+/// standard library headers on the include path. The headers are
+/// written to a temporary directory the first time this is called.
+pub(crate) fn stl_stub_clang_args() -> std::io::Result<Vec<String>> {
+    static STUB_DIR: OnceCell<PathBuf> = OnceCell::new();
+    let dir = STUB_DIR.get_or_try_init(write_stub_headers)?;
+    Ok(vec!["-isystem".into(), dir.to_string_lossy().into_owned()])
+}
+
+fn write_stub_headers() -> std::io::Result<PathBuf> {
+    // Name the directory after the contents, so that different
+    // versions of autocxx never share stubs.
+    let mut hasher = DefaultHasher::new();
+    STUB_HEADERS.hash(&mut hasher);
+    let dir = std::env::temp_dir().join(format!("autocxx-stl-stubs-{:x}", hasher.finish()));
+    std::fs::create_dir_all(&dir)?;
+    for (name, contents) in STUB_HEADERS {
+        let path = dir.join(name);
+        if std::fs::read_to_string(&path).ok().as_deref() != Some(*contents) {
+            // Other builds may be reading these files concurrently, so
+            // replace each one atomically.
+            let temp_path = dir.join(format!("{}.{}.tmp", name, std::process::id()));
+            std::fs::write(&temp_path, contents)?;
+            std::fs::rename(&temp_path, &path)?;
+        }
+    }
+    Ok(dir)
+}
@@ -242,6 +242,26 @@ pub fn validate_ident_ok_for_cxx(id: &str) -> Result<(), ConvertError> {
     }
 }
 
+/// Whether this is a type which bindgen generates purely to describe
+/// the layout of some other type: bitfield storage, or an anonymous
+/// struct or union. These never need to be known to cxx.
+pub(crate) fn is_bindgen_layout_type(id: &str) -> bool {
+    id == "__BindgenBitfieldUnit" || id.contains("__bindgen_ty_")
+}
+
+/// Flattens a path, such as a namespaced C++ name, into something which
+/// can be part of a single identifier. Distinct paths always give distinct
+/// results: each `_` becomes `_u` and segments are joined with `_s`, so
+/// `a::b_c` is `a_sb_uc` whereas `a_b::c` is `a_ub_sc`. Every `_` in the
+/// result is followed by `u` or `s`, so there's never a `__` and callers
+/// can append some other `_`-prefixed suffix unambiguously.
+pub(crate) fn flatten_path<S: AsRef<str>>(segments: impl IntoIterator<Item = S>) -> String {
+    segments
+        .into_iter()
+        .map(|segment| segment.as_ref().replace('_', "_u"))
+        .join("_s")
+}
+
 pub fn validate_ident_ok_for_rust(id: &str) -> Result<(), ConvertError> {
     let id = make_ident(id);
     syn::parse2::<syn::Ident>(id.into_token_stream())
@@ -251,7 +271,15 @@ pub fn validate_ident_ok_for_rust(id: &str) -> Result<(), ConvertError> {
 
 #[cfg(test)]
 mod tests {
-    use super::QualifiedName;
+    use super::{flatten_path, QualifiedName};
+
+    #[test]
+    fn test_flatten_path() {
+        assert_eq!(flatten_path(&["Foo"]), "Foo");
+        assert_eq!(flatten_path(&["a", "b_c"]), "a_sb_uc");
+        assert_eq!(flatten_path(&["a_b", "c"]), "a_ub_sc");
+        assert_eq!(flatten_path(&["a_", "b"]), "a_u_sb");
+    }
 
     #[test]
     fn test_ints() {
@@ -0,0 +1,112 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+use std::path::Path;
+
+use itertools::Itertools;
+use tempfile::TempDir;
+
+use crate::HeaderOverlay;
+
+/// Makes [HeaderOverlay]s visible to clang, whether it's libclang
+/// parsing headers for bindgen or clang preprocessing them. Each is
+/// written to a temporary file, and a clang virtual file system overlay
+/// maps the header's real path to that file. So clang reads the overlay
+/// wherever something `#include`s the header, but otherwise ignores it,
+/// exactly as for a header on disk. (bindgen's own way of passing
+/// in-memory headers makes each one an input to be parsed.)
+pub(crate) struct VfsOverlay {
+    // Holds the files named in clang_args; deleted on drop.
+    _dir: TempDir,
+    clang_args: Vec<String>,
+}
+
+impl VfsOverlay {
+    /// Returns `None` if there's nothing to overlay.
+    pub(crate) fn new(overlay: &[HeaderOverlay]) -> std::io::Result<Option<Self>> {
+        if overlay.is_empty() {
+            return Ok(None);
+        }
+        let dir = tempfile::tempdir()?;
+        let cwd = std::env::current_dir()?;
+        let mut roots = Vec::new();
+        for (i, o) in overlay.iter().enumerate() {
+            let copy = dir.path().join(format!("overlay{}.h", i));
+            std::fs::write(&copy, &o.contents)?;
+            // clang needs absolute paths here.
+            let path = cwd.join(&o.path);
+            let (parent, filename) = match (path.parent(), path.file_name()) {
+                (Some(parent), Some(filename)) => (parent, filename),
+                _ => {
+                    return Err(std::io::Error::new(
+                        std::io::ErrorKind::InvalidInput,
+                        format!("{} isn't a path to a header", o.path.display()),
+                    ))
+                }
+            };
+            // clang merges directories listed more than once.
+            roots.push(format!(
+                "{{ \"type\": \"directory\", \"name\": {}, \"contents\": [ {{ \"type\": \"file\", \"name\": {}, \"external-contents\": {} }} ] }}",
+                quote_path(parent),
+                quote_path(Path::new(filename)),
+                quote_path(&copy)
+            ));
+        }
+        // This is YAML, but any JSON is too.
+        let yaml = format!(
+            "{{ \"version\": 0, \"roots\": [ {} ] }}\n",
+            roots.iter().join(", ")
+        );
+        let yaml_path = dir.path().join("overlay.yaml");
+        std::fs::write(&yaml_path, yaml)?;
+        Ok(Some(VfsOverlay {
+            clang_args: vec![
+                "-ivfsoverlay".into(),
+                yaml_path.to_string_lossy().into_owned(),
+            ],
+            _dir: dir,
+        }))
+    }
+
+    pub(crate) fn clang_args(&self) -> impl Iterator<Item = &str> {
+        self.clang_args.iter().map(String::as_str)
+    }
+}
+
+fn quote_path(path: &Path) -> String {
+    let path = path.to_string_lossy();
+    format!("\"{}\"", path.replace('\\', "\\\\").replace('"', "\\\""))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::VfsOverlay;
+    use crate::HeaderOverlay;
+
+    #[test]
+    fn test_vfs_overlay() {
+        assert!(VfsOverlay::new(&[]).unwrap().is_none());
+        let overlay = VfsOverlay::new(&[HeaderOverlay {
+            path: "/nonexistent/dir \"quoted\"/a.h".into(),
+            contents: "int a();".into(),
+        }])
+        .unwrap()
+        .unwrap();
+        let args: Vec<_> = overlay.clang_args().collect();
+        assert_eq!(args[0], "-ivfsoverlay");
+        let yaml = std::fs::read_to_string(args[1]).unwrap();
+        assert!(yaml.contains(r#""name": "/nonexistent/dir \"quoted\"""#));
+        assert!(yaml.contains(r#""name": "a.h""#));
+    }
+}
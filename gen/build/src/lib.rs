@@ -14,7 +14,7 @@
 
 use autocxx_engine::{
     build as engine_build, expect_build as engine_expect_build, BuilderBuild, BuilderError,
-    RebuildDependencyRecorder,
+    RebuildDependencyRecorder, AUTOCXX_FAST_PARSE, AUTOCXX_PCH, AUTOCXX_STL_STUBS,
 };
 use std::{collections::HashSet, io::Write, sync::Mutex};
 use std::{ffi::OsStr, path::Path};
@@ -23,6 +23,19 @@ use std::{ffi::OsStr, path::Path};
 /// more from a build.rs file.
 /// You need to provide the Rust file path and the iterator of paths
 /// which should be used as include directories.
+///
+/// Set the `AUTOCXX_PCH` environment variable to build the generated
+/// C++ against a precompiled header of the system headers, `cxx.h` and
+/// your inclusions. That header is built with the flags of the returned
+/// `cc::Build`, in the C++ dialect given by any `-std=` option in
+/// `extra_clang_args`. Flags you add afterwards which change the dialect
+/// or predefined macros stop the compiler using it: gcc then falls back
+/// to the plain header, but clang reports an error.
+///
+/// Set the `AUTOCXX_FAST_PARSE` environment variable to skip analysis
+/// of templated function bodies while generating bindings, or
+/// `AUTOCXX_STL_STUBS` to parse your headers against stub versions of
+/// common standard library headers. See the `autocxx_engine` docs.
 pub fn build<P1, I, T>(
     rs_file: P1,
     autocxx_incs: I,
@@ -34,6 +47,9 @@ where
     T: AsRef<OsStr>,
 {
     setup_logging();
+    println!("cargo:rerun-if-env-changed={}", AUTOCXX_PCH);
+    println!("cargo:rerun-if-env-changed={}", AUTOCXX_FAST_PARSE);
+    println!("cargo:rerun-if-env-changed={}", AUTOCXX_STL_STUBS);
     engine_build(
         rs_file,
         autocxx_incs,
@@ -56,6 +72,9 @@ where
     T: AsRef<OsStr>,
 {
     setup_logging();
+    println!("cargo:rerun-if-env-changed={}", AUTOCXX_PCH);
+    println!("cargo:rerun-if-env-changed={}", AUTOCXX_FAST_PARSE);
+    println!("cargo:rerun-if-env-changed={}", AUTOCXX_STL_STUBS);
     engine_expect_build(
         rs_file,
         autocxx_incs,
@@ -32,7 +32,7 @@ where
     F: FnOnce(&mut Command),
 {
     let demo_code_dir = tmp_dir.path().join("demo");
-    std::fs::create_dir(&demo_code_dir).unwrap();
+    std::fs::create_dir_all(&demo_code_dir).unwrap();
     write_to_file(&demo_code_dir, "input.h", INPUT_H.as_bytes());
     write_to_file(&demo_code_dir, "main.rs", MAIN_RS.as_bytes());
     let demo_rs = demo_code_dir.join("main.rs");
@@ -88,6 +88,74 @@ fn test_gen_preprocess() -> Result<(), Box<dyn std::error::Error>> {
     Ok(())
 }
 
+#[test]
+fn test_gen_pch() -> Result<(), Box<dyn std::error::Error>> {
+    let tmp_dir = TempDir::new("example")?;
+    base_test(&tmp_dir, |cmd| {
+        cmd.arg("--gen-pch");
+    })?;
+    let pch = std::fs::read_to_string(tmp_dir.path().join("autocxx_pch.h"))?;
+    assert!(pch.contains("#include \"cxx.h\""));
+    assert!(pch.contains("#include \"input.h\""));
+    let gen0 = std::fs::read_to_string(tmp_dir.path().join("gen0.cc"))?;
+    assert!(gen0.starts_with("#include \"autocxx_pch.h\""));
+    Ok(())
+}
+
+#[test]
+fn test_gen_manifest() -> Result<(), Box<dyn std::error::Error>> {
+    let tmp_dir = TempDir::new("example")?;
+    let manifest_path = tmp_dir.path().join("manifest.json");
+    let add_args = |cmd: &mut Command| {
+        cmd.arg("--generate-exact")
+            .arg("2")
+            .arg("--manifest")
+            .arg(&manifest_path);
+    };
+    base_test(&tmp_dir, add_args)?;
+    let manifest = std::fs::read_to_string(&manifest_path)?;
+    assert!(manifest
+        .contains("{\"path\": \"gen0.cc\", \"role\": \"implementation\", \"hash\": \"fnv1a64:"));
+    assert!(manifest.contains("\"changed\": true, \"placeholder\": false}"));
+    assert!(manifest.contains("\"path\": \"gen1.cc\""));
+    assert!(manifest.contains("\"changed\": true, \"placeholder\": true}"));
+    assert!(manifest.contains("\"role\": \"header\""));
+    assert!(manifest.contains("\"role\": \"rust-include\""));
+    // Nothing changes the second time around.
+    base_test(&tmp_dir, add_args)?;
+    let second_manifest = std::fs::read_to_string(&manifest_path)?;
+    assert!(!second_manifest.contains("\"changed\": true"));
+    assert_eq!(
+        manifest.replace("\"changed\": true", "\"changed\": false"),
+        second_manifest
+    );
+    Ok(())
+}
+
+#[test]
+#[cfg(all(target_os = "linux", target_arch = "x86_64"))]
+fn test_gen_multi_target() -> Result<(), Box<dyn std::error::Error>> {
+    let tmp_dir = TempDir::new("example")?;
+    // Two spellings of the same target, so everything should be shared.
+    base_test(&tmp_dir, |cmd| {
+        cmd.arg("--target")
+            .arg("x86_64-unknown-linux-gnu")
+            .arg("--target")
+            .arg("x86_64-pc-linux-gnu");
+    })?;
+    // The C++ is shared, but each target has its own complete set of
+    // Rust files, for AUTOCXX_RS to point at.
+    assert_contentful(&tmp_dir, "gen0.cc");
+    for target in &["x86_64-unknown-linux-gnu", "x86_64-pc-linux-gnu"] {
+        let target_files: Vec<String> = std::fs::read_dir(tmp_dir.path().join(target))?
+            .map(|entry| entry.unwrap().file_name().to_string_lossy().into_owned())
+            .collect();
+        assert!(!target_files.is_empty());
+        assert!(target_files.iter().all(|f| f.ends_with(".rs")));
+    }
+    Ok(())
+}
+
 fn write_to_file(dir: &Path, filename: &str, content: &[u8]) {
     let path = dir.join(filename);
     let mut f = File::create(&path).expect("Unable to create file");
@@ -15,13 +15,15 @@
 #[cfg(test)]
 mod cmd_test;
 
-use autocxx_engine::parse_file;
-use clap::{crate_authors, crate_version, App, Arg, ArgGroup};
+use autocxx_engine::{parse_file, PCH_HEADER_NAME};
+use clap::{crate_authors, crate_version, App, Arg, ArgGroup, ArgMatches};
 use indoc::indoc;
 use proc_macro2::TokenStream;
 use quote::ToTokens;
+use std::collections::{BTreeMap, HashSet};
 use std::io::{Read, Write};
 use std::path::PathBuf;
+use std::sync::Arc;
 use std::{fs::File, path::Path};
 
 pub(crate) static BLANK: &str = "// Blank autocxx placeholder";
@@ -70,6 +72,29 @@ a) Have exactly one include_cpp directive in each source .rs file
 b) Set AUTOCXX_RS_FILE when using autocxx_macro.
 c) Teach your build system always that the outputs of this tool
    are always guaranteed to be gen0.include.rs, gen0.cc and gen1.cc.
+
+To learn exactly which files were produced, pass --manifest out.json.
+This writes a JSON file listing each file (relative to the output
+directory), its role (header, implementation, rust-include or
+rust-complete), an FNV-1a 64-bit hash of its contents, whether this run
+changed it on disk, and whether it's a blank placeholder from
+--generate-exact. For example:
+{
+  \"files\": [
+    {\"path\": \"gen0.cc\", \"role\": \"implementation\", \"hash\": \"fnv1a64:...\", \"changed\": true, \"placeholder\": false}
+  ]
+}
+
+If you build for several targets, pass each with --target. Each target
+is still generated in full, headers and all, just as if you'd run
+autocxx-gen once per target; the only savings are that targets are
+generated in parallel and that identical C++ files are written once.
+Rust files are always written to a
+subdirectory named after each target, so when building for a given
+target, point AUTOCXX_RS (or AUTOCXX_RS_FILE) into that subdirectory.
+C++ files which are the same for every target are written to the output
+directory itself, and the rest to the target's subdirectory: add both
+directories to your C++ include path, and build the C++ files from both.
 "};
 
 fn main() {
@@ -139,6 +164,12 @@ fn main() {
                 .help("Perform C++ codegen also for #[cxx::bridge] blocks. Only applies for --gen-cpp")
                 .requires("gen-cpp")
         )
+        .arg(
+            Arg::with_name("gen-pch")
+                .long("gen-pch")
+                .help("Write autocxx_pch.h, containing the headers common to all generated C++, and include it first from each generated C++ file, so that your build system can precompile it. Only applies for --gen-cpp")
+                .requires("gen-cpp")
+        )
         .arg(
             Arg::with_name("generate-exact")
                 .long("generate-exact")
@@ -152,6 +183,22 @@ fn main() {
                 .help("Make the name of the .rs file predictable. You must set AUTOCXX_RS_FILE during Rust build time to educate autocxx_macro about your choice.")
                 .requires("gen-rs-include")
         )
+        .arg(
+            Arg::with_name("target")
+                .long("target")
+                .multiple(true)
+                .number_of_values(1)
+                .value_name("TRIPLE")
+                .help("generate for this target triple rather than the host. May be repeated, in which case each target is generated in full, in parallel, Rust files are written to a subdirectory named after each target, and C++ files are written there only if they differ between targets")
+                .takes_value(true),
+        )
+        .arg(
+            Arg::with_name("manifest")
+                .long("manifest")
+                .value_name("PATH")
+                .help("write a JSON file listing every file produced, its role, its content hash and whether it changed")
+                .takes_value(true),
+        )
         .arg(
             Arg::with_name("clang-args")
                 .last(true)
@@ -161,6 +208,87 @@ fn main() {
         .get_matches();
 
     env_logger::builder().init();
+    let outdir: PathBuf = matches.value_of_os("outdir").unwrap().into();
+    let targets: Option<Vec<String>> = matches
+        .values_of("target")
+        .map(|targets| targets.map(String::from).collect());
+    let matches = Arc::new(matches);
+    let manifest: Vec<ManifestEntry> = match targets {
+        None => generate(&matches, None)
+            .into_iter()
+            .map(|(fname, output)| write_output(&outdir, None, fname, &output))
+            .collect(),
+        Some(targets) => write_multi_target(&outdir, generate_for_targets(&matches, targets)),
+    };
+    if let Some(manifest_path) = matches.value_of_os("manifest") {
+        write_manifest(Path::new(manifest_path), &manifest);
+    }
+}
+
+/// What a generated file is for.
+#[derive(Clone, Copy, PartialEq, Debug)]
+enum Role {
+    Header,
+    Implementation,
+    RustInclude,
+    RustComplete,
+}
+
+impl Role {
+    fn as_str(&self) -> &'static str {
+        match self {
+            Role::Header => "header",
+            Role::Implementation => "implementation",
+            Role::RustInclude => "rust-include",
+            Role::RustComplete => "rust-complete",
+        }
+    }
+}
+
+/// A file to be written.
+#[derive(PartialEq, Debug)]
+struct Output {
+    role: Role,
+    content: Vec<u8>,
+    /// Whether this is a blank file written only so that the build
+    /// system finds the number of files it expects.
+    placeholder: bool,
+}
+
+impl Output {
+    fn new(role: Role, content: Vec<u8>) -> Self {
+        Output {
+            role,
+            content,
+            placeholder: false,
+        }
+    }
+
+    fn placeholder(role: Role) -> Self {
+        Output {
+            role,
+            content: BLANK.as_bytes().to_vec(),
+            placeholder: true,
+        }
+    }
+}
+
+/// Files to be written, keyed by name.
+type Outputs = BTreeMap<String, Output>;
+
+/// One file which we produced, for `--manifest`.
+struct ManifestEntry {
+    /// Relative to the output directory.
+    path: String,
+    role: Role,
+    hash: u64,
+    changed: bool,
+    placeholder: bool,
+}
+
+/// Runs the code generation requested on the command line, optionally
+/// for a specific target triple rather than the host.
+fn generate(matches: &ArgMatches, target: Option<&str>) -> Outputs {
     let mut parsed_file = parse_file(matches.value_of("INPUT").unwrap())
         .expect("Unable to parse Rust file and interpret autocxx macro");
     let incs = matches
@@ -168,9 +296,11 @@ fn main() {
         .unwrap_or_default()
         .map(PathBuf::from)
         .collect();
-    let extra_clang_args: Vec<_> = matches
-        .values_of("clang-args")
-        .unwrap_or_default()
+    let target_arg = target.map(|target| format!("--target={}", target));
+    let extra_clang_args: Vec<_> = target_arg
+        .iter()
+        .map(String::as_str)
+        .chain(matches.values_of("clang-args").unwrap_or_default())
         .collect();
     // In future, we should provide an option to write a .d file here
     // by passing a callback into the dep_recorder parameter here.
@@ -178,35 +308,50 @@ fn main() {
     parsed_file
         .resolve_all(incs, &extra_clang_args, None)
         .expect("Unable to resolve macro");
-    let outdir: PathBuf = matches.value_of_os("outdir").unwrap().into();
     let desired_number = matches
         .value_of("generate-exact")
         .map(|s| s.parse::<usize>().unwrap());
+    let mut outputs = Outputs::new();
     if matches.is_present("gen-cpp") {
         let cpp = matches.value_of("cpp-extension").unwrap();
+        let pch_include = if matches.is_present("gen-pch") {
+            outputs.insert(
+                PCH_HEADER_NAME.to_string(),
+                Output::new(Role::Header, parsed_file.pch_header().into_bytes()),
+            );
+            format!("#include \"{}\"\n", PCH_HEADER_NAME)
+        } else {
+            String::new()
+        };
         let mut counter = 0usize;
         for include_cxx in parsed_file.get_cpp_buildables() {
             let generations = include_cxx
                 .generate_h_and_cxx()
                 .expect("Unable to generate header and C++ code");
             for pair in generations.0 {
-                write_to_file(&outdir, pair.header_name, &pair.header);
+                outputs.insert(pair.header_name, Output::new(Role::Header, pair.header));
                 if let Some(implementation) = &pair.implementation {
                     let cppname = format!("gen{}.{}", counter, cpp);
-                    write_to_file(&outdir, cppname, implementation);
+                    let implementation = [pch_include.as_bytes(), implementation].concat();
+                    outputs.insert(cppname, Output::new(Role::Implementation, implementation));
                     counter += 1;
                 }
             }
         }
-        write_placeholders(&outdir, counter, desired_number, cpp);
+        add_placeholders(
+            &mut outputs,
+            counter,
+            desired_number,
+            cpp,
+            Role::Implementation,
+        );
     }
     if matches.is_present("gen-rs-complete") {
         let mut ts = TokenStream::new();
         parsed_file.to_tokens(&mut ts);
-        write_to_file(
-            &outdir,
+        outputs.insert(
             "gen.complete.rs".to_string(),
-            ts.to_string().as_bytes(),
+            Output::new(Role::RustComplete, ts.to_string().into_bytes()),
         );
     }
     if matches.is_present("gen-rs-include") {
@@ -219,18 +364,95 @@ fn main() {
             } else {
                 include_cxx.get_rs_filename()
             };
-            write_to_file(&outdir, fname, ts.to_string().as_bytes());
+            outputs.insert(
+                fname,
+                Output::new(Role::RustInclude, ts.to_string().into_bytes()),
+            );
             counter += 1;
         }
-        write_placeholders(&outdir, counter, desired_number, "include.rs");
+        add_placeholders(
+            &mut outputs,
+            counter,
+            desired_number,
+            "include.rs",
+            Role::RustInclude,
+        );
     }
+    outputs
 }
 
-fn write_placeholders(
-    outdir: &Path,
+/// Runs the code generation for each target on its own thread.
+/// Nearly all the work, notably parsing the C++ headers with libclang,
+/// depends on the target, so there's little to share between targets
+/// other than the machine's cores. (The parsed Rust input can't be
+/// shared either: its token streams aren't `Send`.)
+fn generate_for_targets(
+    matches: &Arc<ArgMatches<'static>>,
+    targets: Vec<String>,
+) -> Vec<(String, Outputs)> {
+    let threads: Vec<_> = targets
+        .into_iter()
+        .map(|target| {
+            let matches = Arc::clone(matches);
+            std::thread::spawn(move || {
+                let outputs = generate(&matches, Some(target.as_str()));
+                (target, outputs)
+            })
+        })
+        .collect();
+    threads
+        .into_iter()
+        .map(|thread| {
+            thread
+                .join()
+                .unwrap_or_else(|panic| std::panic::resume_unwind(panic))
+        })
+        .collect()
+}
+
+/// Writes each C++ file which came out identically for every target
+/// into `outdir` itself, and the rest into a subdirectory per target.
+/// Rust files always go into the subdirectory, so that each target's
+/// are all in one place for AUTOCXX_RS or AUTOCXX_RS_FILE.
+fn write_multi_target(outdir: &Path, per_target: Vec<(String, Outputs)>) -> Vec<ManifestEntry> {
+    let (_, first_outputs) = &per_target[0];
+    let shared: HashSet<&String> = first_outputs
+        .iter()
+        .filter(|(_, content)| matches!(content.role, Role::Header | Role::Implementation))
+        .filter(|(fname, content)| {
+            per_target[1..]
+                .iter()
+                .all(|(_, outputs)| outputs.get(*fname) == Some(content))
+        })
+        .map(|(fname, _)| fname)
+        .collect();
+    let mut manifest: Vec<_> = shared
+        .iter()
+        .map(|fname| write_output(outdir, None, fname.to_string(), &first_outputs[*fname]))
+        .collect();
+    for (target, outputs) in &per_target {
+        std::fs::create_dir_all(outdir.join(target)).expect("Unable to create directory");
+        for (fname, output) in outputs {
+            if !shared.contains(fname) {
+                manifest.push(write_output(
+                    outdir,
+                    Some(target.as_str()),
+                    fname.clone(),
+                    output,
+                ));
+            }
+        }
+    }
+    manifest.sort_by(|a, b| a.path.cmp(&b.path));
+    manifest
+}
+
+fn add_placeholders(
+    outputs: &mut Outputs,
     mut counter: usize,
     desired_number: Option<usize>,
     extension: &str,
+    role: Role,
 ) {
     if let Some(desired_number) = desired_number {
         if counter > desired_number {
@@ -238,13 +460,36 @@ fn write_placeholders(
         }
         while counter < desired_number {
             let fname = format!("gen{}.{}", counter, extension);
-            write_to_file(&outdir, fname, BLANK.as_bytes());
+            outputs.insert(fname, Output::placeholder(role));
             counter += 1;
         }
     }
 }
 
-fn write_to_file(dir: &Path, filename: String, content: &[u8]) {
+/// Writes an output into `outdir`, or into its subdirectory for the
+/// given target, and describes what we did for the manifest.
+fn write_output(
+    outdir: &Path,
+    target: Option<&str>,
+    filename: String,
+    output: &Output,
+) -> ManifestEntry {
+    let (dir, path) = match target {
+        None => (outdir.to_path_buf(), filename.clone()),
+        Some(target) => (outdir.join(target), format!("{}/{}", target, filename)),
+    };
+    ManifestEntry {
+        path,
+        role: output.role,
+        hash: fnv1a64(&output.content),
+        changed: write_to_file(&dir, filename, &output.content),
+        placeholder: output.placeholder,
+    }
+}
+
+/// Returns whether the file was written, as opposed to already
+/// having the right content.
+fn write_to_file(dir: &Path, filename: String, content: &[u8]) -> bool {
     let path = dir.join(filename);
     {
         let f = File::open(&path);
@@ -252,10 +497,51 @@ fn write_to_file(dir: &Path, filename: String, content: &[u8]) {
             let mut existing_content = Vec::new();
             let r = f.read_to_end(&mut existing_content);
             if r.is_ok() && existing_content == content {
-                return; // don't change timestamp on existing file unnecessarily
+                return false; // don't change timestamp on existing file unnecessarily
             }
         }
     }
     let mut f = File::create(&path).expect("Unable to create file");
     f.write_all(content).expect("Unable to write file");
+    true
+}
+
+/// A content hash which is stable across platforms and Rust versions,
+/// unlike `DefaultHasher`, so is suitable for build system cache keys.
+fn fnv1a64(content: &[u8]) -> u64 {
+    content.iter().fold(0xcbf2_9ce4_8422_2325, |hash, byte| {
+        (hash ^ u64::from(*byte)).wrapping_mul(0x0100_0000_01b3)
+    })
+}
+
+fn write_manifest(path: &Path, entries: &[ManifestEntry]) {
+    let files: Vec<_> = entries
+        .iter()
+        .map(|entry| {
+            format!(
+                "    {{\"path\": {}, \"role\": \"{}\", \"hash\": \"fnv1a64:{:016x}\", \"changed\": {}, \"placeholder\": {}}}",
+                json_string(&entry.path),
+                entry.role.as_str(),
+                entry.hash,
+                entry.changed,
+                entry.placeholder
+            )
+        })
+        .collect();
+    let json = format!("{{\n  \"files\": [\n{}\n  ]\n}}\n", files.join(",\n"));
+    std::fs::write(path, json).expect("Unable to write manifest");
+}
+
+fn json_string(s: &str) -> String {
+    let mut quoted = String::from("\"");
+    for c in s.chars() {
+        match c {
+            '"' => quoted.push_str("\\\""),
+            '\\' => quoted.push_str("\\\\"),
+            c if (c as u32) < 0x20 => quoted.push_str(&format!("\\u{:04x}", c as u32)),
+            c => quoted.push(c),
+        }
+    }
+    quoted.push('"');
+    quoted
 }
@@ -13,6 +13,11 @@
 // limitations under the License.
 
 use proc_macro2::Span;
+use std::{
+    collections::{hash_map::DefaultHasher, HashSet},
+    hash::{Hash, Hasher},
+    path::PathBuf,
+};
 use syn::{
     parse::{Parse, ParseStream},
     LitStr, Token,
@@ -50,6 +55,63 @@ impl Parse for UnsafePolicy {
     }
 }
 
+/// A Rust trait which we can implement for a C++ type by calling
+/// the equivalent C++ operators.
+#[derive(PartialEq, Eq, PartialOrd, Ord, Clone, Copy, Debug, Hash)]
+pub enum CppTrait {
+    /// `PartialEq` and `Eq`, using `operator==`.
+    Eq,
+    /// `PartialOrd` and `Ord`, using `operator<`.
+    Ord,
+    /// `Hash`, using `std::hash`.
+    Hash,
+}
+
+impl Parse for CppTrait {
+    fn parse(input: ParseStream) -> ParseResult<Self> {
+        let id: syn::Ident = input.parse()?;
+        if id == "Eq" {
+            Ok(CppTrait::Eq)
+        } else if id == "Ord" {
+            Ok(CppTrait::Ord)
+        } else if id == "Hash" {
+            Ok(CppTrait::Hash)
+        } else {
+            Err(syn::Error::new(id.span(), "expected Eq, Ord or Hash"))
+        }
+    }
+}
+
+/// The path to a Rust type named in a directive, as it would be written
+/// in the module which contains the `include_cpp!`.
+#[derive(PartialEq, Eq, Clone, Debug, Hash)]
+pub struct RustPath {
+    leading_colon: bool,
+    segments: Vec<Ident>,
+}
+
+impl RustPath {
+    /// Whether the path starts with `::`, i.e. names an external crate.
+    pub fn has_leading_colon(&self) -> bool {
+        self.leading_colon
+    }
+
+    pub fn segments(&self) -> &[Ident] {
+        &self.segments
+    }
+}
+
+impl Parse for RustPath {
+    fn parse(input: ParseStream) -> ParseResult<Self> {
+        // Generic types can't be named in an extern "Rust" block.
+        let path = syn::Path::parse_mod_style(input)?;
+        Ok(RustPath {
+            leading_colon: path.leading_colon.is_some(),
+            segments: path.segments.into_iter().map(|s| s.ident).collect(),
+        })
+    }
+}
+
 /// Allowlist configuration.
 #[derive(Hash, Debug)]
 pub enum Allowlist {
@@ -75,6 +137,30 @@ impl Allowlist {
         Ok(())
     }
 
+    /// Other directives name items to be generated, which are merged
+    /// into the allowlist later. Unlike [Self::push] this is fine
+    /// alongside `generate_all!`, which generates them anyway.
+    pub(crate) fn expect_additions(&mut self) {
+        if let Allowlist::Unspecified = self {
+            *self = Allowlist::Specific(Vec::new());
+        }
+    }
+
+    /// Items will be specified by some other means, e.g. a file.
+    pub(crate) fn set_specific(&mut self, item: &LitStr) -> ParseResult<()> {
+        match self {
+            Allowlist::Unspecified => *self = Allowlist::Specific(Vec::new()),
+            Allowlist::All => {
+                return Err(syn::Error::new(
+                    item.span(),
+                    "use either generate_from_file!/generate_if! or generate_all!, not both.",
+                ))
+            }
+            Allowlist::Specific(_) => {}
+        };
+        Ok(())
+    }
+
     pub(crate) fn set_all(&mut self, ident: &Ident) -> ParseResult<()> {
         if matches!(self, Allowlist::Specific(..)) {
             return Err(syn::Error::new(
@@ -93,6 +179,266 @@ impl Default for Allowlist {
     }
 }
 
+/// A file listing C++ items, one per line, as given to
+/// `generate_from_file!` or `block_from_file!`. Relative paths are
+/// relative to the crate's manifest directory.
+///
+/// Only the path and a digest of the contents form part of the
+/// configuration's hash, so that the procedural macro needn't
+/// tokenize or store the items. They're read and indexed only when
+/// generating bindings, by [IncludeCppConfig::load_list_files].
+#[derive(Hash, Debug)]
+struct ListFile {
+    path: String,
+    digest: u64,
+}
+
+impl ListFile {
+    fn new(lit: &LitStr) -> ParseResult<Self> {
+        let path = lit.value();
+        let contents = std::fs::read(Self::resolve(&path)).map_err(|e| {
+            syn::Error::new(
+                lit.span(),
+                format!("unable to read list file {}: {}", path, e),
+            )
+        })?;
+        let mut hasher = DefaultHasher::new();
+        contents.hash(&mut hasher);
+        Ok(Self {
+            path,
+            digest: hasher.finish(),
+        })
+    }
+
+    fn resolve(path: &str) -> PathBuf {
+        match std::env::var_os("CARGO_MANIFEST_DIR") {
+            Some(dir) => PathBuf::from(dir).join(path),
+            None => PathBuf::from(path),
+        }
+    }
+
+    fn full_path(&self) -> PathBuf {
+        Self::resolve(&self.path)
+    }
+
+    /// Reads a profile, which is either a JSON object mapping function
+    /// names to weights, or lines each consisting of a function name
+    /// optionally followed by whitespace and a weight (default 1).
+    /// Blank lines and lines starting with '#' are ignored.
+    fn read_weights(&self) -> std::io::Result<Vec<(String, f64)>> {
+        let contents = std::fs::read_to_string(self.full_path())?;
+        if contents.trim_start().starts_with('{') {
+            return parse_json_weights(&contents).ok_or_else(|| {
+                std::io::Error::new(
+                    std::io::ErrorKind::InvalidData,
+                    format!(
+                        "{} is not a JSON object of function names to weights",
+                        self.path
+                    ),
+                )
+            });
+        }
+        Ok(contents
+            .lines()
+            .map(str::trim)
+            .filter(|l| !l.is_empty() && !l.starts_with('#'))
+            .map(
+                |l| match l.rsplitn(2, char::is_whitespace).collect::<Vec<_>>()[..] {
+                    [weight, name] if weight.parse::<f64>().is_ok() => {
+                        (name.trim().to_string(), weight.parse().unwrap())
+                    }
+                    _ => (l.to_string(), 1.0),
+                },
+            )
+            .collect())
+    }
+
+    /// Blank lines and lines starting with '#' are ignored.
+    fn read_items(&self) -> std::io::Result<Vec<String>> {
+        Ok(std::fs::read_to_string(self.full_path())?
+            .lines()
+            .map(str::trim)
+            .filter(|l| !l.is_empty() && !l.starts_with('#'))
+            .map(str::to_string)
+            .collect())
+    }
+}
+
+/// Parses a flat JSON object whose values are all numbers.
+fn parse_json_weights(json: &str) -> Option<Vec<(String, f64)>> {
+    let mut chars = json.trim().chars().peekable();
+    let mut weights = Vec::new();
+    let skip_whitespace = |chars: &mut std::iter::Peekable<std::str::Chars>| {
+        while chars.peek().map_or(false, |c| c.is_whitespace()) {
+            chars.next();
+        }
+    };
+    if chars.next()? != '{' {
+        return None;
+    }
+    skip_whitespace(&mut chars);
+    if chars.peek() == Some(&'}') {
+        return Some(weights);
+    }
+    loop {
+        skip_whitespace(&mut chars);
+        if chars.next()? != '"' {
+            return None;
+        }
+        let mut name = String::new();
+        loop {
+            match chars.next()? {
+                '"' => break,
+                '\\' => name.push(parse_json_escape(&mut chars)?),
+                c => name.push(c),
+            }
+        }
+        skip_whitespace(&mut chars);
+        if chars.next()? != ':' {
+            return None;
+        }
+        skip_whitespace(&mut chars);
+        let mut weight = String::new();
+        while chars
+            .peek()
+            .map_or(false, |c| c.is_ascii_digit() || "+-.eE".contains(*c))
+        {
+            weight.push(chars.next().unwrap());
+        }
+        weights.push((name, weight.parse().ok()?));
+        skip_whitespace(&mut chars);
+        match chars.next()? {
+            ',' => {}
+            '}' => return Some(weights),
+            _ => return None,
+        }
+    }
+}
+
+/// Parses the rest of a JSON string escape sequence, after the
+/// backslash.
+fn parse_json_escape(chars: &mut std::iter::Peekable<std::str::Chars>) -> Option<char> {
+    let c = match chars.next()? {
+        '"' => '"',
+        '\\' => '\\',
+        '/' => '/',
+        'b' => '\u{8}',
+        'f' => '\u{c}',
+        'n' => '\n',
+        'r' => '\r',
+        't' => '\t',
+        'u' => {
+            let unit = parse_json_hex4(chars)?;
+            let code_point = if (0xd800..0xdc00).contains(&unit) {
+                // A high surrogate, which must be followed by a low one.
+                if chars.next()? != '\\' || chars.next()? != 'u' {
+                    return None;
+                }
+                let low = parse_json_hex4(chars)?;
+                if !(0xdc00..0xe000).contains(&low) {
+                    return None;
+                }
+                0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00)
+            } else {
+                unit
+            };
+            return std::char::from_u32(code_point);
+        }
+        _ => return None,
+    };
+    Some(c)
+}
+
+fn parse_json_hex4(chars: &mut std::iter::Peekable<std::str::Chars>) -> Option<u32> {
+    let digits: String = chars.take(4).collect();
+    if digits.len() == 4 {
+        u32::from_str_radix(&digits, 16).ok()
+    } else {
+        None
+    }
+}
+
+/// The functions which between them account for this fraction of the
+/// total weight in a profile are considered hot.
+const HOT_WEIGHT_FRACTION: f64 = 0.9;
+
+/// How often a C++ function is called, according to any profiles
+/// given to `profile_from_file!`.
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum Hotness {
+    /// Among the functions accounting for most of the weight.
+    Hot,
+    /// Not mentioned in any profile.
+    Unknown,
+    /// In a profile, but not hot.
+    Cold,
+}
+
+/// How a function's `const char*` parameters and return value appear
+/// in Rust, per `c_strings!`.
+#[derive(PartialEq, Eq, Clone, Copy, Debug, Hash)]
+pub enum CStringPolicy {
+    /// Raw pointers, like any other pointer.
+    RawPointers,
+    /// `&CStr`. Nothing is known about a returned string, so any
+    /// function returning one is `unsafe`.
+    CStr,
+    /// `&CStr`, and the user promises that returned strings are
+    /// NUL-terminated and live as long as the object they came from.
+    CStrNulTerminated,
+}
+
+/// Items loaded from [ListFile]s, along with those from any
+/// `generate_if!` directives whose Cargo feature is enabled.
+#[derive(Default, Debug)]
+struct ListFileItems {
+    allowlist: Vec<String>,
+    blocklist: HashSet<String>,
+    hot: HashSet<String>,
+    cold: HashSet<String>,
+}
+
+/// These are covered by the digests of the [ListFile]s, and by the
+/// `generate_if!` directives themselves, so needn't contribute to the
+/// hash again. In particular, the set of enabled Cargo features mustn't
+/// affect the hash, because the procedural macro (which doesn't know
+/// about features) has to find the same output file as the build script.
+impl Hash for ListFileItems {
+    fn hash<H: Hasher>(&self, _state: &mut H) {}
+}
+
+/// Every item on the allowlist, from directives and list files alike,
+/// so that [IncludeCppConfig::is_on_allowlist] needn't scan them all.
+/// It's derived from other fields, so needn't contribute to the hash.
+#[derive(Default, Debug)]
+struct AllowlistIndex(HashSet<String>);
+
+impl Hash for AllowlistIndex {
+    fn hash<H: Hasher>(&self, _state: &mut H) {}
+}
+
+/// The clang target triple for which the headers are parsed, if
+/// known. This is set by whatever drives bindgen, not by a directive,
+/// and the procedural macro (which doesn't know the target) has to
+/// find the same output file as the build script, so it mustn't affect
+/// the hash.
+#[derive(Default, Debug)]
+struct TargetTriple(Option<String>);
+
+impl Hash for TargetTriple {
+    fn hash<H: Hasher>(&self, _state: &mut H) {}
+}
+
+/// The Cargo features enabled for the crate being built, if given
+/// explicitly rather than read from the environment. Like
+/// [ListFileItems], these mustn't affect the hash.
+#[derive(Default, Debug)]
+struct CargoFeatures(Option<HashSet<String>>);
+
+impl Hash for CargoFeatures {
+    fn hash<H: Hasher>(&self, _state: &mut H) {}
+}
+
 #[derive(Hash, Debug)]
 pub struct IncludeCppConfig {
     pub inclusions: Vec<String>,
@@ -100,12 +446,60 @@ pub struct IncludeCppConfig {
     pub parse_only: bool,
     pub exclude_impls: bool,
     pod_requests: Vec<String>,
+    relocatable_requests: Vec<String>,
+    rust_constructible_requests: Vec<String>,
+    newtype_enum_requests: Vec<String>,
+    make_vector_requests: Vec<String>,
+    smart_pointers: Vec<String>,
+    c_string_requests: Vec<(String, CStringPolicy)>,
     allowlist: Allowlist,
     blocklist: Vec<String>,
+    allowlist_files: Vec<ListFile>,
+    blocklist_files: Vec<ListFile>,
+    profile_files: Vec<ListFile>,
+    /// Pairs of Cargo feature and item, per `generate_if!`.
+    feature_gated_allowlist: Vec<(String, String)>,
+    list_file_items: ListFileItems,
+    allowlist_index: AllowlistIndex,
+    trait_requests: Vec<(String, Vec<CppTrait>)>,
+    subclasses: Vec<(String, RustPath)>,
     exclude_utilities: bool,
+    primitive_ctypes: bool,
+    newtype_enums: bool,
     mod_name: Option<Ident>,
+    target_triple: TargetTriple,
+    cargo_features: CargoFeatures,
 }
 
+/// Every directive allowed within `include_cpp!` (besides `#include`),
+/// each of which must be handled in [IncludeCppConfig::parse].
+const DIRECTIVES: &[&str] = &[
+    "generate",
+    "generate_if",
+    "generate_pod",
+    "pod",
+    "relocatable",
+    "c_strings",
+    "rust_constructible",
+    "newtype_enum",
+    "make_vector",
+    "smart_ptr",
+    "block",
+    "generate_from_file",
+    "block_from_file",
+    "profile_from_file",
+    "impl_traits",
+    "subclass",
+    "parse_only",
+    "exclude_impls",
+    "generate_all",
+    "name",
+    "exclude_utilities",
+    "primitive_ctypes",
+    "newtype_enums",
+    "safety",
+];
+
 impl Parse for IncludeCppConfig {
     fn parse(input: ParseStream) -> ParseResult<Self> {
         // Takes as inputs:
@@ -119,8 +513,22 @@ impl Parse for IncludeCppConfig {
         let mut unsafe_policy = UnsafePolicy::AllFunctionsUnsafe;
         let mut allowlist = Allowlist::Unspecified;
         let mut blocklist = Vec::new();
+        let mut allowlist_files = Vec::new();
+        let mut blocklist_files = Vec::new();
+        let mut profile_files = Vec::new();
+        let mut feature_gated_allowlist = Vec::new();
+        let mut trait_requests = Vec::new();
+        let mut subclasses: Vec<(String, RustPath)> = Vec::new();
         let mut pod_requests = Vec::new();
+        let mut relocatable_requests = Vec::new();
+        let mut rust_constructible_requests = Vec::new();
+        let mut newtype_enum_requests = Vec::new();
+        let mut make_vector_requests = Vec::new();
+        let mut smart_pointers = Vec::new();
+        let mut c_string_requests = Vec::new();
         let mut exclude_utilities = false;
+        let mut primitive_ctypes = false;
+        let mut newtype_enums = false;
         let mut mod_name = None;
 
         while !input.is_empty() {
@@ -133,12 +541,26 @@ impl Parse for IncludeCppConfig {
                 let hdr: syn::LitStr = input.parse()?;
                 inclusions.push(hdr.value());
             } else {
+                if !DIRECTIVES.iter().any(|directive| ident == directive) {
+                    return Err(syn::Error::new(
+                        ident.span(),
+                        format!("expected one of {}", DIRECTIVES.join(", ")),
+                    ));
+                }
                 input.parse::<Option<syn::Token![!]>>()?;
                 if ident == "generate" {
                     let args;
                     syn::parenthesized!(args in input);
                     let generate: syn::LitStr = args.parse()?;
                     allowlist.push(generate)?;
+                } else if ident == "generate_if" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let feature: syn::LitStr = args.parse()?;
+                    args.parse::<syn::Token![,]>()?;
+                    let generate: syn::LitStr = args.parse()?;
+                    allowlist.set_specific(&generate)?;
+                    feature_gated_allowlist.push((feature.value(), generate.value()));
                 } else if ident == "generate_pod" {
                     let args;
                     syn::parenthesized!(args in input);
@@ -150,11 +572,104 @@ impl Parse for IncludeCppConfig {
                     syn::parenthesized!(args in input);
                     let pod: syn::LitStr = args.parse()?;
                     pod_requests.push(pod.value());
+                } else if ident == "relocatable" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let relocatable: syn::LitStr = args.parse()?;
+                    relocatable_requests.push(relocatable.value());
+                } else if ident == "c_strings" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let function: syn::LitStr = args.parse()?;
+                    let policy = if args.parse::<Option<syn::Token![,]>>()?.is_some() {
+                        let assertion: syn::Ident = args.parse()?;
+                        if assertion != "nul_terminated" {
+                            return Err(syn::Error::new(
+                                assertion.span(),
+                                "expected nul_terminated",
+                            ));
+                        }
+                        CStringPolicy::CStrNulTerminated
+                    } else {
+                        CStringPolicy::CStr
+                    };
+                    c_string_requests.push((function.value(), policy));
+                } else if ident == "rust_constructible" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let constructible: syn::LitStr = args.parse()?;
+                    pod_requests.push(constructible.value());
+                    rust_constructible_requests.push(constructible.value());
+                    allowlist.push(constructible)?;
+                } else if ident == "newtype_enum" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let newtype_enum: syn::LitStr = args.parse()?;
+                    newtype_enum_requests.push(newtype_enum.value());
+                } else if ident == "make_vector" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let make_vector: syn::LitStr = args.parse()?;
+                    make_vector_requests.push(make_vector.value());
+                } else if ident == "smart_ptr" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let smart_ptr: syn::LitStr = args.parse()?;
+                    smart_pointers.push(smart_ptr.value());
                 } else if ident == "block" {
                     let args;
                     syn::parenthesized!(args in input);
                     let generate: syn::LitStr = args.parse()?;
                     blocklist.push(generate.value());
+                } else if ident == "generate_from_file" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let path: syn::LitStr = args.parse()?;
+                    allowlist.set_specific(&path)?;
+                    allowlist_files.push(ListFile::new(&path)?);
+                } else if ident == "block_from_file" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let path: syn::LitStr = args.parse()?;
+                    blocklist_files.push(ListFile::new(&path)?);
+                } else if ident == "profile_from_file" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let path: syn::LitStr = args.parse()?;
+                    profile_files.push(ListFile::new(&path)?);
+                } else if ident == "impl_traits" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let ty: syn::LitStr = args.parse()?;
+                    args.parse::<syn::Token![,]>()?;
+                    let traits =
+                        syn::punctuated::Punctuated::<CppTrait, syn::Token![,]>::parse_terminated(
+                            &args,
+                        )?;
+                    let mut traits: Vec<_> = traits.into_iter().collect();
+                    // Rust requires Eq for any Ord type.
+                    if traits.contains(&CppTrait::Ord) {
+                        traits.push(CppTrait::Eq);
+                    }
+                    traits.sort();
+                    traits.dedup();
+                    trait_requests.push((ty.value(), traits));
+                } else if ident == "subclass" {
+                    let args;
+                    syn::parenthesized!(args in input);
+                    let superclass: syn::LitStr = args.parse()?;
+                    args.parse::<syn::Token![,]>()?;
+                    let rust_type: RustPath = args.parse()?;
+                    if subclasses
+                        .iter()
+                        .any(|(_, existing)| *existing == rust_type)
+                    {
+                        return Err(syn::Error::new(
+                            superclass.span(),
+                            "each Rust type may be used in only one subclass! directive",
+                        ));
+                    }
+                    subclasses.push((superclass.value(), rust_type));
                 } else if ident == "parse_only" {
                     parse_only = true;
                     swallow_parentheses(&input, &ident)?;
@@ -172,33 +687,59 @@ impl Parse for IncludeCppConfig {
                 } else if ident == "exclude_utilities" {
                     exclude_utilities = true;
                     swallow_parentheses(&input, &ident)?;
+                } else if ident == "primitive_ctypes" {
+                    primitive_ctypes = true;
+                    swallow_parentheses(&input, &ident)?;
+                } else if ident == "newtype_enums" {
+                    newtype_enums = true;
+                    swallow_parentheses(&input, &ident)?;
                 } else if ident == "safety" {
                     let args;
                     syn::parenthesized!(args in input);
                     unsafe_policy = args.parse()?;
                 } else {
-                    return Err(syn::Error::new(
-                        ident.span(),
-                        "expected generate, generate_pod, nested_type, safety or exclude_utilities",
-                    ));
+                    unreachable!("directive {} not handled", ident);
                 }
             }
             if input.is_empty() {
                 break;
             }
         }
+        if !relocatable_requests.is_empty() || !subclasses.is_empty() {
+            allowlist.expect_additions();
+        }
 
-        Ok(IncludeCppConfig {
+        let mut config = IncludeCppConfig {
             inclusions,
             unsafe_policy,
             parse_only,
             exclude_impls,
             pod_requests,
+            relocatable_requests,
+            rust_constructible_requests,
+            newtype_enum_requests,
+            make_vector_requests,
+            smart_pointers,
+            c_string_requests,
             allowlist,
             blocklist,
+            allowlist_files,
+            blocklist_files,
+            profile_files,
+            feature_gated_allowlist,
+            list_file_items: ListFileItems::default(),
+            allowlist_index: AllowlistIndex::default(),
+            trait_requests,
+            subclasses,
             exclude_utilities,
+            primitive_ctypes,
+            newtype_enums,
             mod_name,
-        })
+            target_triple: TargetTriple::default(),
+            cargo_features: CargoFeatures::default(),
+        };
+        config.index_allowlist();
+        Ok(config)
     }
 }
 
@@ -216,8 +757,56 @@ fn swallow_parentheses(input: &ParseStream, latest_ident: &Ident) -> ParseResult
 }
 
 impl IncludeCppConfig {
-    pub fn get_pod_requests(&self) -> &[String] {
-        &self.pod_requests
+    /// Types to be held by value in Rust. Relocatable types are held
+    /// by value, so they're subject to all the same checks.
+    pub fn get_pod_requests(&self) -> impl Iterator<Item = &String> {
+        self.pod_requests
+            .iter()
+            .chain(self.relocatable_requests.iter())
+    }
+
+    /// Whether the user has asked for this type to be held by value
+    /// in Rust despite having a destructor or move constructor, per
+    /// `relocatable!`.
+    pub fn is_relocatable_requested(&self, cpp_name: &str) -> bool {
+        self.relocatable_requests.iter().any(|ty| ty == cpp_name)
+    }
+
+    /// How the C++ function (e.g. `ns::Type::method`) should take and
+    /// return `const char*`, per `c_strings!`.
+    pub fn c_string_policy(&self, cpp_name: &str) -> CStringPolicy {
+        self.c_string_requests
+            .iter()
+            .find(|(function, _)| function == cpp_name)
+            .map_or(CStringPolicy::RawPointers, |(_, policy)| *policy)
+    }
+
+    /// Whether the user has promised, per `rust_constructible!`, that
+    /// this type may be constructed field-by-field or zero-initialized
+    /// in Rust without bypassing any C++ constructor.
+    pub fn is_rust_constructible_requested(&self, cpp_name: &str) -> bool {
+        self.rust_constructible_requests
+            .iter()
+            .any(|ty| ty == cpp_name)
+    }
+
+    /// Whether this enum should be represented in Rust as a newtype
+    /// around its underlying integer, rather than as a Rust enum, per
+    /// `newtype_enum!` or `newtype_enums!`.
+    pub fn is_newtype_enum(&self, cpp_name: &str) -> bool {
+        self.newtype_enums || self.newtype_enum_requests.iter().any(|ty| ty == cpp_name)
+    }
+
+    /// Whether this type should get a `make_vector` function, per
+    /// `make_vector!`.
+    pub fn is_make_vector_requested(&self, cpp_name: &str) -> bool {
+        self.make_vector_requests.iter().any(|ty| ty == cpp_name)
+    }
+
+    /// Whether this C++ class template is a smart pointer, per
+    /// `smart_ptr!`.
+    pub fn is_smart_pointer(&self, cpp_name: &str) -> bool {
+        self.smart_pointers.iter().any(|ty| ty == cpp_name)
     }
 
     pub fn get_mod_name(&self) -> Ident {
@@ -233,13 +822,60 @@ impl IncludeCppConfig {
         self.exclude_utilities
     }
 
+    /// Whether to represent variable-length C integer types such as
+    /// `long` as Rust primitives wherever the target fixes their size,
+    /// per `primitive_ctypes!`.
+    pub fn primitive_ctypes(&self) -> bool {
+        self.primitive_ctypes
+    }
+
+    /// The clang target triple for which the headers are parsed, or
+    /// `None` for the host.
+    pub fn target_triple(&self) -> Option<&str> {
+        self.target_triple.0.as_deref()
+    }
+
+    pub fn set_target_triple(&mut self, target_triple: Option<String>) {
+        self.target_triple = TargetTriple(target_triple);
+    }
+
+    /// Takes the Cargo features enabled for the crate being built, for
+    /// `generate_if!`, from `features` instead of from the environment
+    /// variables through which Cargo tells build scripts. Call before
+    /// [IncludeCppConfig::load_list_files].
+    pub fn set_cargo_features<I, S>(&mut self, features: I)
+    where
+        I: IntoIterator<Item = S>,
+        S: Into<String>,
+    {
+        self.cargo_features = CargoFeatures(Some(features.into_iter().map(Into::into).collect()));
+    }
+
+    /// Whether the crate being built has the given Cargo feature enabled.
+    fn is_cargo_feature_enabled(&self, feature: &str) -> bool {
+        match &self.cargo_features.0 {
+            Some(features) => features.contains(feature),
+            None => {
+                let var = format!("CARGO_FEATURE_{}", feature.to_uppercase().replace('-', "_"));
+                std::env::var_os(var).is_some()
+            }
+        }
+    }
+
     /// Items which the user has explicitly asked us to generate;
     /// we should raise an error if we weren't able to do so.
     pub fn must_generate_list(&self) -> Box<dyn Iterator<Item = String> + '_> {
         if let Allowlist::Specific(items) = &self.allowlist {
-            Box::new(items.iter().chain(self.pod_requests.iter()).cloned())
+            Box::new(
+                items
+                    .iter()
+                    .chain(self.list_file_items.allowlist.iter())
+                    .chain(self.get_pod_requests())
+                    .chain(self.superclasses())
+                    .cloned(),
+            )
         } else {
-            Box::new(self.pod_requests.iter().cloned())
+            Box::new(self.get_pod_requests().cloned())
         }
     }
 
@@ -250,7 +886,9 @@ impl IncludeCppConfig {
             Allowlist::Specific(items) => Some(Box::new(
                 items
                     .iter()
-                    .chain(self.pod_requests.iter())
+                    .chain(self.list_file_items.allowlist.iter())
+                    .chain(self.get_pod_requests())
+                    .chain(self.superclasses())
                     .cloned()
                     .chain(self.active_utilities()),
             )),
@@ -275,21 +913,130 @@ impl IncludeCppConfig {
     /// This second pass may seem redundant. But sometimes bindgen generates
     /// unnecessary stuff.
     pub fn is_on_allowlist(&self, cpp_name: &str) -> bool {
-        match self.bindgen_allowlist() {
-            None => true,
-            Some(mut items) => {
-                items.any(|item| item == cpp_name)
-                    || self.active_utilities().iter().any(|item| *item == cpp_name)
-            }
+        match self.allowlist {
+            Allowlist::All => true,
+            Allowlist::Specific(_) => self.allowlist_index.0.contains(cpp_name),
+            Allowlist::Unspecified => unreachable!(),
         }
     }
 
+    /// Rebuilds the index used by [Self::is_on_allowlist] from
+    /// everything [Self::bindgen_allowlist] would report.
+    fn index_allowlist(&mut self) {
+        let index = match self.allowlist {
+            Allowlist::Specific(_) => self.bindgen_allowlist().into_iter().flatten().collect(),
+            _ => HashSet::new(),
+        };
+        self.allowlist_index = AllowlistIndex(index);
+    }
+
     pub fn is_on_blocklist(&self, cpp_name: &str) -> bool {
-        self.blocklist.contains(&cpp_name.to_string())
+        self.blocklist.iter().any(|item| item == cpp_name)
+            || self.list_file_items.blocklist.contains(cpp_name)
     }
 
     pub fn get_blocklist(&self) -> impl Iterator<Item = &String> {
-        self.blocklist.iter()
+        self.blocklist
+            .iter()
+            .chain(self.list_file_items.blocklist.iter())
+    }
+
+    /// Reads and indexes the files given to `generate_from_file!`,
+    /// `block_from_file!` and `profile_from_file!`, and works out which
+    /// `generate_if!` items are enabled by the Cargo features of the crate
+    /// being built. Until this is called, none of these items are taken
+    /// into account.
+    pub fn load_list_files(&mut self) -> std::io::Result<()> {
+        let mut items = ListFileItems::default();
+        let mut seen = HashSet::new();
+        for f in &self.allowlist_files {
+            for item in f.read_items()? {
+                if seen.insert(item.clone()) {
+                    items.allowlist.push(item);
+                }
+            }
+        }
+        for (feature, item) in &self.feature_gated_allowlist {
+            if self.is_cargo_feature_enabled(feature) && seen.insert(item.clone()) {
+                items.allowlist.push(item.clone());
+            }
+        }
+        for f in &self.blocklist_files {
+            items.blocklist.extend(f.read_items()?);
+        }
+        let mut weights: Vec<(String, f64)> = Vec::new();
+        for f in &self.profile_files {
+            weights.extend(f.read_weights()?);
+        }
+        weights.sort_by(|(_, a), (_, b)| b.partial_cmp(a).unwrap_or(std::cmp::Ordering::Equal));
+        let total: f64 = weights.iter().map(|(_, weight)| weight.max(0.0)).sum();
+        let mut cumulative = 0.0;
+        for (name, weight) in weights {
+            if weight > 0.0 && cumulative < total * HOT_WEIGHT_FRACTION {
+                cumulative += weight;
+                items.hot.insert(name);
+            } else if !items.hot.contains(&name) {
+                items.cold.insert(name);
+            }
+        }
+        self.list_file_items = items;
+        self.index_allowlist();
+        Ok(())
+    }
+
+    /// All files given to `generate_from_file!`, `block_from_file!` or
+    /// `profile_from_file!`, so that callers can track them as
+    /// dependencies.
+    pub fn list_files(&self) -> impl Iterator<Item = PathBuf> + '_ {
+        self.allowlist_files
+            .iter()
+            .chain(self.blocklist_files.iter())
+            .chain(self.profile_files.iter())
+            .map(ListFile::full_path)
+    }
+
+    /// How hot the given C++ function (e.g. `ns::Type::method`) is,
+    /// according to the files given to `profile_from_file!`.
+    pub fn hotness(&self, cpp_name: &str) -> Hotness {
+        if self.list_file_items.hot.contains(cpp_name) {
+            Hotness::Hot
+        } else if self.list_file_items.cold.contains(cpp_name) {
+            Hotness::Cold
+        } else {
+            Hotness::Unknown
+        }
+    }
+
+    /// Types for which the user has asked us to implement Rust traits
+    /// in terms of C++ operators, and the traits in question.
+    pub fn get_trait_requests(&self) -> impl Iterator<Item = (&str, &[CppTrait])> {
+        self.trait_requests
+            .iter()
+            .map(|(ty, traits)| (ty.as_str(), traits.as_slice()))
+    }
+
+    /// Rust traits which the user has asked us to implement for the
+    /// given C++ type.
+    pub fn get_traits_for(&self, cpp_name: &str) -> &[CppTrait] {
+        self.trait_requests
+            .iter()
+            .find(|(ty, _)| ty == cpp_name)
+            .map(|(_, traits)| traits.as_slice())
+            .unwrap_or_default()
+    }
+
+    /// C++ abstract classes which the user has asked us to subclass,
+    /// each with the Rust type which implements their pure virtual
+    /// methods.
+    pub fn get_subclasses(&self) -> impl Iterator<Item = (&str, &RustPath)> {
+        self.subclasses
+            .iter()
+            .map(|(superclass, rust_type)| (superclass.as_str(), rust_type))
+    }
+
+    /// Superclasses named in `subclass!`, which need bindings themselves.
+    fn superclasses(&self) -> impl Iterator<Item = &String> {
+        self.subclasses.iter().map(|(superclass, _)| superclass)
     }
 
     pub fn get_makestring_name(&self) -> String {
@@ -305,7 +1052,10 @@ impl IncludeCppConfig {
 
 #[cfg(test)]
 mod parse_tests {
-    use crate::config::UnsafePolicy;
+    use crate::config::{
+        parse_json_weights, CStringPolicy, CppTrait, Hotness, IncludeCppConfig, UnsafePolicy,
+        DIRECTIVES,
+    };
     use syn::parse_quote;
     #[test]
     fn test_safety_unsafe() {
@@ -328,4 +1078,296 @@ mod parse_tests {
         let us: UnsafePolicy = parse_quote! {};
         assert_eq!(us, UnsafePolicy::AllFunctionsUnsafe)
     }
+
+    #[test]
+    fn test_directives() {
+        // Whether or not each directive is happy without arguments, it
+        // mustn't be unexpected.
+        for directive in DIRECTIVES {
+            let directive = syn::Ident::new(directive, proc_macro2::Span::call_site());
+            if let Err(err) = syn::parse2::<IncludeCppConfig>(quote::quote! { #directive!() }) {
+                assert!(!err.to_string().starts_with("expected one of"));
+            }
+        }
+        let err = syn::parse2::<IncludeCppConfig>(quote::quote! { nested_type!("A") })
+            .err()
+            .unwrap();
+        assert!(err.to_string().contains("generate_from_file"));
+    }
+
+    #[test]
+    fn test_impl_traits() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            impl_traits!("A", Hash, Ord)
+        };
+        let requests: Vec<_> = config.get_trait_requests().collect();
+        assert_eq!(
+            requests,
+            vec![("A", &[CppTrait::Eq, CppTrait::Ord, CppTrait::Hash][..])]
+        )
+    }
+
+    #[test]
+    fn test_subclass() {
+        let config: IncludeCppConfig = parse_quote! {
+            subclass!("Observer", MyObserver)
+        };
+        let subclasses: Vec<_> = config
+            .get_subclasses()
+            .map(|(superclass, rust_type)| {
+                let segments: Vec<_> = rust_type.segments().iter().map(|s| s.to_string()).collect();
+                (superclass, rust_type.has_leading_colon(), segments)
+            })
+            .collect();
+        assert_eq!(
+            subclasses,
+            vec![("Observer", false, vec!["MyObserver".to_string()])]
+        );
+        assert!(config.is_on_allowlist("Observer"));
+        let all: IncludeCppConfig = parse_quote! {
+            subclass!("Observer", MyObserver)
+            generate_all!()
+        };
+        assert!(all.bindgen_allowlist().is_none());
+        assert_eq!(all.get_subclasses().count(), 1);
+        let config: IncludeCppConfig = parse_quote! {
+            subclass!("Observer", crate::observers::MyObserver)
+        };
+        let (_, rust_type) = config.get_subclasses().next().unwrap();
+        assert!(!rust_type.has_leading_colon());
+        assert_eq!(rust_type.segments().len(), 3);
+        let generic: syn::Result<IncludeCppConfig> = syn::parse2(quote::quote! {
+            subclass!("Observer", MyObserver<u32>)
+        });
+        assert!(generic.is_err());
+        let duplicate: syn::Result<IncludeCppConfig> = syn::parse2(quote::quote! {
+            subclass!("Observer", MyObserver)
+            subclass!("Listener", MyObserver)
+        });
+        assert!(duplicate.is_err());
+    }
+
+    #[test]
+    fn test_relocatable() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate_pod!("A")
+            relocatable!("ns::B")
+        };
+        assert!(config.is_relocatable_requested("ns::B"));
+        assert!(!config.is_relocatable_requested("A"));
+        assert!(config.is_on_allowlist("ns::B"));
+        assert_eq!(
+            config.get_pod_requests().collect::<Vec<_>>(),
+            ["A", "ns::B"]
+        );
+        let all: IncludeCppConfig = parse_quote! {
+            relocatable!("ns::B")
+            generate_all!()
+        };
+        assert!(all.is_relocatable_requested("ns::B"));
+        assert!(all.bindgen_allowlist().is_none());
+        assert_eq!(all.get_pod_requests().collect::<Vec<_>>(), ["ns::B"]);
+        let alone: IncludeCppConfig = parse_quote! {
+            relocatable!("B")
+        };
+        assert!(alone.is_on_allowlist("B"));
+    }
+
+    #[test]
+    fn test_c_strings() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("log")
+            c_strings!("log")
+            c_strings!("Logger::get_name", nul_terminated)
+        };
+        assert_eq!(config.c_string_policy("log"), CStringPolicy::CStr);
+        assert_eq!(
+            config.c_string_policy("Logger::get_name"),
+            CStringPolicy::CStrNulTerminated
+        );
+        assert_eq!(
+            config.c_string_policy("Logger::log"),
+            CStringPolicy::RawPointers
+        );
+        let bad: syn::Result<IncludeCppConfig> = syn::parse2(quote::quote! {
+            c_strings!("log", trust_me)
+        });
+        assert!(bad.is_err());
+    }
+
+    #[test]
+    fn test_rust_constructible() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate_pod!("A")
+            rust_constructible!("B")
+        };
+        assert!(config.is_rust_constructible_requested("B"));
+        assert!(!config.is_rust_constructible_requested("A"));
+        assert!(config.is_on_allowlist("B"));
+        assert_eq!(config.get_pod_requests().collect::<Vec<_>>(), ["A", "B"]);
+    }
+
+    #[test]
+    fn test_primitive_ctypes() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            primitive_ctypes!()
+        };
+        assert!(config.primitive_ctypes());
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+        };
+        assert!(!config.primitive_ctypes());
+    }
+
+    #[test]
+    fn test_newtype_enums() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            newtype_enum!("ns::B")
+        };
+        assert!(config.is_newtype_enum("ns::B"));
+        assert!(!config.is_newtype_enum("A"));
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            newtype_enums!()
+        };
+        assert!(config.is_newtype_enum("A"));
+    }
+
+    #[test]
+    fn test_make_vector() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate_all!()
+            make_vector!("A")
+        };
+        assert!(config.is_make_vector_requested("A"));
+        assert!(!config.is_make_vector_requested("B"));
+    }
+
+    #[test]
+    fn test_smart_ptr() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            smart_ptr!("base::scoped_refptr")
+        };
+        assert!(config.is_smart_pointer("base::scoped_refptr"));
+        assert!(!config.is_smart_pointer("A"));
+    }
+
+    #[test]
+    fn test_generate_if() {
+        let mut config: IncludeCppConfig = parse_quote! {
+            generate_if!("autocxx-test-on", "net::Socket")
+            generate_if!("autocxx-test-off", "gpu::Device")
+        };
+        config.set_cargo_features(vec!["autocxx-test-on"]);
+        assert!(!config.is_on_allowlist("net::Socket"));
+        config.load_list_files().unwrap();
+        assert!(config.is_on_allowlist("net::Socket"));
+        assert!(!config.is_on_allowlist("gpu::Device"));
+        assert!(config.must_generate_list().any(|i| i == "net::Socket"));
+        assert!(!config.must_generate_list().any(|i| i == "gpu::Device"));
+        let all: syn::Result<IncludeCppConfig> = syn::parse2(quote::quote! {
+            generate_all!()
+            generate_if!("autocxx-test-on", "net::Socket")
+        });
+        assert!(all.is_err());
+    }
+
+    #[test]
+    fn test_list_files() {
+        let dir = std::env::temp_dir();
+        let allow = dir.join(format!("autocxx_allow_{}", std::process::id()));
+        let block = dir.join(format!("autocxx_block_{}", std::process::id()));
+        std::fs::write(&allow, "# Comment\nA\n\n  B  \n").unwrap();
+        std::fs::write(&block, "C\n").unwrap();
+        let allow_path = allow.to_str().unwrap();
+        let block_path = block.to_str().unwrap();
+        let mut config: IncludeCppConfig = parse_quote! {
+            generate!("D")
+            generate_from_file!(#allow_path)
+            block_from_file!(#block_path)
+        };
+        assert!(!config.is_on_allowlist("A"));
+        config.load_list_files().unwrap();
+        std::fs::remove_file(&allow).unwrap();
+        std::fs::remove_file(&block).unwrap();
+        assert!(config.is_on_allowlist("A"));
+        assert!(config.is_on_allowlist("B"));
+        assert!(config.is_on_allowlist("D"));
+        assert!(!config.is_on_allowlist("# Comment"));
+        assert!(config.is_on_blocklist("C"));
+        assert_eq!(
+            config.must_generate_list().collect::<Vec<_>>(),
+            vec!["D", "A", "B"]
+        );
+    }
+
+    #[test]
+    fn test_json_weights() {
+        assert_eq!(
+            parse_json_weights(r#"{ "a\"b": 1, "c\\d": 2, "\u0065\ud83d\ude00\n": 3 }"#),
+            Some(vec![
+                ("a\"b".to_string(), 1.0),
+                ("c\\d".to_string(), 2.0),
+                ("e\u{1f600}\n".to_string(), 3.0)
+            ])
+        );
+        assert_eq!(parse_json_weights("{}"), Some(Vec::new()));
+        assert_eq!(parse_json_weights(r#"{ "\q": 1 }"#), None);
+        assert_eq!(parse_json_weights(r#"{ "\ud83d": 1 }"#), None);
+        assert_eq!(parse_json_weights(r#"{ "\u12": 1 }"#), None);
+    }
+
+    #[test]
+    fn test_allowlist_index() {
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            pod!("B")
+        };
+        assert!(config.is_on_allowlist("A"));
+        assert!(config.is_on_allowlist("B"));
+        assert!(config.is_on_allowlist(&config.get_makestring_name()));
+        assert!(!config.is_on_allowlist("C"));
+        let config: IncludeCppConfig = parse_quote! {
+            generate!("A")
+            exclude_utilities!()
+        };
+        assert!(!config.is_on_allowlist(&config.get_makestring_name()));
+    }
+
+    #[test]
+    fn test_profile() {
+        let dir = std::env::temp_dir();
+        let text = dir.join(format!("autocxx_profile_{}.txt", std::process::id()));
+        let json = dir.join(format!("autocxx_profile_{}.json", std::process::id()));
+        std::fs::write(
+            &text,
+            "# Samples\nns::hot 800\nns::Type::warm\t150\nns::cold 50\n",
+        )
+        .unwrap();
+        std::fs::write(&json, "{ \"a\": 10, \"b\": 1e0 }").unwrap();
+        let text_path = text.to_str().unwrap();
+        let json_path = json.to_str().unwrap();
+        let mut text_config: IncludeCppConfig = parse_quote! {
+            generate_all!()
+            profile_from_file!(#text_path)
+        };
+        let mut json_config: IncludeCppConfig = parse_quote! {
+            generate_all!()
+            profile_from_file!(#json_path)
+        };
+        text_config.load_list_files().unwrap();
+        json_config.load_list_files().unwrap();
+        std::fs::remove_file(&text).unwrap();
+        std::fs::remove_file(&json).unwrap();
+        assert_eq!(text_config.hotness("ns::hot"), Hotness::Hot);
+        assert_eq!(text_config.hotness("ns::Type::warm"), Hotness::Hot);
+        assert_eq!(text_config.hotness("ns::cold"), Hotness::Cold);
+        assert_eq!(text_config.hotness("ns::other"), Hotness::Unknown);
+        assert_eq!(json_config.hotness("a"), Hotness::Hot);
+        assert_eq!(json_config.hotness("b"), Hotness::Cold);
+    }
 }
@@ -20,7 +20,7 @@ use std::{
     hash::{Hash, Hasher},
 };
 
-pub use config::{IncludeCppConfig, UnsafePolicy};
+pub use config::{CStringPolicy, CppTrait, Hotness, IncludeCppConfig, RustPath, UnsafePolicy};
 use file_locations::FileLocationStrategy;
 use proc_macro2::TokenStream as TokenStream2;
 use syn::Result as ParseResult;
@@ -60,7 +60,16 @@ impl IncludeCpp {
             return TokenStream2::new();
         }
         let fname = self.get_rs_filename();
-        FileLocationStrategy::new().make_include(fname)
+        let include = FileLocationStrategy::new().make_include(fname);
+        // Have rustc rebuild us if any list file changes.
+        let list_files = self
+            .config
+            .list_files()
+            .map(|p| p.to_string_lossy().into_owned());
+        quote::quote! {
+            #include
+            #(const _: &[u8] = include_bytes!(#list_files);)*
+        }
     }
 
     pub fn get_config(&self) -> &IncludeCppConfig {
@@ -242,12 +242,23 @@ use autocxx_engine::IncludeCppEngine;
 ///
 /// Otherwise, your build will fail.
 ///
+/// Types with a destructor, such as a struct holding a `std::unique_ptr`,
+/// can still be held by value if it's safe to move them around in memory
+/// with `memcpy`. Use [`relocatable`] for those. The same applies to any
+/// [`generate_pod`] type which declares `using IsRelocatable = std::true_type;`.
+///
 /// This doesn't just make a difference to the generated code for the type;
 /// it also makes a difference to any functions which take or return that type.
 /// If there's a C++ function which takes a struct by value, but that struct
 /// is not declared as POD-safe, then we'll generate wrapper functions to move
 /// that type into and out of [`cxx::UniquePtr`]s.
 ///
+/// A POD type whose fields are all numbers, pointers, arrays or other
+/// such types can also be listed with [rust_constructible]. autocxx will
+/// then generate a `new` function taking each field value, and an
+/// implementation of [`Default`] which zero-initializes it. Both work
+/// entirely in Rust, without any call into C++.
+///
 /// ### References and pointers
 ///
 /// We follow [cxx] norms here. Specifically:
@@ -297,6 +308,11 @@ use autocxx_engine::IncludeCppEngine;
 /// which should be resolved in future.
 /// This will (of course) return a [`cxx::UniquePtr`] containing that type.
 ///
+/// Types with a default constructor may also be given `make_vector(n)`,
+/// using [make_vector], which default-constructs `n` objects within a single
+/// [`cxx::CxxVector`]. That's one FFI call and one allocation rather than `n`
+/// of each. Individual elements may be mutated via `CxxVector::index_mut`.
+///
 /// ## Built-in types
 ///
 /// The generated code uses `cxx` for interop: see that crate for many important
@@ -337,6 +353,37 @@ use autocxx_engine::IncludeCppEngine;
 /// string on the stack, and is generally incompatible with the
 /// [cxx::UniquePtr]-based approaches we use here.
 ///
+/// Each such conversion allocates a new C++ string. If you're repeatedly
+/// passing the same literal to an API taking a `const std::string&`,
+/// use [cxx_str] instead: it creates the C++ string the first time it's
+/// used, and hands out the same `&'static CxxString` thereafter.
+///
+/// ```ignore
+/// use ffi::AsCppStr;
+/// for _ in 0..1000 {
+///     ffi::lookup(autocxx::cxx_str!("key").as_cpp_str());
+/// }
+/// ```
+///
+/// C strings (`const char*`) are raw pointers like any other, unless
+/// you list the function with [c_strings]. Then, such parameters take
+/// a [`&CStr`][std::ffi::CStr], passed to C++ without any copying, and
+/// such return values come back as a `&CStr` pointing at the C++ bytes.
+/// autocxx can't know whether a returned string is NUL-terminated, nor
+/// how long it lives, so functions returning one are `unsafe`. For a
+/// `const` method, you can promise both with `nul_terminated`: then the
+/// method is safe and its result borrows from `self`. A null return
+/// value causes a panic.
+///
+/// ```ignore
+/// c_strings!("log_message")
+/// c_strings!("Widget::get_name", nul_terminated)
+/// // ...
+/// let msg = std::ffi::CStr::from_bytes_with_nul(b"hello\0").unwrap();
+/// ffi::log_message(msg);
+/// let name: &std::ffi::CStr = widget.get_name();
+/// ```
+///
 /// ## Preprocessor symbols
 ///
 /// `#define` and other preprocessor symbols will appear as constants.
@@ -350,6 +397,57 @@ use autocxx_engine::IncludeCppEngine;
 /// eventually use `std::os::raw::c_int` oor `std::os::raw::c_ulong` etc.
 /// For now, this doesn't quite work: instead you need to wrap these values
 /// in a newtype wrapper such as [c_int] or [c_ulong] in this crate.
+/// To pass a whole slice of them, convert between `&[c_int]` and
+/// `&[std::os::raw::c_int]` without copying using [c_int::from_raw_slice]
+/// and [c_int::as_raw_slice].
+///
+/// Alternatively, the [primitive_ctypes] directive asks autocxx to use
+/// plain Rust primitives for these types wherever the target fixes their
+/// size: `int` becomes `i32`, `unsigned short` becomes `u16`, and on
+/// 64-bit Linux `long` becomes `i64`. (The target is taken from the
+/// `TARGET` environment variable if set, as in a build script.) Types whose
+/// size is not fixed in that way, such as `long long` on 64-bit Linux where
+/// `int64_t` is `long`, still use the newtype wrappers. The generated code
+/// contains static assertions, in both C++ and Rust, that each mapping holds.
+///
+/// ## Enums
+///
+/// C++ enums normally become Rust enums. That means any value C++ gives
+/// you which isn't one of the listed enumerators is undefined behavior,
+/// and enums with thousands of values are slow to compile. Use
+/// [newtype_enum] (or [newtype_enums] for all enums) to instead represent
+/// an enum as a `#[repr(transparent)]` newtype around its underlying
+/// integer, with an associated constant for each enumerator. Code such as
+/// `ffi::Color::RED`, or matching against enumerators, works either way;
+/// the integer is available as `.0`.
+///
+/// ## Smart pointers
+///
+/// Some C++ codebases have their own reference-counted smart pointers,
+/// such as Chromium's `base::scoped_refptr<T>`. By default these are
+/// opaque types which can only be held in a `UniquePtr`, so reaching the
+/// object means going through two pointers and a C++ call. Name the
+/// template with [smart_ptr] and autocxx will instead hold it by value
+/// in Rust as a handle containing the raw `T*`. It implements `Deref` to
+/// the pointee directly, and `Clone` and `Drop` call the C++ copy
+/// constructor and destructor, so the reference count is kept right.
+/// Passing one by value into C++ moves it there, and the moved-from
+/// handle is never destroyed, so its move constructor must leave it
+/// empty, as `scoped_refptr`'s does.
+/// The smart pointer type must have standard layout, consist of nothing
+/// but that pointer, and have a `get()` method returning it as a `T*`.
+/// The generated C++ checks all of that with `static_assert`s, and in
+/// debug builds `Deref` also checks that the pointer it reads is the
+/// one `get()` returns.
+///
+/// ## SIMD vector types
+///
+/// On x86_64, the SSE and AVX vector types (`__m128`, `__m128d`, `__m128i`,
+/// `__m256`, `__m256d` and `__m256i`) may be passed to and from C++ by value.
+/// In function signatures they're represented by newtype wrappers such as
+/// [m128] around the corresponding `core::arch::x86_64` type; as fields of
+/// POD structs they are the `core::arch::x86_64` types themselves. Either
+/// way, they have the same size and alignment as in C++.
 ///
 /// ## String constants
 ///
@@ -366,6 +464,16 @@ use autocxx_engine::IncludeCppEngine;
 /// assert_eq!(std::str::from_utf8(&ffi::BOB).unwrap().trim_end_matches(char::from(0)), "Hello");
 /// ```
 ///
+/// ## Global variables
+///
+/// A global variable `FOO` appears as a function `ffi::FOO()`. For `const`
+/// globals this returns a `&'static` reference. For mutable globals it's
+/// an `unsafe` function returning a `Pin<&'static mut _>`, because C++ may
+/// alter the variable at any time. The first call asks C++ for the
+/// variable's address. That address is cached, so later accesses are
+/// ordinary memory loads rather than calls across the FFI boundary.
+/// Static data members of classes are not yet supported.
+///
 /// ## Namespaces
 ///
 /// The C++ namespace structure is reflected in mods within the generated
@@ -510,6 +618,106 @@ macro_rules! generate_all {
     ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
 }
 
+/// Generate Rust bindings for each C++ type or function listed
+/// in the given file, one per line. Blank lines and lines starting
+/// with `#` are ignored. Relative paths are relative to your crate's
+/// `Cargo.toml`. This is useful for allowlists too large to
+/// comfortably write out as [generate] directives; the file is read
+/// only when generating bindings, and changes to it trigger a rebuild.
+/// May be combined with [generate] but not [generate_all].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! generate_from_file {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Generate Rust bindings for the given C++ type or function only if
+/// the named Cargo feature of your crate is enabled, for example
+/// `generate_if!("net", "net::Socket")`. Otherwise it's skipped
+/// entirely: no bindgen, C++ wrappers or Rust output, so builds without
+/// the feature don't pay for it. You'll need to gate your own uses of
+/// the item with `#[cfg(feature = "net")]`. Features are only known to
+/// build scripts, so this works with `autocxx-build` but not with
+/// `autocxx-gen` unless you set `CARGO_FEATURE_<NAME>` yourself.
+/// May be combined with [generate] but not [generate_all].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! generate_if {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Generate Rust bindings for the given C++ type such that it
+/// is owned by value in Rust, even though it has a destructor or
+/// a move constructor. The type must be _trivially relocatable_:
+/// that is, moving it to a new address with `memcpy` and then
+/// forgetting the original must be as good as a C++ move followed by
+/// destroying the original. Most types are, but `std::string` in
+/// some standard libraries is a notable exception. Its fields must
+/// otherwise meet the requirements of [generate_pod], except that
+/// they may also be smart pointers such as `std::unique_ptr`, since
+/// the C++ destructor will free whatever they own. Types which aren't
+/// relocatable may not hold smart pointers by value.
+///
+/// When such a value is dropped in Rust, its C++ destructor runs
+/// in place. Fields which Rust would otherwise drop (for example a
+/// `std::unique_ptr`, which appears as a [`UniquePtr`][autocxx_engine::cxx::UniquePtr],
+/// or another relocatable type) are wrapped in
+/// [`ManuallyDrop`][std::mem::ManuallyDrop] since it's the C++
+/// destructor which takes care of them. Plain fields are left alone. No heap allocation is
+/// needed to pass the type to or from C++.
+///
+/// Types which declare `using IsRelocatable = std::true_type;`, which
+/// is how [cxx] spots relocatable types, get the same treatment when
+/// listed with [generate_pod]. A marker aliasing anything else, such as
+/// `std::false_type`, is ignored.
+///
+/// This may be combined with [generate_all], or used instead of
+/// [generate_pod] for the type concerned.
+///
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! relocatable {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Pass `const char*` parameters of the given C++ function (or method,
+/// e.g. `"Widget::get_name"`) as [`&CStr`][std::ffi::CStr], and return
+/// such values as `&CStr` too. Any function returning one is `unsafe`,
+/// because [`CStr::from_ptr`][std::ffi::CStr::from_ptr] reads up to the
+/// first NUL byte: `c_strings!("Widget::get_name", nul_terminated)`
+/// promises that returned strings are NUL-terminated and live as long
+/// as the object they came from, so a `const` method needn't be.
+///
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! c_strings {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Generate Rust bindings for the given C++ type such that it is
+/// owned by value in Rust, as [generate_pod], and can also be created
+/// entirely in Rust: it gets a `new` function taking each field value,
+/// and a [`Default`] implementation which zero-initializes it, as C++
+/// value-initialization would. Its fields must all be numbers,
+/// pointers, arrays or other `rust_constructible` types.
+///
+/// autocxx can't see C++ default member initializers (`int a = 3;`), so
+/// this is a promise that the type's default constructor is trivial,
+/// and that there are no other constructors which Rust code
+/// ought not to bypass. The generated C++ checks the first part with
+/// `std::is_trivially_default_constructible`.
+///
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! rust_constructible {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
 /// Generate as "plain old data". For use with [generate_all]
 /// and similarly experimental.
 #[macro_export]
@@ -517,6 +725,54 @@ macro_rules! pod {
     ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
 }
 
+/// Represent C integer types such as `int` and `long` as Rust primitives
+/// wherever the target fixes their size, instead of using newtype wrappers
+/// such as [c_int]. See the section on integer types in [include_cpp].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! primitive_ctypes {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Represent the given C++ enum as a newtype around its underlying
+/// integer type, rather than as a Rust enum. See the section on enums
+/// in [include_cpp].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! newtype_enum {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Give the given C++ type, which must have a default constructor, a
+/// `make_vector(n)` function. See the section on construction in
+/// [include_cpp].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! make_vector {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// As [newtype_enum], for every C++ enum.
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! newtype_enums {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Hold the given C++ smart pointer template by value, dereferencing
+/// directly to the pointee. See the section on smart pointers in
+/// [include_cpp].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! smart_ptr {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
 /// Skip the normal generation of a `make_string` function
 /// and other utilities which we might generate normally.
 /// A directive to be included inside
@@ -540,6 +796,83 @@ macro_rules! block {
     ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
 }
 
+/// As [block], for each item listed in the given file, in the
+/// same format as for [generate_from_file].
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! block_from_file {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Tune the generated code using a profile of which C++ functions are
+/// called most. The file lists fully-qualified C++ names (such as
+/// `ns::Type::method`) one per line, each optionally followed by a
+/// weight such as a call count; alternatively it may be a JSON object
+/// mapping names to weights. Functions which between them account for
+/// most of the weight are considered hot: their Rust wrappers are marked
+/// `#[inline]`. Other listed functions are considered cold: their Rust
+/// wrappers are marked `#[cold]` and their C++ wrappers are defined out
+/// of line rather than in the generated header. Functions not listed are
+/// unaffected. Relative paths are relative to your crate's `Cargo.toml`.
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! profile_from_file {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Implement Rust traits for a C++ type, by calling the equivalent
+/// C++ operators. For example,
+/// `impl_traits!("Foo", Eq, Ord, Hash)` will implement
+/// * `PartialEq` and `Eq` using `operator==`
+/// * `PartialOrd` and `Ord` using `operator<`
+/// * `Hash` using `std::hash<Foo>`
+///
+/// This allows C++ objects, or [`UniquePtr`][autocxx_engine::cxx::UniquePtr]s
+/// to them, to be used directly as keys in Rust collections. `Ord`
+/// implies `Eq`. You'll get a C++ compile error if the operator in question
+/// doesn't exist.
+///
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! impl_traits {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
+/// Implement a C++ abstract class in Rust. For example,
+/// `subclass!("Observer", MyObserver)` generates a C++ subclass of
+/// `Observer` which holds a `MyObserver`, and overrides each pure virtual
+/// method of `Observer` to call straight into the corresponding method
+/// of `MyObserver`.
+///
+/// `MyObserver` is the path to a Rust type, as it would be written in
+/// the module containing the [include_cpp] macro (e.g. `MyObserver`
+/// or `crate::observers::MyObserver`). It must implement the generated
+/// trait `ffi::ObserverMethods`, which has a method for each pure
+/// virtual method: `&self` methods for `const` C++ methods and
+/// `&mut self` methods otherwise. Then,
+/// `my_observer.into_cpp()` returns a `UniquePtr<ffi::Observer>` which
+/// can be passed to C++. Each virtual call from C++ costs a single
+/// indirect call: there's no dynamic dispatch on the Rust side and
+/// no allocation.
+///
+/// For now, only pure virtual methods declared by the class itself
+/// are overridden, so the class mustn't inherit any from its own
+/// base classes. Their parameters and return types must be usable
+/// from Rust without conversion (e.g. no pointers, no C++ objects by
+/// value). The class needs a default constructor
+/// and, as usual, should have a virtual destructor. Each Rust type
+/// may be used in only one `subclass!` directive.
+///
+/// A directive to be included inside
+/// [include_cpp] - see [include_cpp] for general information.
+#[macro_export]
+macro_rules! subclass {
+    ($($tt:tt)*) => { $crate::usage!{$($tt)*} };
+}
+
 /// The name of the mod to be generated with the FFI code.
 /// The default is `ffi`.
 ///
@@ -629,6 +962,48 @@ macro_rules! ctype_wrapper {
             type Id = autocxx_engine::cxx::type_id!($c);
             type Kind = autocxx_engine::cxx::kind::Trivial;
         }
+
+        impl $r {
+            /// Views a slice of the raw C type as a slice of this
+            /// wrapper, without copying.
+            pub fn from_raw_slice(raw: &[::std::os::raw::$r]) -> &[Self] {
+                // Safe because this type is repr(transparent).
+                unsafe { ::std::slice::from_raw_parts(raw.as_ptr() as *const Self, raw.len()) }
+            }
+
+            /// Views a mutable slice of the raw C type as a mutable
+            /// slice of this wrapper, without copying.
+            pub fn from_raw_slice_mut(raw: &mut [::std::os::raw::$r]) -> &mut [Self] {
+                // Safe because this type is repr(transparent).
+                unsafe {
+                    ::std::slice::from_raw_parts_mut(raw.as_mut_ptr() as *mut Self, raw.len())
+                }
+            }
+
+            /// Views a slice of this wrapper as a slice of the raw C
+            /// type, without copying.
+            pub fn as_raw_slice(wrapped: &[Self]) -> &[::std::os::raw::$r] {
+                // Safe because this type is repr(transparent).
+                unsafe {
+                    ::std::slice::from_raw_parts(
+                        wrapped.as_ptr() as *const ::std::os::raw::$r,
+                        wrapped.len(),
+                    )
+                }
+            }
+
+            /// Views a mutable slice of this wrapper as a mutable slice
+            /// of the raw C type, without copying.
+            pub fn as_raw_slice_mut(wrapped: &mut [Self]) -> &mut [::std::os::raw::$r] {
+                // Safe because this type is repr(transparent).
+                unsafe {
+                    ::std::slice::from_raw_parts_mut(
+                        wrapped.as_mut_ptr() as *mut ::std::os::raw::$r,
+                        wrapped.len(),
+                    )
+                }
+            }
+        }
     };
 }
 
@@ -650,6 +1025,91 @@ ctype_wrapper!(c_uint, "c_uint", "Newtype wrapper for an unsigned int");
 ctype_wrapper!(c_int, "c_int", "Newtype wrapper for an int");
 ctype_wrapper!(c_uchar, "c_uchar", "Newtype wrapper for an unsigned char");
 
+#[cfg(target_arch = "x86_64")]
+macro_rules! simd_wrapper {
+    ($r:ident, $a:ident, $c:expr, $d:expr) => {
+        #[doc=$d]
+        #[derive(Debug, Clone, Copy)]
+        #[allow(non_camel_case_types)]
+        #[repr(transparent)]
+        pub struct $r(pub ::core::arch::x86_64::$a);
+
+        unsafe impl autocxx_engine::cxx::ExternType for $r {
+            type Id = autocxx_engine::cxx::type_id!($c);
+            type Kind = autocxx_engine::cxx::kind::Trivial;
+        }
+
+        impl From<::core::arch::x86_64::$a> for $r {
+            fn from(v: ::core::arch::x86_64::$a) -> Self {
+                Self(v)
+            }
+        }
+
+        impl From<$r> for ::core::arch::x86_64::$a {
+            fn from(v: $r) -> Self {
+                v.0
+            }
+        }
+    };
+}
+
+#[cfg(target_arch = "x86_64")]
+simd_wrapper!(m128, __m128, "m128", "Newtype wrapper for an `__m128`");
+#[cfg(target_arch = "x86_64")]
+simd_wrapper!(m128d, __m128d, "m128d", "Newtype wrapper for an `__m128d`");
+#[cfg(target_arch = "x86_64")]
+simd_wrapper!(m128i, __m128i, "m128i", "Newtype wrapper for an `__m128i`");
+#[cfg(target_arch = "x86_64")]
+simd_wrapper!(m256, __m256, "m256", "Newtype wrapper for an `__m256`");
+#[cfg(target_arch = "x86_64")]
+simd_wrapper!(m256d, __m256d, "m256d", "Newtype wrapper for an `__m256d`");
+#[cfg(target_arch = "x86_64")]
+simd_wrapper!(m256i, __m256i, "m256i", "Newtype wrapper for an `__m256i`");
+
+/// A C++ string which is created from a Rust literal on first use and
+/// then lives forever. Create one using [cxx_str], and turn it into a
+/// `&CxxString` by calling `as_cpp_str()` from the `ffi::AsCppStr` trait,
+/// which is generated alongside `ffi::ToCppString`.
+pub struct CxxStrCache {
+    literal: &'static str,
+    cell: once_cell::sync::OnceCell<autocxx_engine::cxx::UniquePtr<autocxx_engine::cxx::CxxString>>,
+}
+
+impl CxxStrCache {
+    #[doc(hidden)]
+    pub const fn new(literal: &'static str) -> Self {
+        Self {
+            literal,
+            cell: once_cell::sync::OnceCell::new(),
+        }
+    }
+
+    /// Returns the C++ string, calling `make_string` to create it
+    /// if this is the first time.
+    pub fn get_or_make(
+        &self,
+        make_string: impl FnOnce(&str) -> autocxx_engine::cxx::UniquePtr<autocxx_engine::cxx::CxxString>,
+    ) -> &autocxx_engine::cxx::CxxString {
+        self.cell
+            .get_or_init(|| make_string(self.literal))
+            .as_ref()
+            .expect("make_string returned a null string")
+    }
+}
+
+/// Refers to an immutable C++ string holding the given literal,
+/// which is created the first time this particular `cxx_str!` is
+/// evaluated and cached thereafter. Use `ffi::AsCppStr::as_cpp_str`
+/// to obtain the `&'static CxxString`, which may be passed to any
+/// API taking a `const std::string&` without allocating.
+#[macro_export]
+macro_rules! cxx_str {
+    ($s:literal) => {{
+        static CACHE: $crate::CxxStrCache = $crate::CxxStrCache::new($s);
+        &CACHE
+    }};
+}
+
 /// Newtype wrapper for a C void. Only useful as a `*c_void`
 #[allow(non_camel_case_types)]
 #[repr(transparent)]
@@ -39,6 +39,14 @@ This is a wrapper for creduce.
 
 Example command-line:
 autocxx-reduce -I my-inc-dir -h my-header -d 'generate!(\"MyClass\")' -k -- --n 64
+
+Instead of a problem string, you can look for performance problems by
+giving --slower-than and/or --more-memory-than. The test case is then
+considered interesting only if code generation exceeds those limits in
+each of --repeat runs. Runs are killed once they exceed the time limit,
+so that creduce doesn't spend long on each one. Without --slower-than,
+each run must also succeed. Measuring memory requires GNU time at
+/usr/bin/time.
 "};
 
 fn main() {
@@ -92,11 +100,34 @@ fn main() {
             Arg::with_name("problem")
                 .short("p")
                 .long("problem")
-                .required(true)
+                .required_unless_one(&["slower-than", "more-memory-than"])
+                .conflicts_with_all(&["slower-than", "more-memory-than"])
                 .value_name("PROBLEM")
                 .help("problem string we're looking for... may be in logs, or in generated C++, or generated .rs")
                 .takes_value(true),
         )
+        .arg(
+            Arg::with_name("slower-than")
+                .long("slower-than")
+                .value_name("SECONDS")
+                .help("look for cases where code generation takes longer than this")
+                .takes_value(true),
+        )
+        .arg(
+            Arg::with_name("more-memory-than")
+                .long("more-memory-than")
+                .value_name("MB")
+                .help("look for cases where code generation's peak RSS exceeds this")
+                .takes_value(true),
+        )
+        .arg(
+            Arg::with_name("repeat")
+                .long("repeat")
+                .value_name("N")
+                .help("how many times code generation must exceed --slower-than or --more-memory-than")
+                .default_value("3")
+                .takes_value(true),
+        )
         .arg(
             Arg::with_name("creduce")
                 .long("creduce")
@@ -204,10 +235,26 @@ fn do_run(matches: ArgMatches, tmp_dir: &TempDir) -> Result<(), std::io::Error>
     let gen_cmd = matches.value_of("gen-cmd").unwrap_or(&default_gen_cmd);
     run_sample_gen_cmd(gen_cmd, &rs_path, &tmp_dir.path(), &extra_clang_args)?;
     let interestingness_test = tmp_dir.path().join("test.sh");
+    let interestingness = match matches.value_of("problem") {
+        Some(problem) => Interestingness::Problem(problem),
+        None => Interestingness::Performance {
+            slower_than: matches
+                .value_of("slower-than")
+                .map(|s| s.parse().expect("--slower-than must be a number")),
+            more_memory_than: matches
+                .value_of("more-memory-than")
+                .map(|s| s.parse().expect("--more-memory-than must be a number")),
+            repeats: matches
+                .value_of("repeat")
+                .unwrap()
+                .parse()
+                .expect("--repeat must be a number"),
+        },
+    };
     create_interestingness_test(
         gen_cmd,
         &interestingness_test,
-        matches.value_of("problem").unwrap(),
+        &interestingness,
         &rs_path,
         &extra_clang_args,
         matches.value_of("no-precompile").is_none(),
@@ -318,10 +365,24 @@ fn format_gen_cmd<'a>(
         .chain(extra_clang_args.iter().map(|s| s.to_string()))
 }
 
+/// What makes a reduced test case worth keeping.
+enum Interestingness<'a> {
+    /// This string appears in the output of code generation,
+    /// or of compiling the generated code.
+    Problem(&'a str),
+    /// Code generation is slower (in seconds) or uses more memory
+    /// (in megabytes) than this, every time out of `repeats`.
+    Performance {
+        slower_than: Option<f64>,
+        more_memory_than: Option<u64>,
+        repeats: u32,
+    },
+}
+
 fn create_interestingness_test(
     gen_cmd: &str,
     test_path: &Path,
-    problem: &str,
+    interestingness: &Interestingness,
     rs_file: &Path,
     extra_clang_args: &[&str],
     precompile: bool,
@@ -340,6 +401,22 @@ fn create_interestingness_test(
         "; mv gen0.cc gen0-orig.cc && sed -e 's/#include <.*>//g' < gen0-orig.cc | sed -e 's/#include \"cxx.h\"//g' > gen0.cc && mv autocxxgen.h autocxxgen-orig.h && sed -e 's/#include <.*>//g' < autocxxgen-orig.h | sed -e 's/#include \"cxx.h\"//g' > autocxxgen.h && {} 2>&1",
         make_compile_step(postcompile, "gen0.cc", extra_clang_args)
     );
+    let codegen_step = match interestingness {
+        Interestingness::Problem(problem) => format!(
+            "({} {} 2>&1 && cat gen.complete.rs && cat autocxxgen*.h {}) | grep \"{}\"  >/dev/null 2>&1",
+            gen_cmd, args, postcompile_step, problem
+        ),
+        Interestingness::Performance {
+            slower_than,
+            more_memory_than,
+            repeats,
+        } => make_performance_check(
+            &format!("{} {}", gen_cmd, args),
+            *slower_than,
+            *more_memory_than,
+            *repeats,
+        ),
+    };
     let content = format!(
         indoc! {"
         #!/bin/sh
@@ -350,14 +427,14 @@ fn create_interestingness_test(
         mv concat.h concat-body.h
         echo Codegen
         (echo \"#ifndef __CONCAT_H__\"; echo \"#define __CONCAT_H__\"; echo '#include \"concat-body.h\"'; echo \"#endif\") > concat.h
-        ({} {} 2>&1 && cat gen.complete.rs && cat autocxxgen*.h {}) | grep \"{}\"  >/dev/null 2>&1
+        {}
         echo Remove
         rm concat.h
         echo Swap back
         mv concat-body.h concat.h
         echo Done
     "},
-        precompile_step, gen_cmd, args, postcompile_step, problem
+        precompile_step, codegen_step
     );
     println!("Interestingness test:\n{}", content);
     {
@@ -371,6 +448,49 @@ fn create_interestingness_test(
     Ok(())
 }
 
+/// Shell commands which run code generation `repeats` times and fail
+/// unless it's exceeded the given limits every time. Each run is killed
+/// once it exceeds the time limit, to keep creduce moving. Without a
+/// time limit, each run must also succeed.
+fn make_performance_check(
+    gen_cmd: &str,
+    slower_than: Option<f64>,
+    more_memory_than: Option<u64>,
+    repeats: u32,
+) -> String {
+    let measure = if more_memory_than.is_some() {
+        "/usr/bin/time -f %M -o rss.txt "
+    } else {
+        ""
+    };
+    let timeout = slower_than
+        .map(|secs| format!("timeout {} ", secs))
+        .unwrap_or_default();
+    // timeout(1) exits with 124 if the command timed out. Otherwise,
+    // a run which failed doesn't tell us about memory use.
+    let status_check = if slower_than.is_some() {
+        "[ $status -eq 124 ] || exit 1"
+    } else {
+        "[ $status -eq 0 ] || exit 1"
+    };
+    // GNU time reports peak RSS in KB, on the last line.
+    let memory_check = more_memory_than
+        .map(|mb| format!("[ \"$(tail -n 1 rss.txt)\" -gt {} ] || exit 1", mb * 1024))
+        .unwrap_or_default();
+    format!(
+        indoc! {"
+        for i in $(seq {}); do
+          set +e
+          {}{}{} >/dev/null 2>&1
+          status=$?
+          set -e
+          {}
+          {}
+        done"},
+        repeats, measure, timeout, gen_cmd, status_check, memory_check
+    )
+}
+
 fn make_compile_step(enabled: bool, file: &str, extra_clang_args: &[&str]) -> String {
     if enabled {
         format!(
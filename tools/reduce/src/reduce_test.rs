@@ -113,6 +113,48 @@ where
     Ok(())
 }
 
+#[test]
+fn test_performance_check() {
+    let check = super::make_performance_check("autocxx-gen", Some(2.5), Some(100), 4);
+    assert!(check.starts_with("for i in $(seq 4)"));
+    assert!(check.contains("/usr/bin/time -f %M -o rss.txt timeout 2.5 autocxx-gen"));
+    assert!(check.contains("-eq 124"));
+    assert!(check.contains("-gt 102400"));
+    let check = super::make_performance_check("autocxx-gen", Some(1.0), None, 1);
+    assert!(!check.contains("/usr/bin/time"));
+    assert!(!check.contains("rss.txt"));
+}
+
+#[test]
+fn test_performance_check_runs() {
+    assert!(run_performance_check("sleep 5", Some(0.5), None));
+    assert!(!run_performance_check("true", Some(0.5), None));
+    if !Path::new("/usr/bin/time").exists() {
+        return;
+    }
+    assert!(run_performance_check("true", None, Some(0)));
+    assert!(!run_performance_check("false", None, Some(0)));
+    assert!(!run_performance_check("true", None, Some(1_000_000)));
+}
+
+/// Whether the shell commands from `make_performance_check` find a
+/// command interesting.
+fn run_performance_check(
+    cmd: &str,
+    slower_than: Option<f64>,
+    more_memory_than: Option<u64>,
+) -> bool {
+    let tmp_dir = TempDir::new("example").unwrap();
+    let check = super::make_performance_check(cmd, slower_than, more_memory_than, 2);
+    std::process::Command::new("sh")
+        .arg("-ec")
+        .arg(check)
+        .current_dir(tmp_dir.path())
+        .status()
+        .unwrap()
+        .success()
+}
+
 fn write_to_file(dir: &Path, filename: &str, content: &[u8]) {
     let path = dir.join(filename);
     let mut f = File::create(&path).expect("Unable to create file");